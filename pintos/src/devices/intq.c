@@ -11,6 +11,7 @@ void
 intq_init (struct intq *q)
 {
   lock_init (&q->lock);
+  spin_init (&q->spin, "intq");
   q->not_full = q->not_empty = NULL;
   q->head = q->tail = 0;
 }
@@ -40,17 +41,24 @@ intq_getc (struct intq *q)
   uint8_t byte;
 
   ASSERT (intr_get_level () == INTR_OFF);
+  spin_lock (&q->spin);
   while (intq_empty (q))
     {
       ASSERT (!intr_context ());
+      spin_unlock (&q->spin);
       lock_acquire (&q->lock);
-      wait (q, &q->not_empty);
+      spin_lock (&q->spin);
+      if (intq_empty (q))
+        wait (q, &q->not_empty);
+      spin_unlock (&q->spin);
       lock_release (&q->lock);
+      spin_lock (&q->spin);
     }
 
   byte = q->buf[q->tail];
   q->tail = next (q->tail);
   signal (q, &q->not_full);
+  spin_unlock (&q->spin);
   return byte;
 }
 
@@ -61,17 +69,24 @@ void
 intq_putc (struct intq *q, uint8_t byte)
 {
   ASSERT (intr_get_level () == INTR_OFF);
+  spin_lock (&q->spin);
   while (intq_full (q))
     {
       ASSERT (!intr_context ());
+      spin_unlock (&q->spin);
       lock_acquire (&q->lock);
-      wait (q, &q->not_full);
+      spin_lock (&q->spin);
+      if (intq_full (q))
+        wait (q, &q->not_full);
+      spin_unlock (&q->spin);
       lock_release (&q->lock);
+      spin_lock (&q->spin);
     }
 
   q->buf[q->head] = byte;
   q->head = next (q->head);
   signal (q, &q->not_empty);
+  spin_unlock (&q->spin);
 }
 
 /* Returns the position after POS within an intq. */
@@ -82,9 +97,10 @@ next (int pos)
 }
 
 /* WAITER must be the address of Q's not_empty or not_full
-   member.  Waits until the given condition is true. */
+   member.  Waits until the given condition is true.  Releases
+   Q's spinlock, which the caller must hold, while waiting. */
 static void
-wait (struct intq *q UNUSED, struct thread **waiter)
+wait (struct intq *q, struct thread **waiter)
 {
   ASSERT (!intr_context ());
   ASSERT (intr_get_level () == INTR_OFF);
@@ -92,7 +108,9 @@ wait (struct intq *q UNUSED, struct thread **waiter)
           || (waiter == &q->not_full && intq_full (q)));
 
   *waiter = thread_current ();
+  spin_unlock (&q->spin);
   thread_block ();
+  spin_lock (&q->spin);
 }
 
 /* WAITER must be the address of Q's not_empty or not_full
@@ -15,7 +15,9 @@
    and condition variables from threads/synch.h cannot be used in
    this case, as they normally would, because they can only
    protect kernel threads from one another, not from interrupt
-   handlers. */
+   handlers.  Instead, turning interrupts off protects the queue
+   from interrupt handlers on the same CPU, and a spinlock
+   protects it from other CPUs. */
 
 /* Queue buffer size, in bytes. */
 #define INTQ_BUFSIZE 64
@@ -29,6 +31,7 @@ struct intq
     struct thread *not_empty;   /* Thread waiting for not-empty condition. */
 
     /* Queue. */
+    struct spinlock spin;       /* Protects queue and waiting threads. */
     uint8_t buf[INTQ_BUFSIZE];  /* Buffer. */
     int head;                   /* New data is written here. */
     int tail;                   /* Old data is read here. */
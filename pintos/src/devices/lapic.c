@@ -0,0 +1,318 @@
+#include "devices/lapic.h"
+#include <debug.h>
+#include <stdint.h>
+#include "devices/timer.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/profile.h"
+#include "threads/pte.h"
+#include "threads/smp.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Local Advanced Programmable Interrupt Controller (APIC).
+   Each CPU has its own local APIC, which delivers interrupts to
+   it, sends inter-processor interrupts (IPIs) to other CPUs,
+   and includes a timer.  Every CPU sees its own local APIC's
+   registers at the same physical address, normally 0xfee00000.
+   Refer to [IA32-v3a] chapter 8 "Advanced Programmable Interrupt
+   Controller (APIC)" for details. */
+
+/* Local APIC register offsets, in bytes. */
+#define LAPIC_ID        0x020   /* ID. */
+#define LAPIC_TPR       0x080   /* Task priority. */
+#define LAPIC_EOI       0x0b0   /* End of interrupt. */
+#define LAPIC_SVR       0x0f0   /* Spurious interrupt vector. */
+#define LAPIC_ESR       0x280   /* Error status. */
+#define LAPIC_ICR_LO    0x300   /* Interrupt command, bits 0...31. */
+#define LAPIC_ICR_HI    0x310   /* Interrupt command, bits 32...63. */
+#define LAPIC_LVT_TIMER 0x320   /* Local vector table: timer. */
+#define LAPIC_LVT_LINT0 0x350   /* Local vector table: LINT0 pin. */
+#define LAPIC_LVT_LINT1 0x360   /* Local vector table: LINT1 pin. */
+#define LAPIC_LVT_ERROR 0x370   /* Local vector table: error. */
+#define LAPIC_TIMER_ICR 0x380   /* Timer initial count. */
+#define LAPIC_TIMER_CCR 0x390   /* Timer current count. */
+#define LAPIC_TIMER_DCR 0x3e0   /* Timer divide configuration. */
+
+/* Register bits. */
+#define SVR_ENABLE      0x00000100      /* APIC software enable. */
+#define LVT_MASKED      0x00010000      /* Interrupt masked. */
+#define LVT_PERIODIC    0x00020000      /* Timer: periodic mode. */
+#define ICR_INIT        0x00000500      /* Delivery mode: INIT. */
+#define ICR_STARTUP     0x00000600      /* Delivery mode: start-up. */
+#define ICR_PENDING     0x00001000      /* Delivery status: pending. */
+#define ICR_ASSERT      0x00004000      /* Level: assert. */
+#define ICR_LEVEL       0x00008000      /* Trigger mode: level. */
+#define DCR_DIV16       0x00000003      /* Timer divides bus clock by 16. */
+
+/* Model-specific register holding the local APIC's physical
+   address. */
+#define APIC_BASE_MSR   0x1b
+
+/* Kernel virtual address at which the local APIC's registers
+   are mapped.  This is far above the mapping of physical RAM at
+   PHYS_BASE, so it cannot collide with it. */
+#define LAPIC_VADDR ((void *) 0xfee00000)
+
+/* Local APIC registers, or a null pointer if not mapped. */
+static volatile uint32_t *lapic;
+
+/* Local APIC timer counts per timer tick, with the timer dividing
+   the bus clock by 16.  Set by lapic_timer_calibrate(). */
+static uint32_t lapic_timer_count;
+
+/* Handler for the bootstrap processor's timer interrupt once
+   lapic_timer_oneshot() has put its timer in one-shot mode, or a
+   null pointer while it is not in use. */
+static intr_handler_func *oneshot_handler;
+
+static intr_handler_func lapic_timer_interrupt, lapic_spurious_interrupt;
+
+static uint32_t
+lapic_read (int reg)
+{
+  return lapic[reg / sizeof *lapic];
+}
+
+static void
+lapic_write (int reg, uint32_t value)
+{
+  lapic[reg / sizeof *lapic] = value;
+
+  /* Read back the ID register to wait for the write to
+     complete. */
+  (void) lapic[LAPIC_ID / sizeof *lapic];
+}
+
+/* Maps the local APIC registers, which are at physical address
+   PHYS, into the kernel's address space and enables the bootstrap
+   processor's local APIC.  Leaves LINT0 and LINT1 as the BIOS set
+   them up, so that interrupts from the PICs keep arriving.
+
+   Must be called before any process page directory is created,
+   because those copy the kernel mappings from init_page_dir. */
+void
+lapic_init (uintptr_t phys)
+{
+  uint32_t *pde = &init_page_dir[pd_no (LAPIC_VADDR)];
+  uint32_t *pt;
+
+  ASSERT (lapic == NULL);
+  ASSERT (phys % PGSIZE == 0);
+
+  if (*pde == 0)
+    *pde = pde_create (palloc_get_page (PAL_ASSERT | PAL_ZERO));
+  pt = pde_get_pt (*pde);
+  pt[pt_no (LAPIC_VADDR)] = phys | PTE_PCD | PTE_PWT | PTE_W | PTE_P;
+  asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)) : "memory");
+  lapic = LAPIC_VADDR;
+
+  lapic_write (LAPIC_SVR, SVR_ENABLE | LAPIC_VEC_SPURIOUS);
+  lapic_write (LAPIC_TPR, 0);
+  lapic_write (LAPIC_LVT_TIMER, LVT_MASKED | LAPIC_VEC_TIMER);
+  lapic_write (LAPIC_LVT_ERROR, LVT_MASKED);
+
+  intr_register_ext (LAPIC_VEC_TIMER, lapic_timer_interrupt, "LAPIC Timer");
+  intr_register_int (LAPIC_VEC_SPURIOUS, 0, INTR_OFF,
+                     lapic_spurious_interrupt, "LAPIC Spurious");
+}
+
+/* Enables the running application processor's local APIC and
+   starts its timer, which drives its time slices the way the
+   PIT does for the bootstrap processor. */
+void
+lapic_init_ap (void)
+{
+  ASSERT (lapic != NULL);
+  ASSERT (lapic_timer_count != 0);
+
+  lapic_write (LAPIC_SVR, SVR_ENABLE | LAPIC_VEC_SPURIOUS);
+  lapic_write (LAPIC_TPR, 0);
+  lapic_write (LAPIC_LVT_LINT0, LVT_MASKED);
+  lapic_write (LAPIC_LVT_LINT1, LVT_MASKED);
+  lapic_write (LAPIC_LVT_ERROR, LVT_MASKED);
+  lapic_write (LAPIC_ESR, 0);
+
+  lapic_write (LAPIC_TIMER_DCR, DCR_DIV16);
+  lapic_write (LAPIC_LVT_TIMER, LVT_PERIODIC | LAPIC_VEC_TIMER);
+  lapic_write (LAPIC_TIMER_ICR, lapic_timer_count);
+}
+
+/* If the local APIC is not mapped yet, which is the case on a
+   machine without a MultiProcessor table or if only one CPU is
+   in use, but CPUID reports that the CPU has one, maps it at the
+   address in the APIC base MSR.  Either way, calibrates the
+   local APIC timer if that has not been done.  Returns true if
+   the local APIC is usable, false otherwise.
+
+   Interrupts must be on.  Like lapic_init(), must be called
+   before any process page directory is created. */
+bool
+lapic_probe (void)
+{
+  if (lapic == NULL)
+    {
+      uint32_t a, b, c, d;
+      uint32_t base_lo, base_hi;
+
+      asm volatile ("cpuid" : "=a" (a), "=b" (b), "=c" (c), "=d" (d)
+                    : "a" (1));
+      if ((d & (1 << 9)) == 0)
+        return false;
+      asm volatile ("rdmsr" : "=a" (base_lo), "=d" (base_hi)
+                    : "c" (APIC_BASE_MSR));
+      lapic_init (base_lo & ~PGMASK);
+    }
+  if (lapic_timer_count == 0)
+    lapic_timer_calibrate ();
+  return lapic_timer_count != 0;
+}
+
+/* Returns true if lapic_init() has mapped the local APIC. */
+bool
+lapic_present (void)
+{
+  return lapic != NULL;
+}
+
+/* Returns the running CPU's local APIC ID. */
+uint8_t
+lapic_id (void)
+{
+  return lapic_read (LAPIC_ID) >> 24;
+}
+
+/* Acknowledges the interrupt being serviced. */
+void
+lapic_eoi (void)
+{
+  lapic_write (LAPIC_EOI, 0);
+}
+
+/* Measures the local APIC timer's rate against the PIT-driven
+   timer ticks.  Interrupts must be on. */
+void
+lapic_timer_calibrate (void)
+{
+  int64_t start;
+
+  ASSERT (lapic != NULL);
+  ASSERT (intr_get_level () == INTR_ON);
+
+  /* Start counting down right at a tick boundary. */
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    barrier ();
+  lapic_write (LAPIC_TIMER_DCR, DCR_DIV16);
+  lapic_write (LAPIC_TIMER_ICR, UINT32_MAX);
+
+  /* Count for a tenth of a second. */
+  start = timer_ticks ();
+  while (timer_elapsed (start) < TIMER_FREQ / 10)
+    barrier ();
+  lapic_timer_count = (UINT32_MAX - lapic_read (LAPIC_TIMER_CCR))
+                      / (TIMER_FREQ / 10);
+  lapic_write (LAPIC_TIMER_ICR, 0);
+}
+
+/* Switches the running CPU's local APIC timer, which must be the
+   bootstrap processor's, to one-shot mode and makes HANDLER its
+   interrupt handler.  The timer stays stopped until armed with
+   lapic_timer_arm(). */
+void
+lapic_timer_oneshot (intr_handler_func *handler)
+{
+  ASSERT (lapic_timer_count != 0);
+  ASSERT (handler != NULL);
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  oneshot_handler = handler;
+  lapic_write (LAPIC_TIMER_DCR, DCR_DIV16);
+  lapic_write (LAPIC_LVT_TIMER, LAPIC_VEC_TIMER);
+  lapic_write (LAPIC_TIMER_ICR, 0);
+}
+
+/* Arms the running CPU's one-shot timer to interrupt in about NS
+   nanoseconds, replacing any expiry already armed.  Very short
+   intervals are rounded up to one timer count and very long ones
+   down to the longest the timer can count. */
+void
+lapic_timer_arm (int64_t ns)
+{
+  int64_t count = ns * lapic_timer_count / (1000000000 / TIMER_FREQ);
+
+  ASSERT (oneshot_handler != NULL);
+
+  if (count < 1)
+    count = 1;
+  else if (count > UINT32_MAX)
+    count = UINT32_MAX;
+  lapic_write (LAPIC_TIMER_ICR, count);
+}
+
+/* Waits for the previous IPI to be accepted. */
+static void
+wait_for_ipi (void)
+{
+  while (lapic_read (LAPIC_ICR_LO) & ICR_PENDING)
+    barrier ();
+}
+
+/* Sends an INIT IPI to the CPU with the given APIC_ID, which
+   resets it into a wait-for-SIPI state. */
+void
+lapic_send_init (uint8_t apic_id)
+{
+  lapic_write (LAPIC_ICR_HI, (uint32_t) apic_id << 24);
+  lapic_write (LAPIC_ICR_LO, ICR_INIT | ICR_LEVEL | ICR_ASSERT);
+  wait_for_ipi ();
+  lapic_write (LAPIC_ICR_LO, ICR_INIT | ICR_LEVEL);
+  wait_for_ipi ();
+}
+
+/* Sends a start-up IPI to the CPU with the given APIC_ID, which
+   starts it running in real mode at physical address ENTRY.
+   ENTRY must be page-aligned and below 1 MB. */
+void
+lapic_send_startup (uint8_t apic_id, uintptr_t entry)
+{
+  ASSERT (entry % PGSIZE == 0 && entry < 0x100000);
+
+  lapic_write (LAPIC_ICR_HI, (uint32_t) apic_id << 24);
+  lapic_write (LAPIC_ICR_LO, ICR_STARTUP | (entry >> PGBITS));
+  wait_for_ipi ();
+}
+
+/* Sends interrupt VEC to the CPU with the given APIC_ID. */
+void
+lapic_send_ipi (uint8_t apic_id, uint8_t vec)
+{
+  lapic_write (LAPIC_ICR_HI, (uint32_t) apic_id << 24);
+  lapic_write (LAPIC_ICR_LO, vec);
+  wait_for_ipi ();
+}
+
+/* Local APIC timer interrupt handler.  An application
+   processor's periodic timer drives its time slices.  The
+   bootstrap processor's timer only interrupts in one-shot mode,
+   for devices/timer.c, which other CPUs also use to make it
+   reprogram its timer. */
+static void
+lapic_timer_interrupt (struct intr_frame *args)
+{
+  if (oneshot_handler != NULL && thread_current ()->cpu->id == 0)
+    oneshot_handler (args);
+  else
+    {
+      thread_tick ();
+      profile_tick (args);
+    }
+}
+
+/* Spurious interrupt handler.  A spurious interrupt must not be
+   acknowledged, so there is nothing to do. */
+static void
+lapic_spurious_interrupt (struct intr_frame *args UNUSED)
+{
+}
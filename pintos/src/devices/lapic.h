@@ -0,0 +1,34 @@
+#ifndef DEVICES_LAPIC_H
+#define DEVICES_LAPIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/interrupt.h"
+
+/* Interrupt vectors delivered by the local APIC.  Vectors
+   LAPIC_VEC_MIN...LAPIC_VEC_MAX are external interrupts in the
+   sense of threads/interrupt.c; the spurious vector is not,
+   because it must not be acknowledged. */
+#define LAPIC_VEC_MIN       0xf0
+#define LAPIC_VEC_TIMER     0xf0    /* Local timer. */
+#define LAPIC_VEC_RESCHED   0xf1    /* Reschedule IPI. */
+#define LAPIC_VEC_TLB       0xf2    /* TLB shootdown IPI. */
+#define LAPIC_VEC_MAX       0xfe
+#define LAPIC_VEC_SPURIOUS  0xff    /* Spurious interrupt. */
+
+void lapic_init (uintptr_t phys);
+void lapic_init_ap (void);
+bool lapic_probe (void);
+bool lapic_present (void);
+uint8_t lapic_id (void);
+void lapic_eoi (void);
+
+void lapic_timer_calibrate (void);
+void lapic_timer_oneshot (intr_handler_func *);
+void lapic_timer_arm (int64_t ns);
+
+void lapic_send_init (uint8_t apic_id);
+void lapic_send_startup (uint8_t apic_id, uintptr_t entry);
+void lapic_send_ipi (uint8_t apic_id, uint8_t vec);
+
+#endif /* devices/lapic.h */
@@ -81,3 +81,16 @@ pit_configure_channel (int channel, int mode, int frequency)
   outb (PIT_PORT_COUNTER (channel), count >> 8);
   intr_set_level (old_level);
 }
+
+/* Stops the given CHANNEL in the PIT.  Writing a mode 0
+   ("interrupt on terminal count") control word without loading a
+   count leaves the channel's output low and its counter stopped,
+   so channel 0 raises no further interrupts until it is
+   configured again. */
+void
+pit_stop_channel (int channel)
+{
+  ASSERT (channel == 0 || channel == 2);
+
+  outb (PIT_PORT_CONTROL, (channel << 6) | 0x30);
+}
@@ -4,5 +4,6 @@
 #include <stdint.h>
 
 void pit_configure_channel (int channel, int mode, int frequency);
+void pit_stop_channel (int channel);
 
 #endif /* devices/pit.h */
@@ -4,10 +4,21 @@
 #include "devices/kbd.h"
 #include "devices/serial.h"
 #include "devices/timer.h"
+#include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/profile.h"
+#include "threads/rcu.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
+#include "userprog/process.h"
+#endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/swap.h"
 #endif
 #ifdef FILESYS
 #include "devices/block.h"
@@ -95,6 +106,8 @@ shutdown_power_off (void)
 #endif
 
   print_stats ();
+  profile_print ();
+  trace_dump ();
 
   printf ("Powering off...\n");
   serial_flush ();
@@ -123,6 +136,9 @@ print_stats (void)
 {
   timer_print_stats ();
   thread_print_stats ();
+  rcu_print_stats ();
+  lockstat_print ();
+  intr_latency_print ();
 #ifdef FILESYS
   block_print_stats ();
 #endif
@@ -130,5 +146,11 @@ print_stats (void)
   kbd_print_stats ();
 #ifdef USERPROG
   exception_print_stats ();
+  process_print_stats ();
+#endif
+#ifdef VM
+  page_print_stats ();
+  frame_print_stats ();
+  swap_print_stats ();
 #endif
 }
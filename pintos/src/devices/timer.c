@@ -1,12 +1,17 @@
 #include "devices/timer.h"
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stdio.h>
+#include "devices/lapic.h"
 #include "devices/pit.h"
 #include "threads/interrupt.h"
+#include "threads/profile.h"
+#include "threads/smp.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -17,14 +22,71 @@
 #error TIMER_FREQ <= 1000 recommended
 #endif
 
+/* Nanoseconds per second and per timer tick. */
+#define NS_PER_SEC 1000000000LL
+#define NS_PER_TICK (NS_PER_SEC / TIMER_FREQ)
+
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* Tickless timer.
+
+   By default the PIT interrupts the bootstrap processor
+   TIMER_FREQ times per second, and timer_interrupt() counts
+   ticks, wakes sleepers, and drives time slices.
+
+   With -tickless, timer_tickless_init() instead puts the
+   bootstrap processor's local APIC timer into one-shot mode and
+   stops the PIT.  The timer is then armed for the next event
+   that matters: the next tick boundary while a thread other
+   than the idle thread runs, so that time slices and the MLFQS
+   work as before, but only the earliest sleeper's wake-up time
+   or delayed work while the CPU is idle.  Each clock event
+   catches `ticks' up with the time-stamp counter (TSC), which is
+   the clock source, running every tick that passed in the
+   meantime.  Because sleepers have nanosecond wake-up times,
+   timer_usleep() and timer_nsleep() block instead of busy
+   waiting.
+
+   The PIT remains in use if -tickless is not given or the CPU
+   has no local APIC.  Other CPUs keep their periodic local APIC
+   timers. */
+bool timer_tickless;
+
+/* True once the one-shot timer has replaced the PIT. */
+static bool one_shot;
+
+/* TSC cycles per second, and the TSC value and time since boot,
+   in ns, when the one-shot timer took over. */
+static uint64_t tsc_freq;
+static uint64_t tsc_base;
+static int64_t ns_base;
+
+/* Time, in ns since boot, for which the one-shot timer is armed. */
+static int64_t armed_time;
+
+/* Statistics. */
+static unsigned long long clock_event_cnt;  /* # of one-shot interrupts. */
+static long long skipped_ticks;             /* # of ticks with no interrupt. */
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
-static intr_handler_func timer_interrupt;
+/* List of sleeping threads, in order of increasing wake_time.
+   Threads with equal wake_time stay in the order in which they
+   went to sleep.  Only the front of the list needs to be
+   examined on each timer tick or clock event. */
+static struct list sleep_list;
+
+static intr_handler_func timer_interrupt, clock_event_interrupt;
+static list_less_func wake_time_less;
+static void sleep_until (int64_t wake_time);
+static void sleep_insert (struct thread *, int64_t wake_time);
+static void wake_sleepers (int64_t now);
+static uint64_t rdtsc (void);
+static int64_t clock_now (void);
+static void clock_event_program (void);
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
@@ -36,6 +98,7 @@ void
 timer_init (void)
 {
   pit_configure_channel (0, 2, TIMER_FREQ);
+  list_init (&sleep_list);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
 
@@ -66,6 +129,60 @@ timer_calibrate (void)
   printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
 }
 
+/* If -tickless was given and the CPU has a local APIC, replaces
+   the PIT by the local APIC timer in one-shot mode.  Must be
+   called with interrupts on, after smp_init(). */
+void
+timer_tickless_init (void)
+{
+  enum intr_level old_level;
+  uint64_t start_tsc;
+  int64_t start;
+
+  ASSERT (intr_get_level () == INTR_ON);
+
+  if (!timer_tickless)
+    return;
+  if (!lapic_probe ())
+    {
+      printf ("Timer: no local APIC, keeping the PIT.\n");
+      return;
+    }
+
+  /* Measure the TSC's rate over a tenth of a second. */
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    barrier ();
+  start_tsc = rdtsc ();
+  start = timer_ticks ();
+  while (timer_elapsed (start) < TIMER_FREQ / 10)
+    barrier ();
+  tsc_freq = (rdtsc () - start_tsc) * 10;
+
+  /* Take over right after a tick, so that the TSC and `ticks'
+     agree. */
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    barrier ();
+  old_level = intr_disable ();
+  tsc_base = rdtsc ();
+  ns_base = ticks * NS_PER_TICK;
+  pit_stop_channel (0);
+  lapic_timer_oneshot (clock_event_interrupt);
+  one_shot = true;
+  clock_event_program ();
+  intr_set_level (old_level);
+
+  printf ("Timer: tickless, %'"PRIu64" TSC cycles/s.\n", tsc_freq);
+}
+
+/* Returns true if the one-shot timer has replaced the PIT. */
+bool
+timer_is_tickless (void)
+{
+  return one_shot;
+}
+
 /* Returns the number of timer ticks since the OS booted. */
 int64_t
 timer_ticks (void)
@@ -84,16 +201,99 @@ timer_elapsed (int64_t then)
   return timer_ticks () - then;
 }
 
+/* Returns the time since the OS booted, in nanoseconds.  Without
+   the tickless timer, the result only changes once per tick. */
+int64_t
+timer_ns (void)
+{
+  return one_shot ? clock_now () : timer_ticks () * NS_PER_TICK;
+}
+
+/* Called by the idle thread, with interrupts off, just before it
+   halts the CPU.  On the bootstrap processor, with the tickless
+   timer, rearms the timer for the next sleeper or delayed work,
+   skipping the ticks in between. */
+void
+timer_idle_enter (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (one_shot && thread_current ()->cpu->id == 0)
+    clock_event_program ();
+}
+
+/* Called, with interrupts off, when a CPU switches from its idle
+   thread to another thread.  On the bootstrap processor, with the
+   tickless timer, rearms the timer for the next tick boundary so
+   that the thread gets time slices. */
+void
+timer_idle_exit (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (one_shot && thread_current ()->cpu->id == 0)
+    clock_event_program ();
+}
+
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
-   be turned on. */
+   be turned on.
+
+   The running thread is blocked on sleep_list and is unblocked
+   by the timer interrupt once its wake-up time arrives, so a
+   sleeping thread costs nothing until then. */
 void
 timer_sleep (int64_t ticks)
 {
-  int64_t start = timer_ticks ();
-
   ASSERT (intr_get_level () == INTR_ON);
-  while (timer_elapsed (start) < ticks)
-    thread_yield ();
+  if (ticks <= 0)
+    return;
+
+  sleep_until ((timer_ticks () + ticks) * NS_PER_TICK);
+}
+
+/* Sleeps until timer_ticks() reaches TICK.  Unlike
+   timer_sleep(), may be called with interrupts off, and leaves
+   them as it found them. */
+void
+timer_sleep_until (int64_t tick)
+{
+  ASSERT (!intr_context ());
+  if (tick > timer_ticks ())
+    sleep_until (tick * NS_PER_TICK);
+}
+
+/* Blocks the running thread, which the caller has just put on a
+   wait list through its `elem' member, until another thread
+   unblocks it or timer_ticks() reaches TICK, whichever comes
+   first.  In the latter case, the timer interrupt removes the
+   thread from the wait list before unblocking it, and this
+   function returns true.  Returns false if the thread was
+   unblocked in time.
+
+   The thread waits on sleep_list at the same time as on the
+   wait list, so the timeout costs no polling.  Interrupts must
+   be off. */
+bool
+timer_block_until (int64_t tick)
+{
+  struct thread *cur = thread_current ();
+
+  ASSERT (!intr_context ());
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  cur->timed_wait = true;
+  cur->timed_out = false;
+  sleep_insert (cur, tick * NS_PER_TICK);
+  thread_block ();
+
+  /* Woken up in time: leave sleep_list, unless the timer
+     interrupt already took us off after we were woken. */
+  if (cur->timed_wait)
+    {
+      list_remove (&cur->sleepelem);
+      cur->timed_wait = false;
+    }
+  return cur->timed_out;
 }
 
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
@@ -164,14 +364,182 @@ void
 timer_print_stats (void)
 {
   printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  if (one_shot)
+    printf ("Timer: %llu clock events, %lld ticks skipped while idle\n",
+            clock_event_cnt, skipped_ticks);
 }
 
 /* Timer interrupt handler. */
 static void
-timer_interrupt (struct intr_frame *args UNUSED)
+timer_interrupt (struct intr_frame *args)
 {
+  /* The PIT may have had an interrupt pending when
+     timer_tickless_init() stopped it. */
+  if (one_shot)
+    return;
+
   ticks++;
+  wake_sleepers (ticks * NS_PER_TICK);
+  workqueue_tick (ticks);
   thread_tick ();
+  profile_tick (args);
+}
+
+/* One-shot local APIC timer interrupt handler, which runs on the
+   bootstrap processor when the timer expires or another CPU
+   asks it to rearm the timer. */
+static void
+clock_event_interrupt (struct intr_frame *args)
+{
+  int64_t now = clock_now ();
+  int tick_cnt = 0;
+
+  clock_event_cnt++;
+
+  /* Run the ticks that passed since the last clock event, which
+     may be many if the CPU was idle. */
+  while ((ticks + 1) * NS_PER_TICK <= now)
+    {
+      ticks++;
+      tick_cnt++;
+      workqueue_tick (ticks);
+      thread_tick ();
+    }
+  if (tick_cnt > 1)
+    skipped_ticks += tick_cnt - 1;
+  if (tick_cnt > 0)
+    profile_tick (args);
+
+  wake_sleepers (now);
+  clock_event_program ();
+}
+
+/* Arms the one-shot timer for the next event: the earliest
+   sleeper's wake-up time, delayed work, and, unless the running
+   thread is the idle thread, the next tick boundary.  Waits at
+   most a second, so that the TSC-based clock never goes long
+   without `ticks' catching up.  Must run on the bootstrap
+   processor with interrupts off. */
+static void
+clock_event_program (void)
+{
+  struct thread *cur = thread_current ();
+  int64_t now = clock_now ();
+  int64_t next = now + NS_PER_SEC;
+  int64_t work_tick;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (cur->cpu->id == 0);
+
+  if (cur != cur->cpu->idle_thread && (ticks + 1) * NS_PER_TICK < next)
+    next = (ticks + 1) * NS_PER_TICK;
+  if (!list_empty (&sleep_list))
+    {
+      struct thread *t = list_entry (list_front (&sleep_list),
+                                     struct thread, sleepelem);
+      if (t->wake_time < next)
+        next = t->wake_time;
+    }
+  work_tick = workqueue_next_tick ();
+  if (work_tick != INT64_MAX && work_tick * NS_PER_TICK < next)
+    next = work_tick * NS_PER_TICK;
+
+  armed_time = next;
+  lapic_timer_arm (next - now);
+}
+
+/* Blocks the running thread until the time since boot reaches
+   WAKE_TIME nanoseconds. */
+static void
+sleep_until (int64_t wake_time)
+{
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  sleep_insert (thread_current (), wake_time);
+  thread_block ();
+  intr_set_level (old_level);
+}
+
+/* Adds T, the running thread, to sleep_list to be woken up at
+   WAKE_TIME nanoseconds since boot.  Interrupts must be off. */
+static void
+sleep_insert (struct thread *t, int64_t wake_time)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  t->wake_time = wake_time;
+  list_insert_ordered (&sleep_list, &t->sleepelem, wake_time_less, NULL);
+
+  /* Make the one-shot timer expire in time for us. */
+  if (one_shot && wake_time < armed_time)
+    {
+      if (t->cpu->id == 0)
+        clock_event_program ();
+      else
+        lapic_send_ipi (cpus[0].apic_id, LAPIC_VEC_TIMER);
+    }
+}
+
+/* Wakes up every thread whose wake-up time is NOW or earlier.
+   A thread in a timed wait that is still blocked is first taken
+   off the list it waits on; one that has already been woken up
+   is merely taken off sleep_list.  Interrupts must be off. */
+static void
+wake_sleepers (int64_t now)
+{
+  while (!list_empty (&sleep_list))
+    {
+      struct thread *t = list_entry (list_front (&sleep_list),
+                                     struct thread, sleepelem);
+      if (t->wake_time > now)
+        break;
+      list_pop_front (&sleep_list);
+      if (!t->timed_wait)
+        thread_unblock (t);
+      else
+        {
+          t->timed_wait = false;
+          if (t->status == THREAD_BLOCKED)
+            {
+              list_remove (&t->elem);
+              t->timed_out = true;
+              thread_unblock (t);
+            }
+        }
+    }
+}
+
+/* Returns true if the thread owning sleep list element A wakes
+   up strictly before the one owning B. */
+static bool
+wake_time_less (const struct list_elem *a, const struct list_elem *b,
+                void *aux UNUSED)
+{
+  return (list_entry (a, struct thread, sleepelem)->wake_time
+          < list_entry (b, struct thread, sleepelem)->wake_time);
+}
+
+/* Returns the time-stamp counter. */
+static uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Returns the time since boot, in ns, according to the TSC.
+   Splitting the cycle count into whole seconds and a remainder
+   keeps the multiplication from overflowing. */
+static int64_t
+clock_now (void)
+{
+  uint64_t cycles = rdtsc () - tsc_base;
+
+  return (ns_base
+          + cycles / tsc_freq * NS_PER_SEC
+          + cycles % tsc_freq * NS_PER_SEC / tsc_freq);
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -220,7 +588,14 @@ real_time_sleep (int64_t num, int32_t denom)
   int64_t ticks = num * TIMER_FREQ / denom;
 
   ASSERT (intr_get_level () == INTR_ON);
-  if (ticks > 0)
+  if (one_shot)
+    {
+      /* The one-shot timer can wake us at any time, so block
+         for the exact interval, however short. */
+      if (num > 0)
+        sleep_until (clock_now () + num * (NS_PER_SEC / denom));
+    }
+  else if (ticks > 0)
     {
       /* We're waiting for at least one full timer tick.  Use
          timer_sleep() because it will yield the CPU to other
@@ -2,22 +2,38 @@
 #define DEVICES_TIMER_H
 
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
 
+/* If false (default), the PIT interrupts TIMER_FREQ times per
+   second.  If true, the local APIC timer is used in one-shot mode
+   when there is one, and ticks are skipped while idle.
+   Controlled by kernel command-line option "-tickless". */
+extern bool timer_tickless;
+
 void timer_init (void);
 void timer_calibrate (void);
+void timer_tickless_init (void);
+bool timer_is_tickless (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
+int64_t timer_ns (void);
+
+/* Hooks for the idle thread. */
+void timer_idle_enter (void);
+void timer_idle_exit (void);
 
 /* Sleep and yield the CPU to other threads. */
 void timer_sleep (int64_t ticks);
 void timer_msleep (int64_t milliseconds);
 void timer_usleep (int64_t microseconds);
 void timer_nsleep (int64_t nanoseconds);
+void timer_sleep_until (int64_t tick);
+bool timer_block_until (int64_t tick);
 
 /* Busy waits. */
 void timer_mdelay (int64_t milliseconds);
@@ -0,0 +1,114 @@
+/* forkbench.c
+
+   Compares two ways of handing work to a child process: fork(),
+   whose child shares the parent's warmed-up memory copy-on-write,
+   and exec(), whose child loads the program from disk and has to
+   warm up again by itself.  The work is the same either way: look
+   through a table that takes a while to build.  Reports the
+   average time from starting a child to reaping it, in time stamp
+   counter cycles. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+
+#define ROUNDS 10
+#define TABLE_SIZE (64 * 1024)
+
+/* Table built by warm_up(), 256 kB. */
+static int table[TABLE_SIZE];
+
+/* Reads the time stamp counter. */
+static inline unsigned long long
+rdtsc (void)
+{
+  unsigned long long tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Builds the table. */
+static void
+warm_up (void)
+{
+  int i, j;
+
+  for (i = 0; i < TABLE_SIZE; i++)
+    {
+      int x = i;
+      for (j = 0; j < 16; j++)
+        x = x * 1103515245 + 12345;
+      table[i] = x;
+    }
+}
+
+/* Does a child's work with the table and returns a result that
+   fits in an exit status. */
+static int
+work (void)
+{
+  unsigned sum = 0;
+  int i;
+
+  for (i = 0; i < TABLE_SIZE; i += 16)
+    sum += table[i];
+  return sum & 0x7f;
+}
+
+/* Starts a child with START, reaps it, and returns the cycles it
+   took, or 0 if the child failed or got the wrong result. */
+static unsigned long long
+run_child (pid_t (*start) (void), int expected)
+{
+  unsigned long long begin = rdtsc ();
+  pid_t pid = start ();
+
+  if (pid < 0 || wait (pid) != expected)
+    return 0;
+  return rdtsc () - begin;
+}
+
+static pid_t
+start_fork (void)
+{
+  pid_t pid = fork ();
+  if (pid == 0)
+    exit (work ());
+  return pid;
+}
+
+static pid_t
+start_exec (void)
+{
+  return exec ("forkbench -child");
+}
+
+int
+main (int argc, char *argv[])
+{
+  unsigned long long fork_cycles = 0, exec_cycles = 0;
+  int expected;
+  int i;
+
+  warm_up ();
+  expected = work ();
+  if (argc > 1 && !strcmp (argv[1], "-child"))
+    return expected;
+
+  for (i = 0; i < ROUNDS; i++)
+    {
+      unsigned long long fork_time = run_child (start_fork, expected);
+      unsigned long long exec_time = run_child (start_exec, expected);
+      if (fork_time == 0 || exec_time == 0)
+        {
+          printf ("forkbench: child failed\n");
+          return EXIT_FAILURE;
+        }
+      fork_cycles += fork_time;
+      exec_cycles += exec_time;
+    }
+
+  printf ("fork+work: %llu cycles per child\n", fork_cycles / ROUNDS);
+  printf ("exec+work: %llu cycles per child\n", exec_cycles / ROUNDS);
+  return EXIT_SUCCESS;
+}
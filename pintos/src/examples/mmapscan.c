@@ -0,0 +1,114 @@
+/* mmapscan.c
+
+   Compares two ways of scanning a file: read() into a buffer a
+   block at a time, which copies every byte out of the file
+   system's buffer cache, and mmap(), which brings each page in
+   once and then lets the program read it in place.  Scans each
+   file named on the command line both ways and reports the time
+   per kilobyte of each in time stamp counter cycles. */
+
+#include <stdio.h>
+#include <syscall.h>
+
+/* Where the file is mapped. */
+#define MAP_ADDR ((const unsigned char *) 0x10000000)
+
+static unsigned char buf[4096];
+
+/* Reads the time stamp counter. */
+static inline unsigned long long
+rdtsc (void)
+{
+  unsigned long long tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Sums the bytes of open file FD with read(). */
+static unsigned
+scan_read (int fd)
+{
+  unsigned sum = 0;
+  int n;
+
+  seek (fd, 0);
+  while ((n = read (fd, buf, sizeof buf)) > 0)
+    {
+      int i;
+      for (i = 0; i < n; i++)
+        sum += buf[i];
+    }
+  return sum;
+}
+
+/* Sums the SIZE bytes of open file FD through a mapping.  Sets
+   *OK to false if it cannot be mapped. */
+static unsigned
+scan_mmap (int fd, int size, bool *ok)
+{
+  unsigned sum = 0;
+  mapid_t map;
+  int i;
+
+  map = mmap (fd, (void *) MAP_ADDR);
+  if (map == MAP_FAILED)
+    {
+      *ok = false;
+      return 0;
+    }
+  for (i = 0; i < size; i++)
+    sum += MAP_ADDR[i];
+  munmap (map);
+  *ok = true;
+  return sum;
+}
+
+int
+main (int argc, char *argv[])
+{
+  int i;
+
+  for (i = 1; i < argc; i++)
+    {
+      unsigned long long start, read_cycles, mmap_cycles;
+      unsigned read_sum, mmap_sum;
+      int fd, size, kb;
+      bool ok;
+
+      fd = open (argv[i]);
+      if (fd < 0)
+        {
+          printf ("%s: open failed\n", argv[i]);
+          return EXIT_FAILURE;
+        }
+      size = filesize (fd);
+      kb = size / 1024 > 0 ? size / 1024 : 1;
+
+      /* Scan once untimed, so that both timed scans start with
+         the file in the buffer cache. */
+      scan_read (fd);
+
+      start = rdtsc ();
+      read_sum = scan_read (fd);
+      read_cycles = rdtsc () - start;
+
+      start = rdtsc ();
+      mmap_sum = scan_mmap (fd, size, &ok);
+      mmap_cycles = rdtsc () - start;
+      if (!ok)
+        {
+          printf ("%s: mmap failed\n", argv[i]);
+          return EXIT_FAILURE;
+        }
+      if (read_sum != mmap_sum)
+        {
+          printf ("%s: read() and mmap() disagree\n", argv[i]);
+          return EXIT_FAILURE;
+        }
+
+      printf ("%s: %d bytes, read() %llu cycles/kB, mmap() %llu cycles/kB\n",
+              argv[i], size, read_cycles / kb, mmap_cycles / kb);
+      close (fd);
+    }
+  return EXIT_SUCCESS;
+}
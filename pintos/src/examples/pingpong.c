@@ -0,0 +1,72 @@
+/* pingpong.c
+
+   Measures how long it takes two threads to hand a turn back
+   and forth through a mutex and a condition variable, which
+   costs a futex_wait() and a futex_wake() per hand-off when the
+   threads do not run in parallel.  Reports the average cost of a
+   round trip in time stamp counter cycles. */
+
+#include <stdio.h>
+#include <synch.h>
+#include <syscall.h>
+
+#define ROUNDS 10000
+
+static struct mutex mutex = MUTEX_INITIALIZER;
+static struct condvar turn_changed = CONDVAR_INITIALIZER;
+static int turn;                /* 0 for ping's turn, 1 for pong's. */
+
+/* Reads the time stamp counter. */
+static inline unsigned long long
+rdtsc (void)
+{
+  unsigned long long tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Takes ROUNDS turns as player ME. */
+static void
+play (int me)
+{
+  int i;
+
+  for (i = 0; i < ROUNDS; i++)
+    {
+      mutex_lock (&mutex);
+      while (turn != me)
+        condvar_wait (&turn_changed, &mutex);
+      turn = !me;
+      condvar_signal (&turn_changed);
+      mutex_unlock (&mutex);
+    }
+}
+
+static void *
+pong (void *aux UNUSED)
+{
+  play (1);
+  return NULL;
+}
+
+int
+main (void)
+{
+  unsigned long long start, end;
+  tid_t tid;
+
+  start = rdtsc ();
+  tid = thread_spawn (pong, NULL);
+  if (tid == TID_ERROR)
+    {
+      printf ("pingpong: could not create thread\n");
+      return EXIT_FAILURE;
+    }
+  play (0);
+  thread_join (tid, NULL);
+  end = rdtsc ();
+
+  printf ("%d round trips, %llu cycles each\n",
+          ROUNDS, (end - start) / ROUNDS);
+  return EXIT_SUCCESS;
+}
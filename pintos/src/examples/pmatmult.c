@@ -0,0 +1,60 @@
+/* pmatmult.c
+
+   Parallel version of matmult.c.  Multiplies the same matrices
+   with several threads, each computing a band of rows of the
+   product, and exits with the same value as matmult. */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <syscall.h>
+
+#define DIM 128
+#define THREAD_CNT 4
+
+int A[DIM][DIM];
+int B[DIM][DIM];
+int C[DIM][DIM];
+
+/* Computes rows [FIRST, FIRST + DIM / THREAD_CNT) of C. */
+static void *
+multiply (void *first_)
+{
+  int first = (int) first_;
+  int i, j, k;
+
+  for (i = first; i < first + DIM / THREAD_CNT; i++)
+    for (j = 0; j < DIM; j++)
+      for (k = 0; k < DIM; k++)
+	C[i][j] += A[i][k] * B[k][j];
+  return NULL;
+}
+
+int
+main (void)
+{
+  pthread_t threads[THREAD_CNT];
+  int i, j;
+
+  /* Initialize the matrices. */
+  for (i = 0; i < DIM; i++)
+    for (j = 0; j < DIM; j++)
+      {
+	A[i][j] = i;
+	B[i][j] = j;
+	C[i][j] = 0;
+      }
+
+  /* Multiply matrices. */
+  for (i = 0; i < THREAD_CNT; i++)
+    if (pthread_create (&threads[i], multiply,
+                        (void *) (i * (DIM / THREAD_CNT))) != 0)
+      {
+        printf ("pmatmult: could not create thread %d\n", i);
+        exit (-1);
+      }
+  for (i = 0; i < THREAD_CNT; i++)
+    pthread_join (threads[i], NULL);
+
+  /* Done. */
+  exit (C[DIM - 1][DIM - 1]);
+}
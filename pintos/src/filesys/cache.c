@@ -6,6 +6,9 @@
 #include "threads/malloc.h"
 #include "filesys/filesys.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/trace.h"
+#include "threads/workqueue.h"
 
 #include <stdio.h>
 #define CACHE_SIZE 64
@@ -13,7 +16,7 @@
 struct cache_block
   {
     int dirty;                        /* Dirty bit */
-    struct lock block_lock;           /* Lock for block */
+    struct rwlock block_lock;         /* Lock for block */
     struct list_elem elem;            /* Element in cache_list */
     block_sector_t sector;            /* Sector number for this block */
     uint8_t data[BLOCK_SECTOR_SIZE];  /* Store data here */
@@ -22,8 +25,39 @@ struct cache_block
 /* List of blocks in the cache. */
 static struct list cache_list;
 
-/* Lock for the cache. */
-struct lock cache_lock;
+/* Lock for the cache.  Lookups only read cache_list, so they
+   hold it for reading. */
+struct rwlock cache_lock;
+
+/* A dirty block on its way to disk.  Evicting a dirty block
+   copies its data into one of these and leaves the slow
+   block_write() to a worker thread.  Until that finishes, the
+   copy is the latest version of the sector, so reading the
+   sector back into the cache must take it from here instead of
+   from disk. */
+struct write_back
+  {
+    struct work work;                 /* Work queue entry. */
+    struct list_elem elem;            /* Element in write_back_list. */
+    block_sector_t sector;            /* Sector number. */
+    bool stale;                       /* Superseded by a newer copy? */
+    bool writing;                     /* In block_write() now? */
+    uint8_t data[BLOCK_SECTOR_SIZE];  /* Data to write. */
+  };
+
+/* Blocks being written back, newest first, and their lock.
+   The lock is not held across block_write().  A newer write-back
+   of a sector marks older ones stale, so that they are never
+   started, and waits on write_back_done for one already in
+   block_write() to finish, so that the older data cannot land on
+   disk after it. */
+static struct list write_back_list;
+static struct lock write_back_lock;
+static struct condition write_back_done;
+
+static void write_back_work (void *);
+static bool read_write_back (block_sector_t, void *);
+static bool sector_writing (block_sector_t);
 
 /* Testing buffer cache's effectiveness */
 // might need lock for this
@@ -35,11 +69,14 @@ void
 cache_init (void)
 {
   list_init (&cache_list);
-  lock_init (&cache_lock);
+  rw_init (&cache_lock, true);
+  list_init (&write_back_list);
+  lock_init (&write_back_lock);
+  cond_init (&write_back_done);
 
   int i;
   struct cache_block *cb;
-  lock_acquire (&cache_lock);
+  rw_write_acquire (&cache_lock);
   for (i = 0; i < CACHE_SIZE; i++)
     {
       cb = malloc (sizeof (struct cache_block));
@@ -50,10 +87,10 @@ cache_init (void)
         }
       cb->dirty = 0;
       cb->sector = -1;
-      lock_init (&cb->block_lock);
+      rw_init (&cb->block_lock, true);
       list_push_front (&cache_list, &cb->elem);
     }
-  lock_release (&cache_lock);
+  rw_write_release (&cache_lock);
   cache_hit = 0;
   cache_miss = 0;
 }
@@ -63,7 +100,11 @@ free_cache (void)
 {
   struct list_elem *e;
   struct cache_block *cb;
-  lock_acquire (&cache_lock);
+
+  /* Deferred work may still read through the cache. */
+  workqueue_flush (system_wq);
+
+  rw_write_acquire (&cache_lock);
   while (!list_empty (&cache_list))
     {
       e = list_pop_back (&cache_list);
@@ -71,7 +112,8 @@ free_cache (void)
       evict_block (cb);
       free (cb);
     }
-  lock_release (&cache_lock);
+  rw_write_release (&cache_lock);
+  workqueue_flush (system_wq);
   cache_hit = 0;
   cache_miss = 0;
 }
@@ -82,31 +124,120 @@ struct cache_block *
 find_cache_block (block_sector_t sector)
 {
   struct list_elem *e;
-  lock_acquire (&cache_lock);
+  rw_read_acquire (&cache_lock);
   for (e = list_begin (&cache_list); e != list_end (&cache_list);
        e = list_next (e))
     {
       struct cache_block *cb = list_entry (e, struct cache_block, elem);
       if (cb->sector == sector)
         {
-          lock_release (&cache_lock);
+          rw_read_release (&cache_lock);
           return cb;
         }
     }
-  lock_release (&cache_lock);
+  rw_read_release (&cache_lock);
   return NULL;
 }
 
-/* Evict last block in cache_list. */
+/* Evict last block in cache_list.  If it is dirty, hands it to a
+   worker thread to write back to disk. */
 void
 evict_block (struct cache_block *cb)
 {
-  lock_acquire (&cb->block_lock);
+  rw_read_acquire (&cb->block_lock);
+  TRACE (TRACE_CACHE_EVICT, cb->sector, cb->dirty, 0);
   if (cb->dirty)
     {
-      block_write (fs_device, cb->sector, cb->data);
+      struct write_back *wb = malloc (sizeof *wb);
+      if (wb != NULL)
+        {
+          struct list_elem *e;
+
+          wb->sector = cb->sector;
+          wb->stale = false;
+          wb->writing = false;
+          memcpy (wb->data, cb->data, BLOCK_SECTOR_SIZE);
+          lock_acquire (&write_back_lock);
+          for (e = list_begin (&write_back_list);
+               e != list_end (&write_back_list); e = list_next (e))
+            {
+              struct write_back *old = list_entry (e, struct write_back, elem);
+              if (old->sector == wb->sector)
+                old->stale = true;
+            }
+          list_push_front (&write_back_list, &wb->elem);
+          lock_release (&write_back_lock);
+          work_init (&wb->work, write_back_work, wb, PRI_DEFAULT);
+          workqueue_submit (system_wq, &wb->work);
+        }
+      else
+        block_write (fs_device, cb->sector, cb->data);
+    }
+  rw_read_release (&cb->block_lock);
+}
+
+/* Work function that writes the struct write_back WB_ to disk,
+   then frees it. */
+static void
+write_back_work (void *wb_)
+{
+  struct write_back *wb = wb_;
+
+  lock_acquire (&write_back_lock);
+  while (!wb->stale && sector_writing (wb->sector))
+    cond_wait (&write_back_done, &write_back_lock);
+  if (!wb->stale)
+    {
+      wb->writing = true;
+      lock_release (&write_back_lock);
+      block_write (fs_device, wb->sector, wb->data);
+      lock_acquire (&write_back_lock);
+      cond_broadcast (&write_back_done, &write_back_lock);
+    }
+  list_remove (&wb->elem);
+  lock_release (&write_back_lock);
+  free (wb);
+}
+
+/* Returns true if a write-back of SECTOR is in block_write().
+   The caller must hold write_back_lock. */
+static bool
+sector_writing (block_sector_t sector)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&write_back_list); e != list_end (&write_back_list);
+       e = list_next (e))
+    {
+      struct write_back *wb = list_entry (e, struct write_back, elem);
+      if (wb->sector == sector && wb->writing)
+        return true;
+    }
+  return false;
+}
+
+/* If SECTOR is being written back, copies its latest data into
+   BUFFER and returns true.  Otherwise, returns false. */
+static bool
+read_write_back (block_sector_t sector, void *buffer)
+{
+  struct list_elem *e;
+  bool found = false;
+
+  lock_acquire (&write_back_lock);
+  for (e = list_begin (&write_back_list); e != list_end (&write_back_list);
+       e = list_next (e))
+    {
+      struct write_back *wb = list_entry (e, struct write_back, elem);
+      if (wb->sector == sector)
+        {
+          memcpy (buffer, wb->data, BLOCK_SECTOR_SIZE);
+          found = true;
+          break;
+        }
     }
-  lock_release (&cb->block_lock);
+  lock_release (&write_back_lock);
+  return found;
 }
 
 
@@ -115,10 +246,10 @@ evict_block (struct cache_block *cb)
 void
 update_lru (struct cache_block *cb)
 {
-  lock_acquire (&cache_lock);
+  rw_write_acquire (&cache_lock);
   list_remove (&cb->elem);
   list_push_front (&cache_list, &cb->elem);
-  lock_release (&cache_lock);
+  rw_write_release (&cache_lock);
 }
 
 
@@ -130,29 +261,32 @@ get_data (block_sector_t sector)
     {
       update_lru (cb);
       cache_hit++;
+      TRACE (TRACE_CACHE_HIT, sector, 0, 0);
     }
   if (!cb)
     {
-      lock_acquire (&cache_lock);
+      rw_write_acquire (&cache_lock);
       struct list_elem *e = list_pop_back (&cache_list);
       cb = list_entry (e, struct cache_block, elem);
-      lock_release (&cache_lock);
+      rw_write_release (&cache_lock);
 
       /* Check if block is dirty and write to disk. */
       evict_block (cb);
 
       /* Load in new block from disk into cb->data. */
-      lock_acquire (&cb->block_lock);
-      block_read (fs_device, sector, cb->data);
+      rw_write_acquire (&cb->block_lock);
+      if (!read_write_back (sector, cb->data))
+        block_read (fs_device, sector, cb->data);
       cb->dirty = 0;
       cb->sector = sector;
-      lock_release (&cb->block_lock);
+      rw_write_release (&cb->block_lock);
 
       /* Push block back to list */
-      lock_acquire (&cache_lock);
+      rw_write_acquire (&cache_lock);
       list_push_front (&cache_list, &cb->elem);
-      lock_release (&cache_lock);
+      rw_write_release (&cache_lock);
       cache_miss++;
+      TRACE (TRACE_CACHE_MISS, sector, 0, 0);
     }
   return cb;
 }
@@ -164,8 +298,10 @@ read_cache_block (block_sector_t sector, void *buffer, off_t offset, off_t size)
   struct cache_block *cb = get_data (sector);
   if (cb == NULL)
     return NULL;
+  rw_read_acquire (&cb->block_lock);
   bounce = cb->data;
   memcpy (buffer, bounce + offset, size);
+  rw_read_release (&cb->block_lock);
   return bounce;
 }
 
@@ -178,14 +314,14 @@ write_cache_block (block_sector_t sector, void *buffer, off_t offset, off_t size
     return NULL;
 
   /* Write buffer into cb->data */
-  lock_acquire (&cb->block_lock);
+  rw_write_acquire (&cb->block_lock);
 
   cb->sector = sector;
   cb->dirty = 1;
 
-  lock_release (&cb->block_lock);
   bounce = cb->data;
   memcpy (bounce + offset, buffer, size);
+  rw_write_release (&cb->block_lock);
   return bounce;
 }
 
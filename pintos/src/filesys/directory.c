@@ -107,6 +107,9 @@ lookup (const struct dir *dir, const char *name,
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  /* Hold the directory for reading across the whole scan, so
+     that lookups in the same directory proceed together. */
+  inode_read_lock (dir->inode);
   for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
        ofs += sizeof e)
     if (e.in_use && !strcmp (name, e.name))
@@ -115,8 +118,10 @@ lookup (const struct dir *dir, const char *name,
           *ep = e;
         if (ofsp != NULL)
           *ofsp = ofs;
+        inode_read_unlock (dir->inode);
         return true;
       }
+  inode_read_unlock (dir->inode);
   return false;
 }
 
@@ -6,8 +6,11 @@
 #include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/rcu.h"
 #include "threads/synch.h"
+#include "threads/workqueue.h"
 
 #include <stdio.h>
 /* Identifies an inode. */
@@ -41,12 +44,13 @@ struct inode
   {
     struct list_elem elem;              /* Element in inode list. */
     block_sector_t sector;              /* Sector number of disk location. */
-    int open_cnt;                       /* Number of openers. */
+    int open_cnt;                       /* Number of openers, see below. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
     struct inode_disk data;             /* Inode content. */
-    struct lock lock;                   /* Lock */
+    struct rwlock rw;                   /* Protects data. */
     bool dirty;
+    struct rcu_head rcu;                /* Frees inode after close. */
   };
 
 /* Structure to store data on indirect pointers. */
@@ -103,9 +107,45 @@ byte_to_sector (const struct inode *inode, off_t pos)
 }
 
 /* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
+   returns the same `struct inode'.
+
+   inode_open() runs for every component of every path that is
+   looked up, so it searches open_inodes under RCU, without
+   taking any lock.  Only changes to the list take
+   inode_list_lock, and inode_close() frees an inode a grace
+   period after taking it off the list.  An inode on the list
+   whose open_cnt has dropped to 0 is being closed and may no
+   longer be reopened.  To make this check and the increment
+   that follows it atomic, open_cnt only changes with interrupts
+   off.
+
+   The last inode_close() drops open_cnt to 0, writes the inode
+   back into the cache if it is dirty, and takes it off the list
+   all under inode_list_lock.  A write-back also bumps close_gen,
+   so that an inode_open() that read the sector without the lock
+   can tell that it may have read it too early and must read it
+   again. */
 static struct list open_inodes;
-struct lock inode_list_lock;
+static struct lock inode_list_lock;
+static unsigned close_gen;
+
+/* Deferred write-backs of closed inodes' indirect blocks, as
+   struct write_back, and their lock.  A write-back works from a
+   copy of the inode taken at close, which goes stale once the
+   inode is opened again, because the new opener may remove it
+   and free the blocks that the copy points to.  So opening an
+   inode or freeing its blocks first cancels any write-back of
+   it that has not started and waits for one that has, signaled
+   by write_back_done. */
+static struct list write_back_list;
+static struct lock write_back_lock;
+static struct condition write_back_done;
+
+static void write_back_indirect (const struct inode_disk *);
+static void submit_write_back (block_sector_t, const struct inode_disk *);
+static void cancel_write_back (block_sector_t);
+static struct inode *inode_find (block_sector_t sector);
+static rcu_func inode_free;
 
 /* Initializes the inode module. */
 void
@@ -113,6 +153,9 @@ inode_init (void)
 {
   list_init (&open_inodes);
   lock_init (&inode_list_lock);
+  list_init (&write_back_list);
+  lock_init (&write_back_lock);
+  cond_init (&write_back_done);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -251,24 +294,19 @@ inode_allocate (size_t cnt, struct inode_disk *disk_inode)
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
-  struct inode *inode;
+  struct inode *inode, *other;
+  unsigned gen;
 
   /* Check whether this inode is already open. */
-  lock_acquire (&inode_list_lock);
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e))
-    {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector)
-        {
-          inode_reopen (inode);
-          lock_release (&inode_list_lock);
-          return inode;
-        }
-    }
+  rcu_read_lock ();
+  inode = inode_find (sector);
+  rcu_read_unlock ();
+  if (inode != NULL)
+    return inode;
 
-  lock_release (&inode_list_lock);
+  /* A write-back left over from when SECTOR was last open would
+     go stale once it is open again. */
+  cancel_write_back (sector);
 
   /* Allocate memory. */
   inode = malloc (sizeof *inode);
@@ -276,29 +314,82 @@ inode_open (block_sector_t sector)
     return NULL;
 
   /* Initialize. */
-  lock_acquire (&inode_list_lock);
-  list_push_front (&open_inodes, &inode->elem);
-  lock_release (&inode_list_lock);
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
   inode->dirty = false;
-  lock_init (&inode->lock);
+  rw_init (&inode->rw, false);
 
   /* Read inode_disk data */
+  gen = close_gen;
+  barrier ();
   read_cache_block (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+
+  /* Publish the inode, unless someone else opened SECTOR while
+     we were reading it.  If an inode was written back meanwhile,
+     it may have been SECTOR's, after we read it. */
+  lock_acquire (&inode_list_lock);
+  other = inode_find (sector);
+  if (other == NULL)
+    {
+      if (close_gen != gen)
+        read_cache_block (inode->sector, &inode->data, 0,
+                          BLOCK_SECTOR_SIZE);
+      rcu_list_push_front (&open_inodes, &inode->elem);
+    }
+  lock_release (&inode_list_lock);
+  if (other != NULL)
+    {
+      free (inode);
+      return other;
+    }
   return inode;
 }
 
+/* Returns the open inode for SECTOR, reopened, or a null pointer
+   if there is none.  The caller must be in an RCU read-side
+   critical section or hold inode_list_lock. */
+static struct inode *
+inode_find (block_sector_t sector)
+{
+  struct list_elem *e;
+
+  ASSERT (rcu_read_lock_held ()
+          || lock_held_by_current_thread (&inode_list_lock));
+
+  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
+       e = list_next (e))
+    {
+      struct inode *inode = list_entry (e, struct inode, elem);
+      if (inode->sector == sector)
+        {
+          enum intr_level old_level = intr_disable ();
+          bool closing = inode->open_cnt == 0;
+          if (!closing)
+            inode->open_cnt++;
+          intr_set_level (old_level);
+
+          /* Skip an inode that is being closed, so that the
+             caller opens SECTOR afresh. */
+          if (!closing)
+            return inode;
+        }
+    }
+  return NULL;
+}
+
 /* Reopens and returns INODE. */
 struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    lock_acquire (&inode->lock);
-    inode->open_cnt++;
-    lock_release (&inode->lock);
+    {
+      enum intr_level old_level = intr_disable ();
+      ASSERT (inode->open_cnt > 0);
+      inode->open_cnt++;
+      intr_set_level (old_level);
+    }
   return inode;
 }
 
@@ -321,45 +412,80 @@ inode_get_open_cnt (const struct inode *inode)
 void
 inode_close (struct inode *inode)
 {
+  enum intr_level old_level;
+  bool last;
+
   /* Ignore null pointer. */
   if (inode == NULL)
     return;
 
-  /* Release resources if this was the last opener. */
-  lock_acquire (&inode->lock);
-  if (--inode->open_cnt == 0)
+  /* Drop a reference that is not the last without the lock. */
+  old_level = intr_disable ();
+  last = inode->open_cnt == 1;
+  if (!last)
+    inode->open_cnt--;
+  intr_set_level (old_level);
+  if (last)
     {
-      /* Remove from inode list and release lock. */
+      /* Check again under the lock, since inode_find() may have
+         reopened INODE meanwhile. */
       lock_acquire (&inode_list_lock);
-      list_remove (&inode->elem);
-      lock_release (&inode_list_lock);
-
-      /* If dirty, write block metadata to disk*/
+      old_level = intr_disable ();
+      last = --inode->open_cnt == 0;
+      intr_set_level (old_level);
+      if (!last)
+        lock_release (&inode_list_lock);
+    }
+  if (last)
+    {
+      /* If dirty, write the inode into the cache before removing
+         it from the list, so that a new opener of its sector
+         reads the latest version. */
       if (inode->dirty)
         {
-          write_cache_block (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
-          inode_write_to_disk (inode);
+          write_cache_block (inode->sector, &inode->data, 0,
+                             BLOCK_SECTOR_SIZE);
+          close_gen++;
         }
+      rcu_list_remove (&inode->elem);
+      lock_release (&inode_list_lock);
+
+      /* Writing out the indirect blocks is slow, so leave it to
+         a worker thread, unless the blocks are about to be freed
+         anyway. */
+      if (inode->dirty && !inode->removed)
+        submit_write_back (inode->sector, &inode->data);
 
       /* Deallocate blocks if removed. */
       if (inode->removed)
         {
           free_map_release (inode->sector, 1);
-          inode_release (&inode->data);
+          inode_release (inode->sector, &inode->data);
         }
-      lock_release (&inode->lock);
-      free (inode);
+
+      /* inode_open() may still be looking at INODE. */
+      call_rcu (&inode->rcu, inode_free);
     }
-  else
-    lock_release (&inode->lock);
+}
+
+/* Frees a closed inode.  Used as an RCU callback. */
+static void
+inode_free (struct rcu_head *head)
+{
+  free (rcu_entry (head, struct inode, rcu));
 }
 
 void
 inode_write_to_disk (struct inode *inode)
 {
   write_cache_block (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+  write_back_indirect (&inode->data);
+}
 
-  struct inode_disk *disk = &inode->data;
+/* Writes the indirect blocks of DISK from the cache to disk. */
+static void
+write_back_indirect (const struct inode_disk *disk)
+{
   struct indirect_block indirect;
   if (disk->indirect != 0)
     {
@@ -371,10 +497,12 @@ inode_write_to_disk (struct inode *inode)
     {
       struct indirect_block *doubly_indirect;
       doubly_indirect = calloc (1, sizeof (struct indirect_block));
-      read_cache_block (disk->doubly_indirect, &doubly_indirect, 0, BLOCK_SECTOR_SIZE);
+      read_cache_block (disk->doubly_indirect, doubly_indirect, 0, BLOCK_SECTOR_SIZE);
       size_t i;
       for (i = 0; i < NUM_PTRS_IN_BLOCK; i++)
         {
+          if (doubly_indirect->data[i] == 0)
+            continue;
           read_cache_block (doubly_indirect->data[i], &indirect, 0, BLOCK_SECTOR_SIZE);
           block_write (fs_device, doubly_indirect->data[i], &indirect);
         }
@@ -382,10 +510,91 @@ inode_write_to_disk (struct inode *inode)
     }
 }
 
+/* Deferred write-back of an inode's indirect blocks. */
+struct write_back
+  {
+    struct work work;                   /* Work queue entry. */
+    struct list_elem elem;              /* Element in write_back_list. */
+    block_sector_t sector;              /* Inode's sector. */
+    struct inode_disk data;             /* Copy of the inode. */
+  };
+
+/* Work function that writes back the indirect blocks of a
+   struct write_back, then frees it. */
+static void
+write_back_work (void *wb_)
+{
+  struct write_back *wb = wb_;
+
+  write_back_indirect (&wb->data);
+  lock_acquire (&write_back_lock);
+  list_remove (&wb->elem);
+  cond_broadcast (&write_back_done, &write_back_lock);
+  lock_release (&write_back_lock);
+  free (wb);
+}
+
+/* Arranges for the indirect blocks of DISK, the inode in SECTOR,
+   to be written to disk by a worker thread.  Does it right away
+   if memory is short. */
+static void
+submit_write_back (block_sector_t sector, const struct inode_disk *disk)
+{
+  struct write_back *wb = malloc (sizeof *wb);
+  if (wb == NULL)
+    {
+      write_back_indirect (disk);
+      return;
+    }
+  wb->sector = sector;
+  wb->data = *disk;
+  work_init (&wb->work, write_back_work, wb, PRI_DEFAULT);
+  lock_acquire (&write_back_lock);
+  list_push_back (&write_back_list, &wb->elem);
+  lock_release (&write_back_lock);
+  workqueue_submit (system_wq, &wb->work);
+}
+
+/* Cancels the deferred write-backs of the inode in SECTOR that
+   have not started, and waits for any that have to finish. */
+static void
+cancel_write_back (block_sector_t sector)
+{
+  struct list_elem *e;
+
+  lock_acquire (&write_back_lock);
+  e = list_begin (&write_back_list);
+  while (e != list_end (&write_back_list))
+    {
+      struct write_back *wb = list_entry (e, struct write_back, elem);
+      if (wb->sector != sector)
+        e = list_next (e);
+      else if (workqueue_cancel (&wb->work))
+        {
+          e = list_remove (e);
+          free (wb);
+        }
+      else
+        {
+          /* Running now.  It takes itself off the list when it is
+             done, which may change the list, so start over. */
+          cond_wait (&write_back_done, &write_back_lock);
+          e = list_begin (&write_back_list);
+        }
+    }
+  lock_release (&write_back_lock);
+}
+
+/* Frees the data and indirect blocks of DISK, the inode in
+   SECTOR, but not SECTOR itself. */
 void
-inode_release (struct inode_disk *disk)
+inode_release (block_sector_t sector, struct inode_disk *disk)
 {
   size_t i;
+
+  /* A write-back would read the blocks after they are freed. */
+  cancel_write_back (sector);
+
   for (i = 0; i < NUM_DIRECT_PTRS; i++)
     if (disk->direct[i] != 0)
       free_map_release (disk->direct[i], 1);
@@ -439,12 +648,13 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
   off_t bytes_read = 0;
   uint8_t *bounce = NULL;
 
+  inode_read_lock (inode);
   while (size > 0)
     {
       /* Disk sector to read, starting byte offset within sector. */
       block_sector_t sector_idx = byte_to_sector (inode, offset);
       if (sector_idx == -1u)
-        return bytes_read;
+        break;
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
@@ -465,6 +675,7 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       offset += chunk_size;
       bytes_read += chunk_size;
     }
+  inode_read_unlock (inode);
 
   return bytes_read;
 }
@@ -485,23 +696,33 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
   if (inode->deny_write_cnt)
     return 0;
 
-  /* Extend file. */
-  if (offset + size > inode->data.length)
+  /* Extend file.  Readers must not see the new length before the
+     sectors behind it exist. */
+  if (offset + size > inode_length (inode))
     {
-      bool success = inode_allocate (bytes_to_sectors (offset + size - inode->data.length), &inode->data);
-      if (!success)
-        return 0;
+      rw_write_acquire (&inode->rw);
+      if (offset + size > inode->data.length)
+        {
+          bool success = inode_allocate (bytes_to_sectors (offset + size - inode->data.length), &inode->data);
+          if (!success)
+            {
+              rw_write_release (&inode->rw);
+              return 0;
+            }
 
-      inode->data.length = offset + size;
-      write_cache_block (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+          inode->data.length = offset + size;
+          write_cache_block (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+        }
+      rw_write_release (&inode->rw);
     }
 
+  inode_read_lock (inode);
   while (size > 0)
     {
       /* Sector to write, starting byte offset within sector. */
       block_sector_t sector_idx = byte_to_sector (inode, offset);
       if (sector_idx == -1u)
-        return bytes_written;
+        break;
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
@@ -524,10 +745,28 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       offset += chunk_size;
       bytes_written += chunk_size;
     }
+  inode_read_unlock (inode);
 
   return bytes_written;
 }
 
+/* Acquires INODE's data for reading, so that its length and
+   block pointers do not change until inode_read_unlock().  A
+   thread may acquire it for reading more than once, e.g. to call
+   inode_read_at() while holding it. */
+void
+inode_read_lock (struct inode *inode)
+{
+  rw_read_acquire (&inode->rw);
+}
+
+/* Releases INODE's data, acquired with inode_read_lock(). */
+void
+inode_read_unlock (struct inode *inode)
+{
+  rw_read_release (&inode->rw);
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 void
@@ -17,12 +17,14 @@ void inode_close (struct inode *);
 void inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+void inode_read_lock (struct inode *);
+void inode_read_unlock (struct inode *);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
 int inode_get_open_cnt (const struct inode *inode);
 bool inode_allocate (size_t cnt, struct inode_disk *disk_inode);
-void inode_release (struct inode_disk *disk);
+void inode_release (block_sector_t sector, struct inode_disk *disk);
 void inode_write_to_disk (struct inode *inode);
 
 /* Inode disk modifiers */
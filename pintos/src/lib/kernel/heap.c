@@ -0,0 +1,108 @@
+#include "heap.h"
+#include <debug.h>
+
+static struct heap_elem *merge (struct heap *,
+                                struct heap_elem *, struct heap_elem *);
+
+/* Returns the rank of E, which is 0 for a missing element. */
+static inline int
+rank (const struct heap_elem *e)
+{
+  return e != NULL ? e->rank : 0;
+}
+
+/* Initializes HEAP as an empty heap ordered by LESS, given
+   auxiliary data AUX. */
+void
+heap_init (struct heap *heap, heap_less_func *less, void *aux)
+{
+  ASSERT (heap != NULL);
+  ASSERT (less != NULL);
+
+  heap->root = NULL;
+  heap->elem_cnt = 0;
+  heap->less = less;
+  heap->aux = aux;
+}
+
+/* Inserts E into HEAP. */
+void
+heap_push (struct heap *heap, struct heap_elem *e)
+{
+  ASSERT (heap != NULL);
+  ASSERT (e != NULL);
+
+  e->left = e->right = NULL;
+  e->rank = 1;
+  heap->root = merge (heap, heap->root, e);
+  heap->elem_cnt++;
+}
+
+/* Removes the least element from HEAP and returns it.  Undefined
+   behavior if HEAP is empty. */
+struct heap_elem *
+heap_pop (struct heap *heap)
+{
+  struct heap_elem *top = heap_top (heap);
+
+  heap->root = merge (heap, top->left, top->right);
+  heap->elem_cnt--;
+  return top;
+}
+
+/* Returns the least element in HEAP, without removing it.
+   Undefined behavior if HEAP is empty. */
+struct heap_elem *
+heap_top (struct heap *heap)
+{
+  ASSERT (heap != NULL);
+  ASSERT (heap->root != NULL);
+
+  return heap->root;
+}
+
+/* Returns the number of elements in HEAP. */
+size_t
+heap_size (struct heap *heap)
+{
+  return heap->elem_cnt;
+}
+
+/* Returns true if HEAP is empty, false otherwise. */
+bool
+heap_empty (struct heap *heap)
+{
+  return heap->root == NULL;
+}
+
+/* Merges the heaps rooted at A and B, either of which may be
+   empty, and returns the root of the result.  Recurses only
+   down the right spines, whose lengths are logarithmic. */
+static struct heap_elem *
+merge (struct heap *heap, struct heap_elem *a, struct heap_elem *b)
+{
+  struct heap_elem *t;
+
+  if (a == NULL)
+    return b;
+  if (b == NULL)
+    return a;
+
+  /* Make A the root. */
+  if (heap->less (b, a, heap->aux))
+    {
+      t = a;
+      a = b;
+      b = t;
+    }
+
+  a->right = merge (heap, a->right, b);
+  if (rank (a->left) < rank (a->right))
+    {
+      t = a->left;
+      a->left = a->right;
+      a->right = t;
+    }
+  a->rank = rank (a->right) + 1;
+  return a;
+}
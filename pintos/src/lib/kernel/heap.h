@@ -0,0 +1,68 @@
+#ifndef __LIB_KERNEL_HEAP_H
+#define __LIB_KERNEL_HEAP_H
+
+/* Priority queue.
+
+   This is a leftist heap, a binary tree in which each element is
+   no greater than its children and, for each element, the
+   shortest path down to a missing child is at least as long on
+   the left as on the right.  The right spine of a heap of N
+   elements is thus at most log2(N+1) elements long, and two
+   heaps can be merged by walking down their right spines.  Both
+   heap_push() and heap_pop() are such merges, so they take
+   O(log n) time in the worst case.
+
+   Like the list and hash table implementations, the heap does
+   not use dynamic allocation.  Each structure that can be in a
+   heap must embed a struct heap_elem member, and heap_entry()
+   converts a struct heap_elem back to the structure that
+   contains it.  See lib/kernel/list.h for a detailed
+   explanation.
+
+   The heap is not stable: elements that compare equal come out
+   in no particular order. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Heap element. */
+struct heap_elem
+  {
+    struct heap_elem *left;     /* Left child. */
+    struct heap_elem *right;    /* Right child. */
+    int rank;                   /* Length of shortest path to a leaf. */
+  };
+
+/* Converts pointer to heap element HEAP_ELEM into a pointer to
+   the structure that HEAP_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the heap element. */
+#define heap_entry(HEAP_ELEM, STRUCT, MEMBER)           \
+        ((STRUCT *) ((uint8_t *) (HEAP_ELEM)            \
+                     - offsetof (STRUCT, MEMBER)))
+
+/* Compares the value of two heap elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool heap_less_func (const struct heap_elem *a,
+                             const struct heap_elem *b,
+                             void *aux);
+
+/* Heap. */
+struct heap
+  {
+    struct heap_elem *root;     /* Least element, or null if empty. */
+    size_t elem_cnt;            /* Number of elements in heap. */
+    heap_less_func *less;       /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `less'. */
+  };
+
+void heap_init (struct heap *, heap_less_func *, void *aux);
+void heap_push (struct heap *, struct heap_elem *);
+struct heap_elem *heap_pop (struct heap *);
+struct heap_elem *heap_top (struct heap *);
+size_t heap_size (struct heap *);
+bool heap_empty (struct heap *);
+
+#endif /* lib/kernel/heap.h */
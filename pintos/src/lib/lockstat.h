@@ -0,0 +1,24 @@
+#ifndef __LIB_LOCKSTAT_H
+#define __LIB_LOCKSTAT_H
+
+#include <stdint.h>
+
+/* Maximum length of a lock class name in struct lockstat. */
+#define LOCKSTAT_NAME_LEN 31
+
+/* Contention statistics for a class of kernel locks or
+   semaphores, as reported by the lockstat() system call.  Times
+   are in time stamp counter cycles.  Semaphores have no holder,
+   so their hold times are 0. */
+struct lockstat
+  {
+    char name[LOCKSTAT_NAME_LEN + 1];   /* Class name, null-terminated. */
+    uint64_t acquire_cnt;               /* Number of acquisitions. */
+    uint64_t contend_cnt;               /* Acquisitions that had to wait. */
+    uint64_t wait_total;                /* Total time spent waiting. */
+    uint64_t wait_max;                  /* Longest wait. */
+    uint64_t hold_total;                /* Total time held. */
+    uint64_t hold_max;                  /* Longest hold. */
+  };
+
+#endif /* lib/lockstat.h */
@@ -33,7 +33,26 @@ enum
     SYS_CACHE_STAT,
     SYS_FREE_CACHE,
     SYS_CACHE_READS,
-    SYS_CACHE_WRITES
+    SYS_CACHE_WRITES,
+
+    /* Kernel statistics. */
+    SYS_LOCKSTAT,               /* Reads lock contention statistics. */
+
+    /* User-space synchronization. */
+    SYS_FUTEX_WAIT,             /* Sleeps on a futex if it has a value. */
+    SYS_FUTEX_WAKE,             /* Wakes threads sleeping on a futex. */
+
+    /* User threads. */
+    SYS_THREAD_SPAWN,           /* Starts a thread in this process. */
+    SYS_THREAD_JOIN,            /* Waits for a thread to exit. */
+    SYS_THREAD_EXIT,            /* Terminates the calling thread. */
+
+    /* Copy-on-write processes. */
+    SYS_FORK,                   /* Clones the calling process. */
+
+    /* Stride scheduling. */
+    SYS_GET_TICKETS,            /* Returns the process's tickets. */
+    SYS_SET_TICKETS             /* Sets the process's tickets. */
   };
 
 #endif /* lib/syscall-nr.h */
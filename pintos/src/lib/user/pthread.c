@@ -0,0 +1,87 @@
+#include <pthread.h>
+
+/* Starts a thread running START(ARG) and stores its identifier
+   in *THREAD. */
+int
+pthread_create (pthread_t *thread, void *(*start) (void *), void *arg)
+{
+  tid_t tid = thread_spawn (start, arg);
+
+  if (tid == TID_ERROR)
+    return -1;
+  *thread = tid;
+  return 0;
+}
+
+/* Waits for THREAD to exit.  If RETVAL is nonnull, stores the
+   value that THREAD returned or passed to pthread_exit() in
+   *RETVAL. */
+int
+pthread_join (pthread_t thread, void **retval)
+{
+  return thread_join (thread, retval);
+}
+
+/* Terminates the calling thread with return value RETVAL. */
+void
+pthread_exit (void *retval)
+{
+  thread_exit (retval);
+}
+
+int
+pthread_mutex_init (pthread_mutex_t *mutex)
+{
+  mutex_init (mutex);
+  return 0;
+}
+
+int
+pthread_mutex_lock (pthread_mutex_t *mutex)
+{
+  mutex_lock (mutex);
+  return 0;
+}
+
+/* Locks MUTEX if it is unlocked.  Returns -1 without waiting if
+   it is locked. */
+int
+pthread_mutex_trylock (pthread_mutex_t *mutex)
+{
+  return mutex_trylock (mutex) ? 0 : -1;
+}
+
+int
+pthread_mutex_unlock (pthread_mutex_t *mutex)
+{
+  mutex_unlock (mutex);
+  return 0;
+}
+
+int
+pthread_cond_init (pthread_cond_t *cond)
+{
+  condvar_init (cond);
+  return 0;
+}
+
+int
+pthread_cond_wait (pthread_cond_t *cond, pthread_mutex_t *mutex)
+{
+  condvar_wait (cond, mutex);
+  return 0;
+}
+
+int
+pthread_cond_signal (pthread_cond_t *cond)
+{
+  condvar_signal (cond);
+  return 0;
+}
+
+int
+pthread_cond_broadcast (pthread_cond_t *cond)
+{
+  condvar_broadcast (cond);
+  return 0;
+}
@@ -0,0 +1,33 @@
+#ifndef __LIB_USER_PTHREAD_H
+#define __LIB_USER_PTHREAD_H
+
+#include <synch.h>
+#include <syscall.h>
+
+/* A small subset of POSIX threads, on top of the thread system
+   calls and the mutexes and condition variables of
+   lib/user/synch.h.  Functions that can fail return 0 on
+   success and -1 on failure; there are no error numbers. */
+
+typedef tid_t pthread_t;
+typedef struct mutex pthread_mutex_t;
+typedef struct condvar pthread_cond_t;
+
+#define PTHREAD_MUTEX_INITIALIZER MUTEX_INITIALIZER
+#define PTHREAD_COND_INITIALIZER CONDVAR_INITIALIZER
+
+int pthread_create (pthread_t *, void *(*start) (void *), void *arg);
+int pthread_join (pthread_t, void **retval);
+void pthread_exit (void *retval) NO_RETURN;
+
+int pthread_mutex_init (pthread_mutex_t *);
+int pthread_mutex_lock (pthread_mutex_t *);
+int pthread_mutex_trylock (pthread_mutex_t *);
+int pthread_mutex_unlock (pthread_mutex_t *);
+
+int pthread_cond_init (pthread_cond_t *);
+int pthread_cond_wait (pthread_cond_t *, pthread_mutex_t *);
+int pthread_cond_signal (pthread_cond_t *);
+int pthread_cond_broadcast (pthread_cond_t *);
+
+#endif /* lib/user/pthread.h */
@@ -0,0 +1,133 @@
+#include <synch.h>
+#include <limits.h>
+#include <syscall.h>
+
+/* Mutexes and condition variables for user programs.
+
+   The mutex is the one from Ulrich Drepper, "Futexes Are
+   Tricky."  A thread locks an unlocked mutex by changing its
+   state from 0 to 1 with an atomic compare-and-exchange.  A
+   thread that finds it locked sets the state to 2, to tell the
+   holder that someone may be waiting, and sleeps in
+   futex_wait() until the state changes.  The holder only calls
+   futex_wake() when it finds the state 2 on unlocking. */
+
+/* Atomically sets *P to NEW if it equals OLD.  Returns the old
+   value of *P. */
+static inline int
+atomic_cmpxchg (int *p, int old, int new)
+{
+  int prev;
+  asm volatile ("lock cmpxchgl %2, %1"
+                : "=a" (prev), "+m" (*p) : "r" (new), "0" (old) : "memory");
+  return prev;
+}
+
+/* Atomically sets *P to NEW and returns its old value. */
+static inline int
+atomic_xchg (int *p, int new)
+{
+  asm volatile ("xchgl %0, %1" : "+r" (new), "+m" (*p) : : "memory");
+  return new;
+}
+
+/* Atomically adds ADDEND to *P and returns its old value. */
+static inline int
+atomic_fetch_add (int *p, int addend)
+{
+  asm volatile ("lock xaddl %0, %1" : "+r" (addend), "+m" (*p) : : "memory");
+  return addend;
+}
+
+/* Initializes MUTEX as unlocked. */
+void
+mutex_init (struct mutex *mutex)
+{
+  mutex->state = 0;
+}
+
+/* Locks MUTEX, sleeping until it is unlocked if necessary. */
+void
+mutex_lock (struct mutex *mutex)
+{
+  int c = atomic_cmpxchg (&mutex->state, 0, 1);
+
+  if (c != 0)
+    {
+      /* Contended.  Mark the mutex as having waiters, and sleep
+         until we are the one that finds it unlocked. */
+      if (c != 2)
+        c = atomic_xchg (&mutex->state, 2);
+      while (c != 0)
+        {
+          futex_wait (&mutex->state, 2);
+          c = atomic_xchg (&mutex->state, 2);
+        }
+    }
+}
+
+/* Locks MUTEX if it is unlocked.  Returns true if successful,
+   false if MUTEX was already locked. */
+bool
+mutex_trylock (struct mutex *mutex)
+{
+  return atomic_cmpxchg (&mutex->state, 0, 1) == 0;
+}
+
+/* Unlocks MUTEX, which the caller must have locked, and wakes a
+   waiter if there may be one. */
+void
+mutex_unlock (struct mutex *mutex)
+{
+  if (atomic_fetch_add (&mutex->state, -1) != 1)
+    {
+      mutex->state = 0;
+      futex_wake (&mutex->state, 1);
+    }
+}
+
+/* Initializes condition variable COND. */
+void
+condvar_init (struct condvar *cond)
+{
+  cond->seq = 0;
+}
+
+/* Atomically unlocks MUTEX and waits for COND to be signaled,
+   then locks MUTEX again before returning.  As with kernel
+   condition variables, the caller must recheck its condition
+   after waking up. */
+void
+condvar_wait (struct condvar *cond, struct mutex *mutex)
+{
+  int seq = cond->seq;
+  int c;
+
+  mutex_unlock (mutex);
+  futex_wait (&cond->seq, seq);
+
+  /* Other threads may have been woken with us, so lock the mutex
+     as contended, which makes our unlock wake the next one. */
+  c = atomic_xchg (&mutex->state, 2);
+  while (c != 0)
+    {
+      futex_wait (&mutex->state, 2);
+      c = atomic_xchg (&mutex->state, 2);
+    }
+}
+
+/* Wakes one thread waiting on COND, if any. */
+void
+condvar_signal (struct condvar *cond)
+{
+  atomic_fetch_add (&cond->seq, 1);
+  futex_wake (&cond->seq, 1);
+}
+
+/* Wakes all threads waiting on COND. */
+void
+condvar_broadcast (struct condvar *cond)
+{
+  atomic_fetch_add (&cond->seq, 1);
+  futex_wake (&cond->seq, INT_MAX);
+}
@@ -0,0 +1,37 @@
+#ifndef __LIB_USER_SYNCH_H
+#define __LIB_USER_SYNCH_H
+
+#include <stdbool.h>
+
+/* A mutex built on a futex.  STATE is 0 if the mutex is
+   unlocked, 1 if it is locked with no waiters, and 2 if it is
+   locked and threads may be waiting.  Locking and unlocking an
+   uncontended mutex take no system call. */
+struct mutex
+  {
+    int state;
+  };
+
+#define MUTEX_INITIALIZER { 0 }
+
+void mutex_init (struct mutex *);
+void mutex_lock (struct mutex *);
+bool mutex_trylock (struct mutex *);
+void mutex_unlock (struct mutex *);
+
+/* A condition variable built on a futex.  SEQ changes on every
+   signal or broadcast, so that a waiter that went to sleep on an
+   old value wakes up at once. */
+struct condvar
+  {
+    int seq;
+  };
+
+#define CONDVAR_INITIALIZER { 0 }
+
+void condvar_init (struct condvar *);
+void condvar_wait (struct condvar *, struct mutex *);
+void condvar_signal (struct condvar *);
+void condvar_broadcast (struct condvar *);
+
+#endif /* lib/user/synch.h */
@@ -212,3 +212,66 @@ cache_writes (void)
 {
   return syscall0 (SYS_CACHE_WRITES);
 }
+
+int
+lockstat (struct lockstat *stats, int max)
+{
+  return syscall2 (SYS_LOCKSTAT, stats, max);
+}
+
+int
+futex_wait (int *addr, int expected)
+{
+  return syscall2 (SYS_FUTEX_WAIT, addr, expected);
+}
+
+int
+futex_wake (int *addr, int cnt)
+{
+  return syscall2 (SYS_FUTEX_WAKE, addr, cnt);
+}
+
+/* Runs FUNC(AUX) in a thread started by thread_spawn(), and
+   exits the thread with FUNC's return value. */
+static void
+thread_start (thread_func *func, void *aux)
+{
+  thread_exit (func (aux));
+}
+
+tid_t
+thread_spawn (thread_func *func, void *aux)
+{
+  return syscall3 (SYS_THREAD_SPAWN, thread_start, func, aux);
+}
+
+int
+thread_join (tid_t tid, void **result)
+{
+  return syscall2 (SYS_THREAD_JOIN, tid, result);
+}
+
+void
+thread_exit (void *result)
+{
+  syscall1 (SYS_THREAD_EXIT, result);
+  NOT_REACHED ();
+}
+
+pid_t
+fork (void)
+{
+  return (pid_t) syscall0 (SYS_FORK);
+}
+
+int
+get_tickets (void)
+{
+  return syscall0 (SYS_GET_TICKETS);
+}
+
+bool
+set_tickets (int tickets)
+{
+  return syscall1 (SYS_SET_TICKETS, tickets);
+}
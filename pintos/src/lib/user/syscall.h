@@ -3,11 +3,16 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <lockstat.h>
 
 /* Process identifier. */
 typedef int pid_t;
 #define PID_ERROR ((pid_t) -1)
 
+/* Thread identifier. */
+typedef int tid_t;
+#define TID_ERROR ((tid_t) -1)
+
 /* Map region identifier. */
 typedef int mapid_t;
 #define MAP_FAILED ((mapid_t) -1)
@@ -50,4 +55,27 @@ void free_cache (void);
 int cache_reads (void);
 int cache_writes (void);
 
+/* Kernel statistics. */
+int lockstat (struct lockstat *, int max);
+
+/* User-space synchronization.  See lib/user/synch.h for mutexes
+   and condition variables built on these. */
+int futex_wait (int *addr, int expected);
+int futex_wake (int *addr, int cnt);
+
+/* User threads.  See lib/user/pthread.h for a POSIX-like
+   interface to these. */
+typedef void *thread_func (void *aux);
+tid_t thread_spawn (thread_func *, void *aux);
+int thread_join (tid_t, void **retval);
+void thread_exit (void *retval) NO_RETURN;
+
+/* Copy-on-write processes. */
+pid_t fork (void);
+
+/* Stride scheduling.  A process's tickets set its share of the
+   CPU, which its threads that are not blocked split evenly. */
+int get_tickets (void);
+bool set_tickets (int tickets);
+
 #endif /* lib/user/syscall.h */
@@ -0,0 +1,47 @@
+/* Child process for the read-par tests.
+   Opens the test file by name and reads all of it, a chunk at a
+   time, READ_CNT times over, checking the contents each time. */
+
+#include <random.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/filesys/base/read-par.h"
+
+const char *test_name = "child-read-par";
+
+static char buf[BUF_SIZE];
+
+int
+main (int argc, const char *argv[])
+{
+  int child_idx;
+  int i;
+
+  quiet = true;
+
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+
+  random_init (0);
+  random_bytes (buf, sizeof buf);
+
+  for (i = 0; i < READ_CNT; i++)
+    {
+      char chunk[CHUNK_SIZE];
+      size_t ofs;
+      int fd;
+
+      CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+      for (ofs = 0; ofs < sizeof buf; ofs += sizeof chunk)
+        {
+          CHECK (read (fd, chunk, sizeof chunk) == sizeof chunk,
+                 "read \"%s\"", file_name);
+          compare_bytes (chunk, buf + ofs, sizeof chunk, ofs, file_name);
+        }
+      close (fd);
+    }
+
+  return child_idx;
+}
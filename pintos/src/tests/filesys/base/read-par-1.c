@@ -0,0 +1,5 @@
+/* Spawns a single child process that reads the same file over
+   and over, as a baseline for read-par-8. */
+
+#define CHILD_CNT 1
+#include "tests/filesys/base/read-par.inc"
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(read-par-1) begin
+(read-par-1) create "data"
+(read-par-1) open "data"
+(read-par-1) write "data"
+(read-par-1) close "data"
+(read-par-1) exec child 1 of 1: "child-read-par 0"
+(read-par-1) wait for child 1 of 1 returned 0 (expected 0)
+(read-par-1) end
+EOF
+pass;
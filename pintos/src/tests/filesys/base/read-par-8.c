@@ -0,0 +1,10 @@
+/* Spawns 8 child processes that all read the same file over and
+   over at once.  Readers of a file, its directory, and the
+   buffer cache blocks behind it hold their locks for reading, so
+   they should not serialize.  Comparing the "Timer: N ticks"
+   line that the kernel prints at shutdown with that of
+   read-par-1 shows how reading scales with the number of
+   readers. */
+
+#define CHILD_CNT 8
+#include "tests/filesys/base/read-par.inc"
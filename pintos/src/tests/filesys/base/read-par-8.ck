@@ -0,0 +1,29 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(read-par-8) begin
+(read-par-8) create "data"
+(read-par-8) open "data"
+(read-par-8) write "data"
+(read-par-8) close "data"
+(read-par-8) exec child 1 of 8: "child-read-par 0"
+(read-par-8) exec child 2 of 8: "child-read-par 1"
+(read-par-8) exec child 3 of 8: "child-read-par 2"
+(read-par-8) exec child 4 of 8: "child-read-par 3"
+(read-par-8) exec child 5 of 8: "child-read-par 4"
+(read-par-8) exec child 6 of 8: "child-read-par 5"
+(read-par-8) exec child 7 of 8: "child-read-par 6"
+(read-par-8) exec child 8 of 8: "child-read-par 7"
+(read-par-8) wait for child 1 of 8 returned 0 (expected 0)
+(read-par-8) wait for child 2 of 8 returned 1 (expected 1)
+(read-par-8) wait for child 3 of 8 returned 2 (expected 2)
+(read-par-8) wait for child 4 of 8 returned 3 (expected 3)
+(read-par-8) wait for child 5 of 8 returned 4 (expected 4)
+(read-par-8) wait for child 6 of 8 returned 5 (expected 5)
+(read-par-8) wait for child 7 of 8 returned 6 (expected 6)
+(read-par-8) wait for child 8 of 8 returned 7 (expected 7)
+(read-par-8) end
+EOF
+pass;
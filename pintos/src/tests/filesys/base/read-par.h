@@ -0,0 +1,9 @@
+#ifndef TESTS_FILESYS_BASE_READ_PAR_H
+#define TESTS_FILESYS_BASE_READ_PAR_H
+
+#define BUF_SIZE 8192           /* Size of the file, in bytes. */
+#define CHUNK_SIZE 512          /* Bytes per read() call. */
+#define READ_CNT 16             /* Times each child reads the file. */
+static const char file_name[] = "data";
+
+#endif /* tests/filesys/base/read-par.h */
@@ -0,0 +1,73 @@
+/* Measures the share of timer ticks spent in the idle thread
+   while an increasing number of threads sleep repeatedly.
+
+   Sleeping threads should not consume CPU time, so the idle
+   share must stay high no matter how many sleepers there are.
+   A timer_sleep() that yields in a loop instead keeps every
+   sleeper on the ready list and drives the idle share toward
+   zero as sleepers are added. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Number of times each sleeper goes to sleep. */
+#define ITERATIONS 10
+
+/* Ticks per sleep. */
+#define SLEEP_TICKS 20
+
+static thread_func sleeper;
+
+void
+test_alarm_idle (void)
+{
+  static const int sleeper_cnts[] = {1, 10, 50, 100, 200};
+  struct semaphore done;
+  size_t i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  msg ("Each sleeper sleeps %d ticks, %d times.", SLEEP_TICKS, ITERATIONS);
+  sema_init (&done, 0);
+  for (i = 0; i < sizeof sleeper_cnts / sizeof *sleeper_cnts; i++)
+    {
+      int cnt = sleeper_cnts[i];
+      int64_t start_ticks, elapsed;
+      long long start_idle, idle;
+      int j;
+
+      start_ticks = timer_ticks ();
+      start_idle = thread_idle_ticks ();
+      for (j = 0; j < cnt; j++)
+        {
+          char name[24];
+          snprintf (name, sizeof name, "sleeper %d", j);
+          if (thread_create (name, PRI_DEFAULT, sleeper, &done) == TID_ERROR)
+            fail ("thread_create failed for sleeper %d of %d", j, cnt);
+        }
+      for (j = 0; j < cnt; j++)
+        sema_down (&done);
+      elapsed = timer_elapsed (start_ticks);
+      idle = thread_idle_ticks () - start_idle;
+
+      msg ("%d sleepers: %lld of %lld ticks idle (%lld%%).",
+           cnt, idle, elapsed, elapsed > 0 ? idle * 100 / elapsed : 0);
+    }
+}
+
+/* Sleeps ITERATIONS times, then signals DONE_. */
+static void
+sleeper (void *done_)
+{
+  struct semaphore *done = done_;
+  int i;
+
+  for (i = 0; i < ITERATIONS; i++)
+    timer_sleep (SLEEP_TICKS);
+  sema_up (done);
+}
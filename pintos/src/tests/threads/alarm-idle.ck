@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+# Sleepers must leave the CPU idle, however many there are.
+my (@counts) = (1, 10, 50, 100, 200);
+local ($_);
+foreach (@output) {
+    my ($cnt, $pct) = /(\d+) sleepers: \d+ of \d+ ticks idle \((\d+)%\)\./
+      or next;
+    fail "Expected $counts[0] sleepers, got $cnt.\n"
+      if !@counts || $cnt != $counts[0];
+    shift (@counts);
+    fail "Only $pct% of ticks were idle with $cnt sleepers.\n"
+      if $pct < 50;
+}
+fail "Missing results for " . scalar (@counts) . " sleeper counts.\n"
+  if @counts;
+pass;
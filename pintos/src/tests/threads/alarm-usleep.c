@@ -0,0 +1,99 @@
+/* Creates N threads, each of which sleeps a different number of
+   microseconds, all shorter than a couple of timer ticks, with
+   timer_usleep().  Verifies that they wake up in order of their
+   sleep times and that each slept at least as long as it asked
+   to.  Only meaningful with the tickless timer, which lets
+   threads block for less than a tick. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 5
+
+/* Information about the test. */
+struct usleep_test
+  {
+    struct lock output_lock;    /* Lock protecting output buffer. */
+    int output[THREAD_CNT];     /* Wake-up order. */
+    int output_cnt;             /* Number of elements in output. */
+    struct semaphore done;      /* Upped by each thread when done. */
+  };
+
+/* Information about an individual thread in the test. */
+struct usleep_thread
+  {
+    struct usleep_test *test;   /* Info shared between all threads. */
+    int id;                     /* Thread ID. */
+    int64_t duration;           /* Microseconds to sleep. */
+  };
+
+static thread_func sleeper;
+
+void
+test_alarm_usleep (void)
+{
+  struct usleep_test test;
+  struct usleep_thread threads[THREAD_CNT];
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  if (!timer_is_tickless ())
+    {
+      msg ("Tickless timer not in use, skipping.");
+      return;
+    }
+
+  lock_init (&test.output_lock);
+  test.output_cnt = 0;
+  sema_init (&test.done, 0);
+
+  /* Thread I sleeps (THREAD_CNT - I) * 1,500 us, so that threads
+     created later wake up earlier. */
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      struct usleep_thread *t = &threads[i];
+      char name[16];
+
+      t->test = &test;
+      t->id = i;
+      t->duration = (THREAD_CNT - i) * 1500;
+      snprintf (name, sizeof name, "thread %d", i);
+      thread_create (name, PRI_DEFAULT, sleeper, t);
+    }
+
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&test.done);
+
+  for (i = 0; i < test.output_cnt; i++)
+    {
+      struct usleep_thread *t = &threads[test.output[i]];
+      msg ("thread %d: slept at least %lld us", t->id, t->duration);
+    }
+}
+
+/* Sleeper thread. */
+static void
+sleeper (void *t_)
+{
+  struct usleep_thread *t = t_;
+  struct usleep_test *test = t->test;
+  int64_t start = timer_ns ();
+  int64_t elapsed;
+
+  timer_usleep (t->duration);
+  elapsed = timer_ns () - start;
+  if (elapsed < t->duration * 1000)
+    fail ("thread %d slept %lld ns, less than %lld us",
+          t->id, elapsed, t->duration);
+
+  lock_acquire (&test->output_lock);
+  test->output[test->output_cnt++] = t->id;
+  lock_release (&test->output_lock);
+  sema_up (&test->done);
+}
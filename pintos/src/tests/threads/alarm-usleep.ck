@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF', <<'EOF']);
+(alarm-usleep) begin
+(alarm-usleep) thread 4: slept at least 1500 us
+(alarm-usleep) thread 3: slept at least 3000 us
+(alarm-usleep) thread 2: slept at least 4500 us
+(alarm-usleep) thread 1: slept at least 6000 us
+(alarm-usleep) thread 0: slept at least 7500 us
+(alarm-usleep) end
+EOF
+(alarm-usleep) begin
+(alarm-usleep) Tickless timer not in use, skipping.
+(alarm-usleep) end
+EOF
+pass;
@@ -0,0 +1,166 @@
+/* Checks the deadline scheduling class.
+
+   First, checks that thread_set_deadline() rejects invalid
+   parameters and threads that would raise the total utilization
+   of deadline threads too high.
+
+   Then runs two periodic deadline threads, each of which does
+   about a tick of work per job, alongside a PRI_MAX thread that
+   never blocks.  The deadline threads must meet all their
+   deadlines anyway.
+
+   Last, runs a deadline thread that never ends its job.  It must
+   be throttled, letting a thread of ordinary priority run. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define POLLER_CNT 2
+#define JOB_CNT 10
+
+/* A periodic deadline thread. */
+struct poller
+  {
+    int64_t runtime, deadline, period;  /* Parameters, in ticks. */
+    int misses;                         /* Jobs that missed. */
+  };
+
+static struct semaphore done;
+static volatile int pollers_left;
+static volatile bool runaway_done;
+static volatile int low_progress;
+
+static thread_func admit_helper, poller, hog, runaway, low;
+
+void
+test_edf_deadline (void)
+{
+  struct poller pollers[POLLER_CNT] = {{2, 5, 5, 0}, {2, 10, 10, 0}};
+  bool helper_admitted;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&done, 0);
+
+  /* Admission control. */
+  if (thread_set_deadline (0, 10, 10) || thread_set_deadline (5, 4, 10)
+      || thread_set_deadline (5, 10, 8))
+    fail ("invalid deadline parameters admitted");
+  if (!thread_set_deadline (6, 10, 10))
+    fail ("utilization 0.6 not admitted");
+  if (!thread_set_deadline (9, 10, 10))
+    fail ("raising own utilization to 0.9 not admitted");
+  thread_create ("helper", PRI_DEFAULT, admit_helper, &helper_admitted);
+  sema_down (&done);
+  if (helper_admitted)
+    fail ("total utilization 1.0 admitted");
+  thread_clear_deadline ();
+  msg ("admission control works");
+
+  /* Deadline threads alongside a CPU hog. */
+  pollers_left = POLLER_CNT;
+  for (i = 0; i < POLLER_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "poller %d", i);
+      thread_create (name, PRI_MAX, poller, &pollers[i]);
+    }
+  thread_create ("hog", PRI_MAX, hog, NULL);
+  for (i = 0; i < POLLER_CNT; i++)
+    sema_down (&done);
+  for (i = 0; i < POLLER_CNT; i++)
+    if (pollers[i].misses == 0)
+      msg ("poller %d met all %d deadlines", i, JOB_CNT);
+    else
+      fail ("poller %d missed %d of %d deadlines",
+            i, pollers[i].misses, JOB_CNT);
+
+  /* A runaway deadline thread. */
+  thread_create ("low", PRI_DEFAULT, low, NULL);
+  thread_create ("runaway", PRI_MAX, runaway, NULL);
+  sema_down (&done);
+  sema_down (&done);
+}
+
+/* Tries to join the deadline class with utilization 0.1 while
+   the main thread has 0.9. */
+static void
+admit_helper (void *admitted_)
+{
+  bool *admitted = admitted_;
+
+  *admitted = thread_set_deadline (1, 10, 10);
+  if (*admitted)
+    thread_clear_deadline ();
+  sema_up (&done);
+}
+
+/* Runs JOB_CNT jobs of about one tick of work each. */
+static void
+poller (void *poller_)
+{
+  struct poller *p = poller_;
+  int i;
+
+  if (!thread_set_deadline (p->runtime, p->deadline, p->period))
+    fail ("%s not admitted", thread_name ());
+  for (i = 0; i < JOB_CNT; i++)
+    {
+      int64_t start = timer_ticks ();
+      while (timer_ticks () == start)
+        continue;
+      if (!thread_deadline_yield ())
+        p->misses++;
+    }
+  thread_clear_deadline ();
+
+  pollers_left--;
+  sema_up (&done);
+}
+
+/* Spins at PRI_MAX until the pollers are done. */
+static void
+hog (void *aux UNUSED)
+{
+  while (pollers_left > 0)
+    continue;
+}
+
+/* Uses one tick of budget per 10-tick period, but spins for 30
+   ticks without ever ending its job. */
+static void
+runaway (void *aux UNUSED)
+{
+  int64_t start;
+  int seen;
+
+  if (!thread_set_deadline (1, 10, 10))
+    fail ("runaway not admitted");
+  start = timer_ticks ();
+  while (timer_elapsed (start) < 30)
+    continue;
+  seen = low_progress;
+  runaway_done = true;
+  thread_clear_deadline ();
+
+  if (seen > 0)
+    msg ("low-priority thread ran while runaway was throttled");
+  else
+    fail ("runaway starved the low-priority thread");
+  sema_up (&done);
+}
+
+/* Counts while the runaway thread runs. */
+static void
+low (void *aux UNUSED)
+{
+  while (!runaway_done)
+    low_progress++;
+  sema_up (&done);
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+compare_output ("run", \@output, [<<'EOF']);
+(edf-deadline) begin
+(edf-deadline) admission control works
+(edf-deadline) poller 0 met all 10 deadlines
+(edf-deadline) poller 1 met all 10 deadlines
+(edf-deadline) low-priority thread ran while runaway was throttled
+(edf-deadline) end
+EOF
+
+# The runaway thread must show up in the statistics as throttled.
+my ($stats) = grep (/^Deadline:/, @output);
+fail "Missing deadline statistics.\n" if !defined $stats;
+my ($throttled) = $stats =~ /(\d+) throttled/;
+fail "No deadline job was throttled.\n" if $throttled == 0;
+pass;
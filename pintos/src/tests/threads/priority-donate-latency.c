@@ -0,0 +1,72 @@
+/* Measures how long a high-priority thread waits for a lock
+   held by a low-priority thread while medium-priority threads
+   are ready to hog the CPU.
+
+   The main thread, at PRI_DEFAULT, acquires a lock and then
+   creates a thread at PRI_DEFAULT + 10 that blocks acquiring
+   it, followed by CPU-bound threads at PRI_DEFAULT + 5.  With
+   priority donation the main thread keeps running and releases
+   the lock at once, and the waiter must be scheduled on release
+   before any of the hogs.  Without donation, or without
+   preemption on release, the waiter sits behind the hogs for
+   several ticks.  The lock's wait-time histogram shows which. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define ROUNDS 10
+#define HOG_CNT 2
+#define HOG_TICKS 4
+
+static thread_func high_thread_func;
+static thread_func hog_thread_func;
+
+void
+test_priority_donate_latency (void)
+{
+  struct lock lock;
+  unsigned fast;
+  int round, i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  lock_init (&lock);
+  for (round = 0; round < ROUNDS; round++)
+    {
+      lock_acquire (&lock);
+      thread_create ("high", PRI_DEFAULT + 10, high_thread_func, &lock);
+      for (i = 0; i < HOG_CNT; i++)
+        thread_create ("hog", PRI_DEFAULT + 5, hog_thread_func, NULL);
+      lock_release (&lock);
+    }
+
+  lock_print_wait_hist (&lock, "test");
+  fast = lock.wait_hist[0] + lock.wait_hist[1];
+  msg ("%u of %d high-priority waits took under 2 ticks.", fast, ROUNDS);
+}
+
+static void
+high_thread_func (void *lock_)
+{
+  struct lock *lock = lock_;
+
+  lock_acquire (lock);
+  lock_release (lock);
+}
+
+static void
+hog_thread_func (void *aux UNUSED)
+{
+  int64_t start = timer_ticks ();
+
+  while (timer_elapsed (start) < HOG_TICKS)
+    continue;
+}
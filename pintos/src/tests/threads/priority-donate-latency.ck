@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+# Every high-priority wait must end as soon as the lock holder,
+# boosted by donation, releases the lock, never behind the hogs.
+my ($result) = grep (/high-priority waits took under 2 ticks\./, @output);
+fail "Missing result line.\n" if !defined $result;
+my ($fast, $rounds) = $result =~ /(\d+) of (\d+) high-priority waits/;
+fail "Only $fast of $rounds high-priority waits took under 2 ticks.\n"
+  if $fast != $rounds;
+pass;
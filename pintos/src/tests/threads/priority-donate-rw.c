@@ -0,0 +1,64 @@
+/* The main thread acquires a readers-writer lock for reading.
+   Then it creates a higher-priority writer that blocks acquiring
+   the lock for writing, and a still higher-priority reader that
+   blocks behind the waiting writer.  Both must donate their
+   priorities to the main thread, although it holds the lock only
+   for reading.  When the main thread releases the lock, the
+   reader gets it first, because its priority is higher, then
+   the writer. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func writer_thread_func;
+static thread_func reader_thread_func;
+
+void
+test_priority_donate_rw (void)
+{
+  struct rwlock rwlock;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rw_init (&rwlock, true);
+  rw_read_acquire (&rwlock);
+  thread_create ("writer", PRI_DEFAULT + 1, writer_thread_func, &rwlock);
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 1, thread_get_priority ());
+  thread_create ("reader", PRI_DEFAULT + 2, reader_thread_func, &rwlock);
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 2, thread_get_priority ());
+  rw_read_release (&rwlock);
+  msg ("reader, writer must already have finished, in that order.");
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+}
+
+static void
+writer_thread_func (void *rwlock_)
+{
+  struct rwlock *rwlock = rwlock_;
+
+  rw_write_acquire (rwlock);
+  msg ("writer: got the lock");
+  rw_write_release (rwlock);
+  msg ("writer: done");
+}
+
+static void
+reader_thread_func (void *rwlock_)
+{
+  struct rwlock *rwlock = rwlock_;
+
+  rw_read_acquire (rwlock);
+  msg ("reader: got the lock");
+  rw_read_release (rwlock);
+  msg ("reader: done");
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-donate-rw) begin
+(priority-donate-rw) This thread should have priority 32.  Actual priority: 32.
+(priority-donate-rw) This thread should have priority 33.  Actual priority: 33.
+(priority-donate-rw) reader: got the lock
+(priority-donate-rw) reader: done
+(priority-donate-rw) writer: got the lock
+(priority-donate-rw) writer: done
+(priority-donate-rw) reader, writer must already have finished, in that order.
+(priority-donate-rw) This thread should have priority 31.  Actual priority: 31.
+(priority-donate-rw) end
+EOF
+pass;
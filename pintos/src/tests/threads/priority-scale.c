@@ -0,0 +1,75 @@
+/* Times the scheduler's pick-next path as the number of ready
+   threads grows.
+
+   The main thread creates N threads at a lower priority, which
+   therefore stay on the run queue without ever running, and
+   then calls thread_yield() many times.  Each yield puts the
+   main thread back on the run queue and picks it again as the
+   highest-priority ready thread, so the time per yield reflects
+   the cost of choosing the next thread with N threads ready.  A
+   constant-time run queue takes about the same number of ticks
+   for every N. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Number of yields timed for each thread count. */
+#define YIELD_CNT 200000
+
+static thread_func waiter;
+
+void
+test_priority_scale (void)
+{
+  static const int ready_cnts[] = {0, 10, 100, 1000, 2000};
+  struct semaphore done;
+  size_t i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  msg ("Timing %d yields with N lower-priority threads ready.", YIELD_CNT);
+  sema_init (&done, 0);
+  for (i = 0; i < sizeof ready_cnts / sizeof *ready_cnts; i++)
+    {
+      int cnt = ready_cnts[i];
+      int64_t start;
+      int j;
+
+      for (j = 0; j < cnt; j++)
+        {
+          char name[24];
+          snprintf (name, sizeof name, "waiter %d", j);
+          if (thread_create (name, PRI_DEFAULT - 1, waiter, &done)
+              == TID_ERROR)
+            fail ("thread_create failed for waiter %d of %d", j, cnt);
+        }
+
+      /* Start timing at the beginning of a tick. */
+      timer_sleep (1);
+      start = timer_ticks ();
+      for (j = 0; j < YIELD_CNT; j++)
+        thread_yield ();
+      msg ("%d ready threads: %lld ticks.", cnt, timer_elapsed (start));
+
+      /* Let the waiters run to completion. */
+      for (j = 0; j < cnt; j++)
+        sema_down (&done);
+    }
+}
+
+/* Signals DONE_ once the main thread lets us run. */
+static void
+waiter (void *done_)
+{
+  struct semaphore *done = done_;
+
+  sema_up (done);
+}
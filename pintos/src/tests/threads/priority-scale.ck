@@ -0,0 +1,28 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+# Picking the next thread must not slow down as ready threads are
+# added, so every run should take about as long as the first.
+my (@counts) = (0, 10, 100, 1000, 2000);
+my ($base);
+local ($_);
+foreach (@output) {
+    my ($cnt, $ticks) = /(\d+) ready threads: (\d+) ticks\./ or next;
+    fail "Expected $counts[0] ready threads, got $cnt.\n"
+      if !@counts || $cnt != $counts[0];
+    shift (@counts);
+    $base = $ticks if !defined $base;
+    fail "Yielding took $ticks ticks with $cnt ready threads "
+      . "but $base ticks with none.\n"
+      if $ticks > 2 * $base + 10;
+}
+fail "Missing results for " . scalar (@counts) . " thread counts.\n"
+  if @counts;
+pass;
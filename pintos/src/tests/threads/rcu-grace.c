@@ -0,0 +1,70 @@
+/* Checks that an RCU read-side critical section keeps the
+   running thread from being preempted, even by a thread of
+   higher priority and across timer ticks, and holds off RCU
+   callbacks until it ends, and that synchronize_rcu() waits for
+   earlier callbacks. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/rcu.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+static thread_func high_thread;
+static rcu_func callback;
+
+static struct semaphore high_sema;
+static volatile bool high_ran;
+static volatile bool callback_ran;
+
+void
+test_rcu_grace (void)
+{
+  struct rcu_head head;
+  int64_t start;
+
+  /* This test needs the priority scheduler. */
+  ASSERT (!thread_mlfqs);
+  ASSERT (!thread_stride);
+
+  sema_init (&high_sema, 0);
+  thread_create ("high", PRI_DEFAULT + 1, high_thread, NULL);
+
+  rcu_read_lock ();
+  call_rcu (&head, callback);
+  sema_up (&high_sema);
+  msg ("Woke higher-priority thread in read-side critical section.");
+
+  /* Spin long enough for the timer to end our time slice and to
+     report quiescent states, were we not in a critical
+     section. */
+  start = timer_ticks ();
+  while (timer_elapsed (start) < 10)
+    continue;
+  if (!high_ran)
+    msg ("Higher-priority thread did not preempt us.");
+  if (!callback_ran)
+    msg ("Callback did not run during critical section.");
+  rcu_read_unlock ();
+  msg ("Left read-side critical section.");
+
+  synchronize_rcu ();
+  if (callback_ran)
+    msg ("Callback ran before synchronize_rcu() returned.");
+}
+
+static void
+high_thread (void *aux UNUSED)
+{
+  sema_down (&high_sema);
+  high_ran = true;
+  msg ("Higher-priority thread running.");
+}
+
+static void
+callback (struct rcu_head *head UNUSED)
+{
+  callback_ran = true;
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rcu-grace) begin
+(rcu-grace) Woke higher-priority thread in read-side critical section.
+(rcu-grace) Higher-priority thread did not preempt us.
+(rcu-grace) Callback did not run during critical section.
+(rcu-grace) Higher-priority thread running.
+(rcu-grace) Left read-side critical section.
+(rcu-grace) Callback ran before synchronize_rcu() returned.
+(rcu-grace) end
+EOF
+pass;
@@ -0,0 +1,7 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::threads::stride;
+
+check_stride_fair ([(100) x 20], 10);
@@ -0,0 +1,133 @@
+/* Checks sema_down_timeout(), lock_acquire_timeout(), and
+   cond_timedwait(), each once when the wait runs out of time and
+   once when it is satisfied in time.  A thread that gives up on
+   a lock must also withdraw the priority that it donated to the
+   lock's holder, and must not be handed the lock afterward. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Shared between the main thread and the helpers. */
+struct timeout_info
+  {
+    struct semaphore sema;
+    struct lock lock;
+    struct condition cond;
+  };
+
+static thread_func sema_upper, lock_waiter, cond_signaler;
+static void check_wait (int64_t start, int64_t ticks, bool success);
+
+void
+test_synch_timeout (void)
+{
+  struct timeout_info info;
+  int64_t start;
+  bool success;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  sema_init (&info.sema, 0);
+  lock_init (&info.lock);
+  cond_init (&info.cond);
+
+  /* Semaphores. */
+  success = sema_down_timeout (&info.sema, 0);
+  msg ("sema_down_timeout() with no time: %s.",
+       success ? "acquired" : "timed out");
+  start = timer_ticks ();
+  success = sema_down_timeout (&info.sema, 10);
+  check_wait (start, 10, success);
+  msg ("sema_down_timeout() with no sema_up(): %s.",
+       success ? "acquired" : "timed out");
+  thread_create ("sema-upper", PRI_DEFAULT + 1, sema_upper, &info);
+  start = timer_ticks ();
+  success = sema_down_timeout (&info.sema, 1000);
+  check_wait (start, 1000, success);
+  msg ("sema_down_timeout() with sema_up(): %s.",
+       success ? "acquired" : "timed out");
+
+  /* Locks. */
+  lock_acquire (&info.lock);
+  thread_create ("lock-waiter", PRI_DEFAULT + 1, lock_waiter, &info);
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 1, thread_get_priority ());
+  timer_sleep (20);
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+  lock_release (&info.lock);
+  msg ("Released the lock with no waiters.");
+
+  /* Condition variables. */
+  lock_acquire (&info.lock);
+  start = timer_ticks ();
+  success = cond_timedwait (&info.cond, &info.lock, 10);
+  check_wait (start, 10, success);
+  msg ("cond_timedwait() with no cond_signal(): %s.",
+       success ? "signaled" : "timed out");
+  thread_create ("cond-signaler", PRI_DEFAULT + 1, cond_signaler, &info);
+  start = timer_ticks ();
+  success = cond_timedwait (&info.cond, &info.lock, 1000);
+  check_wait (start, 1000, success);
+  msg ("cond_timedwait() with cond_signal(): %s.",
+       success ? "signaled" : "timed out");
+  lock_release (&info.lock);
+}
+
+/* Fails if a wait of TICKS ticks that started at START and
+   returned SUCCESS took the wrong amount of time. */
+static void
+check_wait (int64_t start, int64_t ticks, bool success)
+{
+  int64_t elapsed = timer_elapsed (start);
+
+  if (!success && elapsed < ticks)
+    fail ("Timed out after only %"PRId64" of %"PRId64" ticks.",
+          elapsed, ticks);
+  if (success && elapsed >= ticks)
+    fail ("Succeeded after %"PRId64" ticks, but the timeout was "
+          "%"PRId64" ticks.", elapsed, ticks);
+}
+
+static void
+sema_upper (void *info_)
+{
+  struct timeout_info *info = info_;
+
+  timer_sleep (5);
+  sema_up (&info->sema);
+}
+
+static void
+lock_waiter (void *info_)
+{
+  struct timeout_info *info = info_;
+
+  if (lock_acquire_timeout (&info->lock, 10))
+    {
+      msg ("lock-waiter: acquired the lock");
+      lock_release (&info->lock);
+    }
+  else
+    msg ("lock-waiter: timed out");
+}
+
+static void
+cond_signaler (void *info_)
+{
+  struct timeout_info *info = info_;
+
+  timer_sleep (5);
+  lock_acquire (&info->lock);
+  cond_signal (&info->cond, &info->lock);
+  lock_release (&info->lock);
+}
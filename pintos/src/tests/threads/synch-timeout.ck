@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(synch-timeout) begin
+(synch-timeout) sema_down_timeout() with no time: timed out.
+(synch-timeout) sema_down_timeout() with no sema_up(): timed out.
+(synch-timeout) sema_down_timeout() with sema_up(): acquired.
+(synch-timeout) This thread should have priority 32.  Actual priority: 32.
+(synch-timeout) lock-waiter: timed out
+(synch-timeout) This thread should have priority 31.  Actual priority: 31.
+(synch-timeout) Released the lock with no waiters.
+(synch-timeout) cond_timedwait() with no cond_signal(): timed out.
+(synch-timeout) cond_timedwait() with cond_signal(): signaled.
+(synch-timeout) end
+EOF
+pass;
@@ -17,6 +17,8 @@ static const struct test tests[] =
     {"alarm-priority", test_alarm_priority},
     {"alarm-zero", test_alarm_zero},
     {"alarm-negative", test_alarm_negative},
+    {"alarm-idle", test_alarm_idle},
+    {"alarm-usleep", test_alarm_usleep},
     {"priority-change", test_priority_change},
     {"priority-donate-one", test_priority_donate_one},
     {"priority-donate-multiple", test_priority_donate_multiple},
@@ -29,6 +31,14 @@ static const struct test tests[] =
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
     {"priority-condvar", test_priority_condvar},
+    {"priority-scale", test_priority_scale},
+    {"priority-donate-latency", test_priority_donate_latency},
+    {"priority-donate-rw", test_priority_donate_rw},
+    {"workqueue-order", test_workqueue_order},
+    {"thread-spawn-rate", test_thread_spawn_rate},
+    {"edf-deadline", test_edf_deadline},
+    {"rcu-grace", test_rcu_grace},
+    {"synch-timeout", test_synch_timeout},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
@@ -38,6 +48,9 @@ static const struct test tests[] =
     {"mlfqs-nice-2", test_mlfqs_nice_2},
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
+    {"stride-fair-2", test_stride_fair_2},
+    {"stride-fair-20", test_stride_fair_20},
+    {"stride-ratio", test_stride_ratio},
   };
 
 static const char *test_name;
@@ -11,6 +11,8 @@ extern test_func test_alarm_simultaneous;
 extern test_func test_alarm_priority;
 extern test_func test_alarm_zero;
 extern test_func test_alarm_negative;
+extern test_func test_alarm_idle;
+extern test_func test_alarm_usleep;
 extern test_func test_priority_change;
 extern test_func test_priority_donate_one;
 extern test_func test_priority_donate_multiple;
@@ -23,6 +25,14 @@ extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
 extern test_func test_priority_condvar;
+extern test_func test_priority_scale;
+extern test_func test_priority_donate_latency;
+extern test_func test_priority_donate_rw;
+extern test_func test_workqueue_order;
+extern test_func test_thread_spawn_rate;
+extern test_func test_edf_deadline;
+extern test_func test_rcu_grace;
+extern test_func test_synch_timeout;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
 extern test_func test_mlfqs_load_avg;
@@ -32,6 +42,9 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_stride_fair_2;
+extern test_func test_stride_fair_20;
+extern test_func test_stride_ratio;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
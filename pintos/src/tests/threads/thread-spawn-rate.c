@@ -0,0 +1,52 @@
+/* Measures how fast threads can be created and joined.
+
+   The main thread creates BATCH_SIZE short-lived threads at a
+   lower priority, then waits for all of them to exit, BATCH_CNT
+   times over.  Threads that exit return their pages to the
+   thread cache, so after the first batch, creating a thread
+   should not need to allocate a page.  The thread cache's hit
+   and miss counts appear in the statistics printed at
+   shutdown. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define BATCH_SIZE 10
+#define BATCH_CNT 50
+
+static thread_func exiting_thread;
+
+void
+test_thread_spawn_rate (void)
+{
+  struct semaphore done;
+  int64_t start, elapsed;
+  int batch, i;
+
+  sema_init (&done, 0);
+  start = timer_ticks ();
+  for (batch = 0; batch < BATCH_CNT; batch++)
+    {
+      for (i = 0; i < BATCH_SIZE; i++)
+        if (thread_create ("spawned", PRI_DEFAULT - 1,
+                           exiting_thread, &done) == TID_ERROR)
+          fail ("thread_create failed in batch %d", batch);
+      for (i = 0; i < BATCH_SIZE; i++)
+        sema_down (&done);
+    }
+  elapsed = timer_elapsed (start);
+
+  msg ("Spawned and joined %d threads.", BATCH_SIZE * BATCH_CNT);
+  printf ("Took %lld ticks, %lld threads per second.\n", elapsed,
+          elapsed > 0 ? BATCH_SIZE * BATCH_CNT * TIMER_FREQ / elapsed : 0);
+}
+
+static void
+exiting_thread (void *done)
+{
+  sema_up (done);
+}
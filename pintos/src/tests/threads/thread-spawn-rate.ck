@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+my (@core) = get_core_output ("run", @output);
+fail "Missing result line.\n"
+  if !grep (/Spawned and joined 500 threads\./, @core);
+
+# All but the first batch of threads should reuse cached pages.
+my ($stats) = grep (/^Thread cache:/, @output);
+fail "Missing thread cache statistics.\n" if !defined $stats;
+my ($hits) = $stats =~ /(\d+) page hits/;
+fail "Only $hits of 500 thread pages came from the cache.\n"
+  if $hits < 450;
+pass;
@@ -0,0 +1,59 @@
+/* Submits work at several priorities to a work queue with a
+   single worker, while running at a higher priority than any of
+   it, then flushes the queue.  The work should run in order of
+   priority, and in submission order within a priority, after
+   the delayed work comes due, and without the cancelled work. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
+#include "devices/timer.h"
+
+static work_func report;
+
+void
+test_workqueue_order (void)
+{
+  static const int priorities[] = {1, 3, 2, 3, 1};
+  struct work works[5], delayed, cancelled;
+  struct workqueue *wq;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  thread_set_priority (PRI_DEFAULT + 10);
+  wq = workqueue_create ("test", 1);
+  ASSERT (wq != NULL);
+
+  work_init (&delayed, report, "delayed", PRI_DEFAULT + 9);
+  workqueue_submit_delayed (wq, &delayed, 10);
+  msg ("Submitted delayed work.");
+
+  for (i = 0; i < 5; i++)
+    {
+      static const char *names[] = {"work 0", "work 1", "work 2",
+                                    "work 3", "work 4"};
+      work_init (&works[i], report, (void *) names[i],
+                 PRI_DEFAULT + priorities[i]);
+      workqueue_submit (wq, &works[i]);
+      msg ("Submitted %s at priority %d.", names[i],
+           PRI_DEFAULT + priorities[i]);
+    }
+
+  work_init (&cancelled, report, "cancelled", PRI_DEFAULT + 5);
+  workqueue_submit (wq, &cancelled);
+  if (workqueue_cancel (&cancelled))
+    msg ("Cancelled work.");
+
+  workqueue_flush (wq);
+  msg ("Flushed the work queue.");
+}
+
+static void
+report (void *name)
+{
+  msg ("Running %s.", (const char *) name);
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(workqueue-order) begin
+(workqueue-order) Submitted delayed work.
+(workqueue-order) Submitted work 0 at priority 32.
+(workqueue-order) Submitted work 1 at priority 34.
+(workqueue-order) Submitted work 2 at priority 33.
+(workqueue-order) Submitted work 3 at priority 34.
+(workqueue-order) Submitted work 4 at priority 32.
+(workqueue-order) Cancelled work.
+(workqueue-order) Running work 1.
+(workqueue-order) Running work 3.
+(workqueue-order) Running work 2.
+(workqueue-order) Running work 0.
+(workqueue-order) Running work 4.
+(workqueue-order) Running delayed.
+(workqueue-order) Flushed the work queue.
+(workqueue-order) end
+EOF
+pass;
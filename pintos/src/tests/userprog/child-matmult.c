@@ -0,0 +1,63 @@
+/* Child process run by the matmult-par tests.
+   Multiplies two matrices a number of times, to keep a CPU busy
+   for a while, and checks the result.  Exits with status 0 if
+   the product is correct. */
+
+#include <stdio.h>
+#include "tests/lib.h"
+
+const char *test_name = "child-matmult";
+
+#define N 64            /* Matrix dimension. */
+#define ROUNDS 40       /* Number of times to compute the product. */
+
+static int a[N][N], b[N][N], c[N][N];
+
+int
+main (void)
+{
+  int a_cols[N], b_rows[N];
+  long long expected, actual;
+  int round, i, j, k;
+
+  for (i = 0; i < N; i++)
+    for (j = 0; j < N; j++)
+      {
+        a[i][j] = i + 2 * j;
+        b[i][j] = i - j;
+      }
+
+  for (round = 0; round < ROUNDS; round++)
+    for (i = 0; i < N; i++)
+      for (j = 0; j < N; j++)
+        {
+          int sum = 0;
+          for (k = 0; k < N; k++)
+            sum += a[i][k] * b[k][j];
+          c[i][j] = sum;
+        }
+
+  /* The sum of all the elements of A*B is the dot product of
+     A's column sums with B's row sums. */
+  expected = actual = 0;
+  for (k = 0; k < N; k++)
+    {
+      a_cols[k] = b_rows[k] = 0;
+      for (i = 0; i < N; i++)
+        {
+          a_cols[k] += a[i][k];
+          b_rows[k] += b[k][i];
+        }
+      expected += (long long) a_cols[k] * b_rows[k];
+    }
+  for (i = 0; i < N; i++)
+    for (j = 0; j < N; j++)
+      actual += c[i][j];
+
+  if (actual != expected)
+    {
+      msg ("product checksum %lld, expected %lld", actual, expected);
+      return 1;
+    }
+  return 0;
+}
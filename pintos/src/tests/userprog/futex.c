@@ -0,0 +1,35 @@
+/* Checks the futex system calls' behavior when no thread needs to
+   sleep, and that an uncontended user mutex never leaves the
+   unlocked state marked as contended. */
+
+#include <synch.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  static int word = 5;
+  struct mutex mutex;
+  struct condvar cond;
+
+  CHECK (futex_wait (&word, 4) == -1, "futex_wait on a changed value");
+  CHECK (futex_wake (&word, 1) == 0, "futex_wake with no waiters");
+  CHECK (futex_wake ((int *) ((char *) &word + 1), 1) == -1,
+         "futex_wake on a misaligned address");
+
+  mutex_init (&mutex);
+  CHECK (mutex_trylock (&mutex), "trylock an unlocked mutex");
+  CHECK (!mutex_trylock (&mutex), "trylock a locked mutex");
+  mutex_unlock (&mutex);
+  mutex_lock (&mutex);
+  CHECK (mutex.state == 1, "locked mutex has no waiters");
+  mutex_unlock (&mutex);
+  CHECK (mutex.state == 0, "unlocked mutex");
+
+  condvar_init (&cond);
+  condvar_signal (&cond);
+  condvar_broadcast (&cond);
+  CHECK (cond.seq == 2, "signal and broadcast with no waiters");
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(futex) begin
+(futex) futex_wait on a changed value
+(futex) futex_wake with no waiters
+(futex) futex_wake on a misaligned address
+(futex) trylock an unlocked mutex
+(futex) trylock a locked mutex
+(futex) locked mutex has no waiters
+(futex) unlocked mutex
+(futex) signal and broadcast with no waiters
+(futex) end
+futex: exit(0)
+EOF
+pass;
@@ -0,0 +1,44 @@
+/* Runs a child process to exercise some kernel locks, then reads
+   the kernel's lock contention statistics with lockstat() and
+   checks that they are consistent.  Needs the -lockstat kernel
+   option. */
+
+#include <lockstat.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define MAX_CLASSES 64
+
+static struct lockstat stats[MAX_CLASSES];
+
+void
+test_main (void)
+{
+  uint64_t acquire_cnt = 0;
+  int cnt, i;
+
+  CHECK (wait (exec ("child-simple")) == 81, "run child-simple");
+  CHECK (lockstat (stats, 0) == 0, "lockstat with no room");
+
+  cnt = lockstat (stats, MAX_CLASSES);
+  CHECK (cnt > 0, "lockstat");
+  for (i = 0; i < cnt; i++)
+    {
+      const struct lockstat *s = &stats[i];
+
+      if (s->name[0] == '\0')
+        fail ("class %d has no name", i);
+      if (strlen (s->name) > LOCKSTAT_NAME_LEN)
+        fail ("class %d's name is not terminated", i);
+      if (s->contend_cnt > s->acquire_cnt)
+        fail ("%s: more contended than total acquisitions", s->name);
+      if (s->wait_max > s->wait_total || s->hold_max > s->hold_total)
+        fail ("%s: maximum exceeds total", s->name);
+      acquire_cnt += s->acquire_cnt;
+    }
+  if (acquire_cnt == 0)
+    fail ("no acquisitions recorded");
+  msg ("statistics are consistent");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(lockstat) begin
+(lockstat) run child-simple
+(child-simple) run
+child-simple: exit(81)
+(lockstat) lockstat with no room
+(lockstat) lockstat
+(lockstat) statistics are consistent
+(lockstat) end
+lockstat: exit(0)
+EOF
+pass;
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(matmult-par-4) begin
+(matmult-par-4) exec child 0
+(matmult-par-4) exec child 1
+(matmult-par-4) exec child 2
+(matmult-par-4) exec child 3
+(matmult-par-4) wait for child 0
+(matmult-par-4) wait for child 1
+(matmult-par-4) wait for child 2
+(matmult-par-4) wait for child 3
+(matmult-par-4) end
+EOF
+pass;
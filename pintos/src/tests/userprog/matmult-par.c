@@ -0,0 +1,24 @@
+/* Runs several CPU-bound child processes at once and waits for
+   them all.  Run as matmult-par-1 on one CPU and as matmult-par-4
+   on four CPUs; comparing the "Timer: N ticks" lines that the
+   kernel prints at shutdown shows the speedup from running the
+   children in parallel. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 4
+
+void
+test_main (void)
+{
+  pid_t children[CHILD_CNT];
+  int i;
+
+  for (i = 0; i < CHILD_CNT; i++)
+    CHECK ((children[i] = exec ("child-matmult")) != -1,
+           "exec child %d", i);
+  for (i = 0; i < CHILD_CNT; i++)
+    CHECK (wait (children[i]) == 0, "wait for child %d", i);
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(matmult-thr-4) begin
+(matmult-thr-4) create thread 0
+(matmult-thr-4) create thread 1
+(matmult-thr-4) create thread 2
+(matmult-thr-4) create thread 3
+(matmult-thr-4) join thread 0
+(matmult-thr-4) join thread 1
+(matmult-thr-4) join thread 2
+(matmult-thr-4) join thread 3
+(matmult-thr-4) product is correct
+(matmult-thr-4) end
+EOF
+pass;
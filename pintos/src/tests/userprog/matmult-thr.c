@@ -0,0 +1,81 @@
+/* Multiplies two matrices with several threads of one process,
+   each computing a band of rows of the product, and checks the
+   result.  Run as matmult-thr-1 on one CPU and as matmult-thr-4
+   on four CPUs; comparing the "Timer: N ticks" lines that the
+   kernel prints at shutdown shows the speedup from running the
+   threads in parallel.  This is the multithreaded counterpart of
+   matmult-par, which uses one process per worker. */
+
+#include <pthread.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 4
+#define N 64            /* Matrix dimension. */
+#define ROUNDS 40       /* Number of times to compute the product. */
+
+static int a[N][N], b[N][N], c[N][N];
+
+/* Computes rows [FIRST, FIRST + N / THREAD_CNT) of C = A * B,
+   ROUNDS times. */
+static void *
+multiply_band (void *first_)
+{
+  int first = (int) first_;
+  int round, i, j, k;
+
+  for (round = 0; round < ROUNDS; round++)
+    for (i = first; i < first + N / THREAD_CNT; i++)
+      for (j = 0; j < N; j++)
+        {
+          int sum = 0;
+          for (k = 0; k < N; k++)
+            sum += a[i][k] * b[k][j];
+          c[i][j] = sum;
+        }
+  return NULL;
+}
+
+void
+test_main (void)
+{
+  pthread_t threads[THREAD_CNT];
+  int a_cols[N], b_rows[N];
+  long long expected, actual;
+  int i, j, k;
+
+  for (i = 0; i < N; i++)
+    for (j = 0; j < N; j++)
+      {
+        a[i][j] = i + 2 * j;
+        b[i][j] = i - j;
+      }
+
+  for (i = 0; i < THREAD_CNT; i++)
+    CHECK (pthread_create (&threads[i], multiply_band,
+                           (void *) (i * (N / THREAD_CNT))) == 0,
+           "create thread %d", i);
+  for (i = 0; i < THREAD_CNT; i++)
+    CHECK (pthread_join (threads[i], NULL) == 0, "join thread %d", i);
+
+  /* The sum of all the elements of A*B is the dot product of
+     A's column sums with B's row sums. */
+  expected = actual = 0;
+  for (k = 0; k < N; k++)
+    {
+      a_cols[k] = b_rows[k] = 0;
+      for (i = 0; i < N; i++)
+        {
+          a_cols[k] += a[i][k];
+          b_rows[k] += b[k][i];
+        }
+      expected += (long long) a_cols[k] * b_rows[k];
+    }
+  for (i = 0; i < N; i++)
+    for (j = 0; j < N; j++)
+      actual += c[i][j];
+  if (actual != expected)
+    fail ("product checksum %lld, expected %lld", actual, expected);
+  msg ("product is correct");
+}
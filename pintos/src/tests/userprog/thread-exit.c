@@ -0,0 +1,39 @@
+/* Calls exit() from one thread while another sleeps on a mutex
+   and the initial thread waits to join it.  exit() must end
+   the whole process, with the status passed to it, even though
+   no thread would otherwise ever wake up. */
+
+#include <pthread.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void *
+sleeper (void *aux UNUSED)
+{
+  pthread_mutex_lock (&mutex);
+  fail ("sleeper acquired the mutex");
+}
+
+static void *
+exiter (void *aux UNUSED)
+{
+  msg ("exiting");
+  exit (57);
+}
+
+void
+test_main (void)
+{
+  pthread_t sleeper_thread, exiter_thread;
+
+  pthread_mutex_lock (&mutex);
+  CHECK (pthread_create (&sleeper_thread, sleeper, NULL) == 0,
+         "create sleeper");
+  CHECK (pthread_create (&exiter_thread, exiter, NULL) == 0,
+         "create exiter");
+  pthread_join (sleeper_thread, NULL);
+  fail ("joined sleeper");
+}
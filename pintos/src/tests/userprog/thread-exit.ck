@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-exit) begin
+(thread-exit) create sleeper
+(thread-exit) create exiter
+(thread-exit) exiting
+thread-exit: exit(57)
+EOF
+pass;
@@ -0,0 +1,51 @@
+/* Spawns threads and joins them, checking the values they
+   return, that a thread can only be joined once, and that a
+   file opened by one thread can be used by another. */
+
+#include <pthread.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 4
+
+static void *
+square (void *n_)
+{
+  int n = (int) n_;
+  return (void *) (n * n);
+}
+
+static void *
+open_sample (void *aux UNUSED)
+{
+  pthread_exit ((void *) open ("sample.txt"));
+}
+
+void
+test_main (void)
+{
+  pthread_t threads[THREAD_CNT], opener;
+  void *retval;
+  int fd, i;
+
+  for (i = 0; i < THREAD_CNT; i++)
+    CHECK (pthread_create (&threads[i], square, (void *) i) == 0,
+           "create thread %d", i);
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      CHECK (pthread_join (threads[i], &retval) == 0, "join thread %d", i);
+      if ((int) retval != i * i)
+        fail ("thread %d returned %d, expected %d", i, (int) retval, i * i);
+    }
+  CHECK (pthread_join (threads[0], NULL) == -1, "join thread 0 again");
+  CHECK (pthread_join (TID_ERROR, NULL) == -1, "join an invalid thread");
+
+  CHECK (pthread_create (&opener, open_sample, NULL) == 0, "create opener");
+  CHECK (pthread_join (opener, &retval) == 0, "join opener");
+  fd = (int) retval;
+  CHECK (fd > 1, "opener opened \"sample.txt\"");
+  CHECK (filesize (fd) == sizeof sample - 1, "filesize of opener's fd");
+  close (fd);
+}
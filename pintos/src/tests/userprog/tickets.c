@@ -0,0 +1,34 @@
+/* Sets the process's stride scheduling tickets and checks that
+   they belong to the whole process: a thread spawned afterward
+   sees the new count, and a count set by that thread is seen by
+   the initial thread.  Also checks that out-of-range counts are
+   rejected. */
+
+#include <pthread.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static void *
+reset_tickets (void *aux UNUSED)
+{
+  if (get_tickets () != 300)
+    fail ("spawned thread sees %d tickets, expected 300", get_tickets ());
+  set_tickets (200);
+  return NULL;
+}
+
+void
+test_main (void)
+{
+  pthread_t thread;
+
+  CHECK (set_tickets (300), "set_tickets (300)");
+  CHECK (get_tickets () == 300, "get_tickets () == 300");
+  CHECK (pthread_create (&thread, reset_tickets, NULL) == 0, "create thread");
+  CHECK (pthread_join (thread, NULL) == 0, "join thread");
+  CHECK (get_tickets () == 200, "get_tickets () == 200");
+  CHECK (!set_tickets (0), "set_tickets (0) fails");
+  CHECK (!set_tickets (1000000), "set_tickets (1000000) fails");
+  CHECK (get_tickets () == 200, "get_tickets () still 200");
+}
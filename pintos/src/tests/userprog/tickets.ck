@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(tickets) begin
+(tickets) set_tickets (300)
+(tickets) get_tickets () == 300
+(tickets) create thread
+(tickets) join thread
+(tickets) get_tickets () == 200
+(tickets) set_tickets (0) fails
+(tickets) set_tickets (1000000) fails
+(tickets) get_tickets () still 200
+(tickets) end
+tickets: exit(0)
+EOF
+pass;
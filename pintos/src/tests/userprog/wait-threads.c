@@ -0,0 +1,39 @@
+/* Waits for one child process from two threads at once.
+   Exactly one of the two wait calls must return the child's exit
+   code, and the other must return -1 instead of waiting
+   forever. */
+
+#include <pthread.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static pid_t child;
+static int waiter_status;
+
+static void *
+waiter (void *aux UNUSED)
+{
+  waiter_status = wait (child);
+  return NULL;
+}
+
+void
+test_main (void)
+{
+  pthread_t waiter_thread;
+  int status;
+
+  child = exec ("child-simple");
+  if (pthread_create (&waiter_thread, waiter, NULL) != 0)
+    fail ("create waiter");
+  status = wait (child);
+  pthread_join (waiter_thread, NULL);
+  if (status == -1)
+    {
+      status = waiter_status;
+      waiter_status = -1;
+    }
+  msg ("first wait = %d", status);
+  msg ("second wait = %d", waiter_status);
+}
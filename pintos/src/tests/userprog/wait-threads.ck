@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(wait-threads) begin
+(child-simple) run
+child-simple: exit(81)
+(wait-threads) first wait = 81
+(wait-threads) second wait = -1
+(wait-threads) end
+wait-threads: exit(0)
+EOF
+pass;
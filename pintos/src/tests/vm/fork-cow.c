@@ -0,0 +1,46 @@
+/* Forks a child that reads data its parent wrote to memory that
+   the two share copy-on-write, then overwrites it, both itself
+   and through read(), which writes to the page from the kernel.
+   Checks that the parent's copy is unchanged. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (64 * 1024)
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  int handle;
+  pid_t pid;
+  size_t i;
+
+  for (i = 0; i < sizeof buf; i++)
+    buf[i] = i * 257;
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+
+  pid = fork ();
+  if (pid == 0)
+    {
+      for (i = 0; i < sizeof buf; i++)
+        if (buf[i] != (char) (i * 257))
+          fail ("child read byte %zu as %02hhx", i, buf[i]);
+      memset (buf, 'c', sizeof buf);
+      if (read (handle, buf + sizeof buf / 2, strlen (sample))
+          != (int) strlen (sample)
+          || memcmp (buf + sizeof buf / 2, sample, strlen (sample)))
+        fail ("child's read of \"sample.txt\" reported bad data");
+      exit (81);
+    }
+  CHECK (pid > 0, "fork");
+  CHECK (wait (pid) == 81, "wait for child");
+
+  for (i = 0; i < sizeof buf; i++)
+    if (buf[i] != (char) (i * 257))
+      fail ("byte %zu changed to %02hhx in parent", i, buf[i]);
+}
@@ -0,0 +1,28 @@
+#ifndef THREADS_AP_START_H
+#define THREADS_AP_START_H
+
+/* Physical address to which smp_init() copies the application
+   processor start-up code.  A start-up IPI can only start a CPU
+   at a page-aligned address below 1 MB.  This page is otherwise
+   unused: the loader occupies 0x7c00...0x7dff and the initial
+   thread's page is at 0xe000. */
+#define AP_START_PHYS 0x8000
+
+#ifndef __ASSEMBLER__
+#include <stdint.h>
+
+/* Application processor start-up code, from ap_start up to
+   ap_start_end, which must be copied to AP_START_PHYS before
+   use.  See ap-start.S. */
+extern char ap_start[], ap_start_end[];
+
+/* Parameters for the next application processor to start.
+   ap_start_cr3 is the physical address of a page directory that
+   maps the kernel and also maps the first 4 MB of physical
+   memory to virtual address 0.  ap_start_esp is the initial
+   stack pointer, at the top of the CPU's idle thread's page. */
+extern uint32_t ap_start_cr3;
+extern void *ap_start_esp;
+#endif
+
+#endif /* threads/ap-start.h */
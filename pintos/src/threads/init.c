@@ -4,6 +4,7 @@
 #include <inttypes.h>
 #include <limits.h>
 #include <random.h>
+#include <round.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -20,8 +21,14 @@
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/profile.h"
 #include "threads/pte.h"
+#include "threads/rcu.h"
+#include "threads/smp.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -37,6 +44,10 @@
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/swap.h"
+#endif
 
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
@@ -57,6 +68,12 @@ static const char *swap_bdev_name;
 /* -ul: Maximum number of pages to put into palloc's user pool. */
 static size_t user_page_limit = SIZE_MAX;
 
+/* -smp: Maximum number of CPUs to use. */
+static int smp_max_cpus = SMP_MAX_CPUS;
+
+/* -trace: Trace kernel events? */
+static bool trace_option;
+
 static void bss_init (void);
 static void paging_init (void);
 
@@ -88,6 +105,7 @@ main (void)
   /* Initialize ourselves as a thread so we can use locks,
      then enable console locking. */
   thread_init ();
+  rcu_init ();
   console_init ();
 
   /* Greet user. */
@@ -98,6 +116,10 @@ main (void)
   palloc_init (user_page_limit);
   malloc_init ();
   paging_init ();
+  if (trace_option)
+    trace_init ();
+  if (profile_hz > 0)
+    profile_init ();
 
   /* Segmentation. */
 #ifdef USERPROG
@@ -114,18 +136,29 @@ main (void)
   exception_init ();
   syscall_init ();
 #endif
+#ifdef VM
+  frame_init ();
+#endif
 
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
+  workqueue_init ();
   serial_init_queue ();
   timer_calibrate ();
 
+  /* Start other CPUs. */
+  smp_init (smp_max_cpus);
+  timer_tickless_init ();
+
 #ifdef FILESYS
   /* Initialize file system. */
   ide_init ();
   locate_block_devices ();
   filesys_init (format_filesys);
 #endif
+#ifdef VM
+  swap_init ();
+#endif
 
   printf ("Boot complete.\n");
 
@@ -256,13 +289,51 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-stride"))
+        thread_stride = true;
+      else if (!strcmp (name, "-smp"))
+        smp_max_cpus = atoi (value);
+      else if (!strcmp (name, "-tickless"))
+        timer_tickless = true;
+      else if (!strcmp (name, "-lockstat"))
+        lockstat_enabled = true;
+      else if (!strcmp (name, "-irqsoff"))
+        {
+          intr_off_keep = value != NULL ? atoi (value) : 10;
+          if (intr_off_keep <= 0)
+            PANIC ("-irqsoff requires a positive window count");
+        }
+      else if (!strcmp (name, "-profile"))
+        {
+          profile_hz = value != NULL ? atoi (value) : 0;
+          if (profile_hz <= 0)
+            PANIC ("-profile requires a positive sampling rate");
+        }
+      else if (!strcmp (name, "-trace"))
+        {
+          trace_option = true;
+          if (value != NULL && !strcmp (value, "scratch"))
+            trace_to_scratch = true;
+          else if (value != NULL && strcmp (value, "console"))
+            PANIC ("unknown -trace destination `%s'", value);
+        }
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+      else if (!strcmp (name, "-stack"))
+        {
+          int kb = value != NULL ? atoi (value) : 0;
+          if (kb <= 0 || kb > USER_STACK_MAX / 1024)
+            PANIC ("-stack requires a size from 1 to %d kB",
+                   USER_STACK_MAX / 1024);
+          user_stack_limit = ROUND_UP (kb * 1024, PGSIZE);
+        }
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
     }
+  if (thread_mlfqs && thread_stride)
+    PANIC ("-mlfqs and -stride may not be used together");
 
   /* Initialize the random number generator based on the system
      time.  This has no effect if an "-rs" option was specified.
@@ -379,8 +450,19 @@ usage (void)
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -stride            Use stride (proportional-share) scheduler.\n"
+          "  -smp=N             Use at most N CPUs (default: all, up to 8).\n"
+          "  -tickless          Use a one-shot timer and skip ticks when idle.\n"
+          "  -lockstat          Keep lock contention statistics.\n"
+          "  -irqsoff[=N]       Report the N (default: 10) longest windows\n"
+          "                     with interrupts off.\n"
+          "  -profile=HZ        Sample kernel and user code HZ times a second.\n"
+          "  -trace[=DEST]      Trace kernel events, dumping them at power off\n"
+          "                     to DEST, `console' (default) or `scratch'.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+          "  -stack=KB          Let each user thread's stack grow to KB kB\n"
+          "                     (default: 1024, at most 8192).\n"
 #endif
           );
   shutdown_power_off ();
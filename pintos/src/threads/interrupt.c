@@ -6,9 +6,15 @@
 #include "threads/flags.h"
 #include "threads/intr-stubs.h"
 #include "threads/io.h"
+#include "threads/smp.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
 #include "threads/vaddr.h"
+#include "devices/lapic.h"
 #include "devices/timer.h"
+#ifdef USERPROG
+#include "userprog/process.h"
+#endif
 
 /* Programmable Interrupt Controller (PIC) registers.
    A PC has two PICs, called the master and slave PICs, with the
@@ -38,7 +44,8 @@ static const char *intr_names[INTR_CNT];
 static unsigned int unexpected_cnt[INTR_CNT];
 
 /* External interrupts are those generated by devices outside the
-   CPU, such as the timer.  External interrupts run with
+   CPU, such as the timer, and delivered through the PICs or the
+   local APIC.  External interrupts run with
    interrupts turned off, so they never nest, nor are they ever
    pre-empted.  Handlers for external interrupts also may not
    sleep, although they may invoke intr_yield_on_return() to
@@ -47,6 +54,72 @@ static unsigned int unexpected_cnt[INTR_CNT];
 static bool in_external_intr;   /* Are we processing an external interrupt? */
 static bool yield_on_return;    /* Should we yield on interrupt return? */
 
+/* Interrupts-off latency tracer.
+
+   With the "-irqsoff" option, each CPU times every window during
+   which it runs with interrupts off: from the intr_disable() or
+   the interrupt entry that turns them off, to the intr_enable()
+   or the interrupt return that turns them back on.  The longest
+   windows are kept along with the code locations at each end,
+   and intr_latency_print() reports them at power off.
+
+   The windows are per CPU, not per thread, so a window that
+   spans a thread switch is charged in full.  The idle thread's
+   "sti; hlt" turns interrupts on behind our back, so the window
+   it ends is never closed; the next one simply replaces it. */
+
+/* Maximum number of windows kept by -irqsoff. */
+#define INTR_OFF_MAX 64
+
+/* One window with interrupts off. */
+struct intr_off_window
+  {
+    uint64_t cycles;            /* Length, in time stamp counter cycles. */
+    uintptr_t off_site;         /* Where interrupts were turned off. */
+    uintptr_t on_site;          /* Where they were turned back on. */
+    int cpu;                    /* CPU id. */
+  };
+
+/* The window in progress on each CPU, and statistics. */
+struct intr_off_cpu
+  {
+    bool open;                  /* Interrupts off, and being timed? */
+    uint64_t start;             /* Time stamp counter at start. */
+    uintptr_t off_site;         /* Where interrupts were turned off. */
+    unsigned long long window_cnt; /* Number of windows. */
+    uint64_t total_cycles;      /* Sum of their lengths. */
+  };
+
+int intr_off_keep;
+static bool latency_enabled;    /* Timing windows? */
+static struct intr_off_cpu off_cpus[SMP_MAX_CPUS];
+
+/* The longest windows, longest first, protected by
+   worst_busy. */
+static struct intr_off_window worst[INTR_OFF_MAX];
+static int worst_cnt;
+static uint32_t worst_busy;
+static unsigned long long worst_missed; /* Windows skipped while busy. */
+
+/* Time stamp counter and time when timing started. */
+static uint64_t latency_start_tsc;
+static int64_t latency_start_ns;
+
+static enum intr_level enable (uintptr_t site);
+static enum intr_level disable (uintptr_t site);
+static struct intr_off_cpu *latency_cpu (void);
+static void latency_start (uintptr_t site);
+static void latency_end (uintptr_t site);
+
+/* Returns the current value of the time stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
 static void pic_end_of_interrupt (int irq);
@@ -55,6 +128,7 @@ static void pic_end_of_interrupt (int irq);
 static uint64_t make_intr_gate (void (*) (void), int dpl);
 static uint64_t make_trap_gate (void (*) (void), int dpl);
 static inline uint64_t make_idtr_operand (uint16_t limit, void *base);
+static bool is_external (uint8_t vec_no);
 
 /* Interrupt handlers. */
 void intr_handler (struct intr_frame *args);
@@ -80,16 +154,35 @@ intr_get_level (void)
 enum intr_level
 intr_set_level (enum intr_level level)
 {
-  return level == INTR_ON ? intr_enable () : intr_disable ();
+  uintptr_t site = (uintptr_t) __builtin_return_address (0);
+  return level == INTR_ON ? enable (site) : disable (site);
 }
 
 /* Enables interrupts and returns the previous interrupt status. */
 enum intr_level
 intr_enable (void)
+{
+  return enable ((uintptr_t) __builtin_return_address (0));
+}
+
+/* Disables interrupts and returns the previous interrupt status. */
+enum intr_level
+intr_disable (void)
+{
+  return disable ((uintptr_t) __builtin_return_address (0));
+}
+
+/* Enables interrupts on behalf of the code at SITE and returns
+   the previous interrupt status. */
+static enum intr_level
+enable (uintptr_t site)
 {
   enum intr_level old_level = intr_get_level ();
   ASSERT (!intr_context ());
 
+  if (latency_enabled && old_level == INTR_OFF)
+    latency_end (site);
+
   /* Enable interrupts by setting the interrupt flag.
 
      See [IA32-v2b] "STI" and [IA32-v3a] 5.8.1 "Masking Maskable
@@ -99,9 +192,10 @@ intr_enable (void)
   return old_level;
 }
 
-/* Disables interrupts and returns the previous interrupt status. */
-enum intr_level
-intr_disable (void)
+/* Disables interrupts on behalf of the code at SITE and returns
+   the previous interrupt status. */
+static enum intr_level
+disable (uintptr_t site)
 {
   enum intr_level old_level = intr_get_level ();
 
@@ -110,6 +204,9 @@ intr_disable (void)
      Hardware Interrupts". */
   asm volatile ("cli" : : : "memory");
 
+  if (latency_enabled && old_level == INTR_ON)
+    latency_start (site);
+
   return old_level;
 }
 
@@ -117,7 +214,6 @@ intr_disable (void)
 void
 intr_init (void)
 {
-  uint64_t idtr_operand;
   int i;
 
   /* Initialize interrupt controller. */
@@ -127,11 +223,8 @@ intr_init (void)
   for (i = 0; i < INTR_CNT; i++)
     idt[i] = make_intr_gate (intr_stubs[i], 0);
 
-  /* Load IDT register.
-     See [IA32-v2a] "LIDT" and [IA32-v3a] 5.10 "Interrupt
-     Descriptor Table (IDT)". */
-  idtr_operand = make_idtr_operand (sizeof idt - 1, idt);
-  asm volatile ("lidt %0" : : "m" (idtr_operand));
+  /* Load IDT register. */
+  intr_init_ap ();
 
   /* Initialize intr_names. */
   for (i = 0; i < INTR_CNT; i++)
@@ -155,6 +248,30 @@ intr_init (void)
   intr_names[17] = "#AC Alignment Check Exception";
   intr_names[18] = "#MC Machine-Check Exception";
   intr_names[19] = "#XF SIMD Floating-Point Exception";
+
+  /* Start timing interrupts-off windows, now that each CPU can
+     find its struct cpu. */
+  if (intr_off_keep > 0)
+    {
+      if (intr_off_keep > INTR_OFF_MAX)
+        intr_off_keep = INTR_OFF_MAX;
+      latency_start_tsc = rdtsc ();
+      latency_start_ns = timer_ns ();
+      barrier ();
+      latency_enabled = true;
+    }
+}
+
+/* Points the running CPU at the IDT that intr_init() built.
+   Each application processor calls this at startup, because all
+   CPUs share a single IDT.
+   See [IA32-v2a] "LIDT" and [IA32-v3a] 5.10 "Interrupt
+   Descriptor Table (IDT)". */
+void
+intr_init_ap (void)
+{
+  uint64_t idtr_operand = make_idtr_operand (sizeof idt - 1, idt);
+  asm volatile ("lidt %0" : : "m" (idtr_operand));
 }
 
 /* Registers interrupt VEC_NO to invoke HANDLER with descriptor
@@ -181,7 +298,7 @@ void
 intr_register_ext (uint8_t vec_no, intr_handler_func *handler,
                    const char *name)
 {
-  ASSERT (vec_no >= 0x20 && vec_no <= 0x2f);
+  ASSERT (is_external (vec_no));
   register_handler (vec_no, 0, INTR_OFF, handler, name);
 }
 
@@ -202,10 +319,19 @@ void
 intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
                    intr_handler_func *handler, const char *name)
 {
-  ASSERT (vec_no < 0x20 || vec_no > 0x2f);
+  ASSERT (!is_external (vec_no));
   register_handler (vec_no, dpl, level, handler, name);
 }
 
+/* Returns true if VEC_NO is an external interrupt: one from the
+   PICs, at 0x20...0x2f, or one from the local APIC. */
+static bool
+is_external (uint8_t vec_no)
+{
+  return ((vec_no >= 0x20 && vec_no <= 0x2f)
+          || (vec_no >= LAPIC_VEC_MIN && vec_no <= LAPIC_VEC_MAX));
+}
+
 /* Returns true during processing of an external interrupt
    and false at all other times. */
 bool
@@ -346,12 +472,38 @@ intr_handler (struct intr_frame *frame)
 {
   bool external;
   intr_handler_func *handler;
+  uintptr_t site;
+
+  /* The CPU that sent a TLB shootdown IPI holds the kernel lock
+     until we handle it, so handle it without the lock. */
+  if (frame->vec_no == LAPIC_VEC_TLB)
+    {
+      intr_handlers[LAPIC_VEC_TLB] (frame);
+      lapic_eoi ();
+      return;
+    }
+
+  /* An interrupt gate turns interrupts off on the way in.  If the
+     interrupted code had them on, a window starts here, which
+     we charge to the handler. */
+  if (intr_handlers[frame->vec_no] != NULL)
+    site = (uintptr_t) intr_handlers[frame->vec_no];
+  else
+    site = (uintptr_t) intr_stubs[frame->vec_no];
+  if (latency_enabled && (frame->eflags & FLAG_IF)
+      && intr_get_level () == INTR_OFF)
+    latency_start (site);
+
+  /* With several CPUs, only one at a time may run kernel code.
+     We may have come from user mode, or from an idle CPU's halt,
+     without holding the kernel lock. */
+  kernel_lock_enter ();
 
   /* External interrupts are special.
      We only handle one at a time (so interrupts must be off)
-     and they need to be acknowledged on the PIC (see below).
-     An external interrupt handler cannot sleep. */
-  external = frame->vec_no >= 0x20 && frame->vec_no < 0x30;
+     and they need to be acknowledged on the PIC or local APIC
+     (see below).  An external interrupt handler cannot sleep. */
+  external = is_external (frame->vec_no);
   if (external)
     {
       ASSERT (intr_get_level () == INTR_OFF);
@@ -362,6 +514,7 @@ intr_handler (struct intr_frame *frame)
     }
 
   /* Invoke the interrupt's handler. */
+  TRACE (TRACE_INTR_ENTER, frame->vec_no, frame->eip, 0);
   handler = intr_handlers[frame->vec_no];
   if (handler != NULL)
     handler (frame);
@@ -373,6 +526,7 @@ intr_handler (struct intr_frame *frame)
     }
   else
     unexpected_interrupt (frame);
+  TRACE (TRACE_INTR_EXIT, frame->vec_no, 0, 0);
 
   /* Complete the processing of an external interrupt. */
   if (external)
@@ -381,11 +535,38 @@ intr_handler (struct intr_frame *frame)
       ASSERT (intr_context ());
 
       in_external_intr = false;
-      pic_end_of_interrupt (frame->vec_no);
+      if (frame->vec_no >= LAPIC_VEC_MIN)
+        lapic_eoi ();
+      else
+        pic_end_of_interrupt (frame->vec_no);
 
       if (yield_on_return)
         thread_yield ();
     }
+
+#ifdef USERPROG
+  /* Once one thread of a process calls exit(), none of the
+     others may return to user mode. */
+  if ((frame->cs & 3) == 3 && process_exiting ())
+    {
+      intr_enable ();
+      thread_exit ();
+    }
+#endif
+
+  /* Returning to user mode leaves the kernel.  The interrupt
+     return restores the user's interrupt flag. */
+  if (smp_active && (frame->cs & 3) == 3)
+    {
+      intr_disable ();
+      kernel_lock_exit ();
+    }
+
+  /* The interrupt return turns interrupts back on if the
+     interrupted code had them on. */
+  if (latency_enabled && (frame->eflags & FLAG_IF)
+      && intr_get_level () == INTR_OFF)
+    latency_end (site);
 }
 
 /* Handles an unexpected interrupt with interrupt frame F.  An
@@ -436,3 +617,116 @@ intr_name (uint8_t vec)
 {
   return intr_names[vec];
 }
+
+/* Returns the running CPU's interrupts-off window.  Like
+   thread_current(), but without its assertions, since interrupts
+   go off and on in the middle of thread switches. */
+static struct intr_off_cpu *
+latency_cpu (void)
+{
+  struct thread *t;
+
+  asm ("mov %%esp, %0" : "=g" (t));
+  t = pg_round_down (t);
+  return &off_cpus[t->cpu != NULL ? t->cpu->id : 0];
+}
+
+/* Starts timing a window in which interrupts, which were on, have
+   just been turned off by the code at SITE. */
+static void
+latency_start (uintptr_t site)
+{
+  struct intr_off_cpu *c = latency_cpu ();
+
+  c->open = true;
+  c->off_site = site;
+  c->start = rdtsc ();
+}
+
+/* Ends the running CPU's window, if one is being timed, because
+   the code at SITE is about to turn interrupts back on.  Adds it
+   to the longest windows if it is long enough. */
+static void
+latency_end (uintptr_t site)
+{
+  struct intr_off_cpu *c = latency_cpu ();
+  uint64_t cycles;
+  int i;
+
+  if (!c->open)
+    return;
+  c->open = false;
+  cycles = rdtsc () - c->start;
+  c->window_cnt++;
+  c->total_cycles += cycles;
+
+  /* Most windows are short, so check without the lock first. */
+  if (worst_cnt == intr_off_keep && cycles <= worst[worst_cnt - 1].cycles)
+    return;
+
+  /* Another CPU may be updating the list.  Rather than wait with
+     interrupts off, which is what we are measuring, skip this
+     window. */
+  if (__sync_lock_test_and_set (&worst_busy, 1))
+    {
+      worst_missed++;
+      return;
+    }
+  if (worst_cnt < intr_off_keep)
+    worst_cnt++;
+  else if (cycles <= worst[worst_cnt - 1].cycles)
+    {
+      __sync_lock_release (&worst_busy);
+      return;
+    }
+  for (i = worst_cnt - 1; i > 0 && worst[i - 1].cycles < cycles; i--)
+    worst[i] = worst[i - 1];
+  worst[i].cycles = cycles;
+  worst[i].off_site = c->off_site;
+  worst[i].on_site = site;
+  worst[i].cpu = c - off_cpus;
+  __sync_lock_release (&worst_busy);
+}
+
+/* Stops timing interrupts-off windows and prints the longest
+   ones, with where interrupts went off and came back on.
+   utils/backtrace turns those addresses into function names. */
+void
+intr_latency_print (void)
+{
+  unsigned long long window_cnt = 0;
+  uint64_t total_cycles = 0;
+  int64_t elapsed_ns;
+  uint64_t cycles_per_us;
+  int i;
+
+  if (!latency_enabled)
+    return;
+  latency_enabled = false;
+  barrier ();
+
+  for (i = 0; i < SMP_MAX_CPUS; i++)
+    {
+      window_cnt += off_cpus[i].window_cnt;
+      total_cycles += off_cpus[i].total_cycles;
+    }
+  elapsed_ns = timer_ns () - latency_start_ns;
+  cycles_per_us = (elapsed_ns >= 1000
+                   ? (rdtsc () - latency_start_tsc) / (elapsed_ns / 1000)
+                   : 0);
+
+  printf ("Interrupts off: %llu windows, %"PRIu64" cycles average, "
+          "%llu not ranked\n",
+          window_cnt, window_cnt > 0 ? total_cycles / window_cnt : 0,
+          worst_missed);
+  for (i = 0; i < worst_cnt; i++)
+    {
+      const struct intr_off_window *w = &worst[i];
+
+      printf ("  %12"PRIu64" cycles", w->cycles);
+      if (cycles_per_us > 0)
+        printf (" (%6"PRIu64" us)", w->cycles / cycles_per_us);
+      printf (" cpu %d: off at %#"PRIxPTR", on at %#"PRIxPTR"\n",
+              w->cpu, w->off_site, w->on_site);
+    }
+}
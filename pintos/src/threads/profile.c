@@ -0,0 +1,275 @@
+#include "threads/profile.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "threads/palloc.h"
+#include "threads/smp.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+#ifdef USERPROG
+#include "userprog/pagedir.h"
+#endif
+
+/* Maximum number of samples kept. */
+#define PROFILE_SAMPLES 4096
+
+/* Maximum number of addresses in a sampled call stack. */
+#define PROFILE_DEPTH 8
+
+/* One sample. */
+struct sample
+  {
+    bool user;                  /* Interrupted user code? */
+    uint8_t depth;              /* Number of addresses in stack[]. */
+    char name[16];              /* User program, or "" for kernel. */
+    uint32_t stack[PROFILE_DEPTH]; /* eip, then return addresses. */
+  };
+
+/* Number of pages in the sample buffer. */
+#define PROFILE_PAGES \
+        DIV_ROUND_UP (PROFILE_SAMPLES * sizeof (struct sample), PGSIZE)
+
+int profile_hz;
+
+/* Samples.  The timer interrupt handlers run under the kernel
+   lock, so they never add samples at the same time. */
+static struct sample *samples;
+static size_t sample_cnt;
+
+/* Statistics. */
+static unsigned kernel_cnt;     /* # of kernel samples. */
+static unsigned user_cnt;       /* # of user samples. */
+static unsigned dropped_cnt;    /* # of samples with no room. */
+
+/* Timer ticks between samples, and ticks since the last sample
+   on each CPU. */
+static int sample_ticks;
+static int cpu_ticks[SMP_MAX_CPUS];
+
+static int walk_kernel (const struct intr_frame *, uint32_t *, int max);
+static int walk_user (struct thread *, uint32_t ebp, uint32_t *, int max);
+static int compare_eips (const void *, const void *);
+static int compare_stacks (const void *, const void *);
+static void print_flat (void);
+static void print_stacks (void);
+
+/* Allocates the sample buffer and starts profiling.  Called after
+   palloc_init() if the "-profile" option was given. */
+void
+profile_init (void)
+{
+  ASSERT (profile_hz > 0);
+
+  if (profile_hz > TIMER_FREQ)
+    {
+      printf ("profile: sampling at %d Hz, the timer frequency\n",
+              TIMER_FREQ);
+      profile_hz = TIMER_FREQ;
+    }
+  sample_ticks = TIMER_FREQ / profile_hz;
+  profile_hz = TIMER_FREQ / sample_ticks;
+
+  samples = palloc_get_multiple (0, PROFILE_PAGES);
+  if (samples == NULL)
+    {
+      printf ("profile: out of memory, profiling disabled\n");
+      profile_hz = 0;
+    }
+}
+
+/* Takes a sample, if one is due, of the code interrupted with
+   frame F.  Called by each CPU's timer interrupt handler. */
+void
+profile_tick (const struct intr_frame *f)
+{
+  struct thread *t;
+  struct sample *s;
+
+  if (profile_hz == 0)
+    return;
+
+  t = thread_current ();
+  if (++cpu_ticks[t->cpu->id] < sample_ticks)
+    return;
+  cpu_ticks[t->cpu->id] = 0;
+
+  if (sample_cnt >= PROFILE_SAMPLES)
+    {
+      dropped_cnt++;
+      return;
+    }
+  s = &samples[sample_cnt++];
+  s->user = (f->cs & 3) == 3;
+  s->stack[0] = (uint32_t) f->eip;
+  if (s->user)
+    {
+      strlcpy (s->name, t->name, sizeof s->name);
+      s->depth = 1 + walk_user (t, f->ebp, s->stack + 1, PROFILE_DEPTH - 1);
+      user_cnt++;
+    }
+  else
+    {
+      s->name[0] = '\0';
+      s->depth = 1 + walk_kernel (f, s->stack + 1, PROFILE_DEPTH - 1);
+      kernel_cnt++;
+    }
+}
+
+/* Stops profiling and prints the samples. */
+void
+profile_print (void)
+{
+  if (profile_hz == 0)
+    return;
+
+  printf ("Profile: %u kernel samples, %u user samples, "
+          "%u not recorded, %d Hz\n",
+          kernel_cnt, user_cnt, dropped_cnt, profile_hz);
+  profile_hz = 0;
+  barrier ();
+
+  print_flat ();
+  print_stacks ();
+}
+
+/* Stores in STACK up to MAX return addresses found by following
+   the frame pointers of the kernel code interrupted with frame F,
+   and returns the number stored.  That code ran on the same
+   stack as the interrupt handler, just above F. */
+static int
+walk_kernel (const struct intr_frame *f, uint32_t *stack, int max)
+{
+  const uint32_t *fp = (const uint32_t *) f->ebp;
+  const void *page = pg_round_down (f);
+  int n = 0;
+
+  while (n < max
+         && (const void *) fp > (const void *) f
+         && pg_round_down (fp + 1) == page)
+    {
+      const uint32_t *next = (const uint32_t *) fp[0];
+
+      stack[n++] = fp[1];
+      if (next <= fp)
+        break;
+      fp = next;
+    }
+  return n;
+}
+
+/* Stores in STACK up to MAX return addresses found by following
+   the frame pointers of user thread T from EBP, and returns the
+   number stored.  Reads the user stack through T's page
+   directory, so that a bad frame pointer cannot fault. */
+static int
+walk_user (struct thread *t UNUSED, uint32_t ebp UNUSED,
+           uint32_t *stack UNUSED, int max UNUSED)
+{
+  int n = 0;
+
+#ifdef USERPROG
+  while (n < max && t->pagedir != NULL
+         && ebp != 0 && ebp % sizeof (uint32_t) == 0
+         && is_user_vaddr ((void *) (ebp + sizeof (uint32_t)))
+         && pg_ofs ((void *) ebp) <= PGSIZE - 2 * sizeof (uint32_t))
+    {
+      const uint32_t *fp = pagedir_get_page (t->pagedir, (void *) ebp);
+
+      if (fp == NULL)
+        break;
+      stack[n++] = fp[1];
+      if (fp[0] <= ebp)
+        break;
+      ebp = fp[0];
+    }
+#endif
+  return n;
+}
+
+/* Orders samples A and B for print_flat(): kernel before user,
+   then by program name, then by eip. */
+static int
+compare_eips (const void *a_, const void *b_)
+{
+  const struct sample *a = a_;
+  const struct sample *b = b_;
+  int cmp;
+
+  if (a->user != b->user)
+    return a->user ? 1 : -1;
+  cmp = strcmp (a->name, b->name);
+  if (cmp != 0)
+    return cmp;
+  return a->stack[0] < b->stack[0] ? -1 : a->stack[0] > b->stack[0];
+}
+
+/* Orders samples A and B for print_stacks(): as compare_eips(),
+   then by the rest of the stack. */
+static int
+compare_stacks (const void *a_, const void *b_)
+{
+  const struct sample *a = a_;
+  const struct sample *b = b_;
+  int cmp = compare_eips (a, b);
+  int i;
+
+  if (cmp != 0)
+    return cmp;
+  for (i = 1; i < a->depth && i < b->depth; i++)
+    if (a->stack[i] != b->stack[i])
+      return a->stack[i] < b->stack[i] ? -1 : 1;
+  return a->depth - b->depth;
+}
+
+/* Prints the number of samples at each eip, as lines of the form
+   "profile: flat MODE PROGRAM EIP COUNT", where MODE is "kernel"
+   or "user" and PROGRAM is "-" for the kernel. */
+static void
+print_flat (void)
+{
+  size_t i, j;
+
+  qsort (samples, sample_cnt, sizeof *samples, compare_eips);
+  for (i = 0; i < sample_cnt; i = j)
+    {
+      const struct sample *s = &samples[i];
+
+      for (j = i + 1; j < sample_cnt; j++)
+        if (compare_eips (s, &samples[j]) != 0)
+          break;
+      printf ("profile: flat %s %s %#"PRIx32" %zu\n",
+              s->user ? "user" : "kernel", s->user ? s->name : "-",
+              s->stack[0], j - i);
+    }
+}
+
+/* Prints the number of samples with each call stack, as lines of
+   the form "profile: stack MODE PROGRAM ADDR,ADDR,... COUNT",
+   innermost address first, where MODE and PROGRAM are as for
+   print_flat(). */
+static void
+print_stacks (void)
+{
+  size_t i, j;
+
+  qsort (samples, sample_cnt, sizeof *samples, compare_stacks);
+  for (i = 0; i < sample_cnt; i = j)
+    {
+      const struct sample *s = &samples[i];
+      int k;
+
+      for (j = i + 1; j < sample_cnt; j++)
+        if (compare_stacks (s, &samples[j]) != 0)
+          break;
+      printf ("profile: stack %s %s ",
+              s->user ? "user" : "kernel", s->user ? s->name : "-");
+      for (k = 0; k < s->depth; k++)
+        printf ("%s%#"PRIx32, k > 0 ? "," : "", s->stack[k]);
+      printf (" %zu\n", j - i);
+    }
+}
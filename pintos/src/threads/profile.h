@@ -0,0 +1,29 @@
+#ifndef THREADS_PROFILE_H
+#define THREADS_PROFILE_H
+
+#include <stdbool.h>
+#include "threads/interrupt.h"
+
+/* Sampling profiler.
+
+   With the "-profile=HZ" kernel command-line option, the timer
+   interrupt on each CPU records, HZ times a second, where the
+   interrupted code was: its eip, its thread, whether it was in
+   user or kernel mode, and its call stack, found by following
+   frame pointers.  Samples go into a buffer allocated at boot,
+   and once it fills up, later samples are only counted.
+
+   At power off, profile_print() prints a flat histogram of the
+   sampled eips and the sampled call stacks in "folded" form, one
+   line per distinct stack with its count, kernel and user
+   samples apart.  utils/profile symbolizes both against
+   kernel.o and the user programs. */
+
+/* -profile: Samples per second, or 0 if not profiling. */
+extern int profile_hz;
+
+void profile_init (void);
+void profile_tick (const struct intr_frame *);
+void profile_print (void);
+
+#endif /* threads/profile.h */
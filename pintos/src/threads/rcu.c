@@ -0,0 +1,297 @@
+#include "threads/rcu.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/smp.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
+
+/* Grace periods.
+
+   Callbacks passed to call_rcu() wait in next_list until a grace
+   period starts, then in wait_list until it ends, then in
+   done_list until rcu_work runs them in a system_wq worker, so
+   that they may sleep, take locks, and call free().  Only one
+   grace period is in progress at a time; callbacks that arrive
+   during one wait for the next, which starts as soon as the
+   current one ends.
+
+   When a grace period starts, gp_cpus gets a bit for each CPU
+   that might be inside a read-side critical section: every
+   running CPU except those that are idle, and except the CPU
+   that starts it from a quiescent state.  rcu_quiescent()
+   clears the running CPU's bit, and the grace period ends when
+   the last bit is cleared.  Most calls find their CPU's bit
+   clear, and return without taking rcu_lock.
+
+   Readers keep from being preempted with
+   thread_preempt_disable(), so a thread switch always finds the
+   old thread outside any read-side critical section.  A reader
+   must not sleep, so it cannot be switched out any other way
+   either. */
+
+/* Protects the members below.  Taken with interrupts off, since
+   rcu_quiescent() runs in the timer interrupt handler. */
+static struct spinlock rcu_lock;
+static struct list next_list;   /* Waiting for a grace period to start. */
+static struct list wait_list;   /* Waiting for this grace period to end. */
+static struct list done_list;   /* Grace period over, to be run. */
+static volatile uint32_t gp_cpus; /* CPUs yet to pass a quiescent state. */
+static unsigned gp_cnt;         /* # of grace periods completed. */
+static unsigned cb_cnt;         /* # of callbacks run. */
+
+/* Runs the callbacks in done_list. */
+static struct work rcu_work;
+
+static void gp_start (struct cpu *quiet);
+static void gp_end (struct cpu *quiet);
+static void run_callbacks (void *aux);
+static void wake_up (struct rcu_head *);
+
+/* Initializes RCU.  Callbacks whose grace period ends before
+   workqueue_init() has run wait until it has. */
+void
+rcu_init (void)
+{
+  spin_init (&rcu_lock, "rcu");
+  list_init (&next_list);
+  list_init (&wait_list);
+  list_init (&done_list);
+  work_init (&rcu_work, run_callbacks, NULL, PRI_DEFAULT);
+}
+
+/* Begins a read-side critical section.  Until the matching
+   rcu_read_unlock(), objects that the caller finds through
+   RCU-protected pointers stay allocated, and the caller must not
+   sleep.  Read-side critical sections may nest. */
+void
+rcu_read_lock (void)
+{
+  thread_preempt_disable ();
+}
+
+/* Ends a read-side critical section. */
+void
+rcu_read_unlock (void)
+{
+  thread_preempt_enable ();
+}
+
+/* Returns true if the running thread might be in a read-side
+   critical section.  For assertions. */
+bool
+rcu_read_lock_held (void)
+{
+  return thread_current ()->preempt_off > 0;
+}
+
+/* Reports that the running CPU is in a quiescent state: it has
+   left every read-side critical section that it entered before
+   now.  Called at each thread switch and at timer ticks that
+   find the running thread outside any read-side critical
+   section.  Interrupts must be off. */
+void
+rcu_quiescent (void)
+{
+  struct cpu *cpu = thread_current ()->cpu;
+  uint32_t bit = (uint32_t) 1 << cpu->id;
+  bool done;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if ((gp_cpus & bit) == 0)
+    return;
+
+  spin_lock (&rcu_lock);
+  gp_cpus &= ~bit;
+  if (gp_cpus == 0 && !list_empty (&wait_list))
+    gp_end (cpu);
+  done = !list_empty (&done_list);
+  spin_unlock (&rcu_lock);
+
+  if (done && system_wq != NULL)
+    workqueue_submit (system_wq, &rcu_work);
+}
+
+/* Arranges for FUNC(HEAD) to be called, in a kernel thread,
+   after every read-side critical section in progress has
+   ended.  Typically, HEAD is embedded in an object that the
+   caller has just unlinked from an RCU-protected structure, and
+   FUNC frees the object.
+
+   This function may be called from an interrupt handler and
+   from within a read-side critical section. */
+void
+call_rcu (struct rcu_head *head, rcu_func *func)
+{
+  enum intr_level old_level;
+  bool done;
+
+  ASSERT (head != NULL);
+  ASSERT (func != NULL);
+
+  head->func = func;
+  old_level = spin_lock_irqsave (&rcu_lock);
+  list_push_back (&next_list, &head->elem);
+  if (list_empty (&wait_list))
+    gp_start (NULL);
+  done = !list_empty (&done_list);
+  spin_unlock_irqrestore (&rcu_lock, old_level);
+
+  /* The grace period ended at once if every CPU was idle, which
+     happens when an interrupt handler in an idle thread calls
+     us. */
+  if (done && system_wq != NULL)
+    workqueue_submit (system_wq, &rcu_work);
+}
+
+/* Semaphore and callback used by synchronize_rcu(). */
+struct rcu_waiter
+  {
+    struct rcu_head head;
+    struct semaphore sema;
+  };
+
+/* Waits until every read-side critical section in progress has
+   ended.  Must not be called from a read-side critical section
+   or an interrupt handler. */
+void
+synchronize_rcu (void)
+{
+  struct rcu_waiter w;
+
+  ASSERT (!intr_context ());
+  ASSERT (!rcu_read_lock_held ());
+  ASSERT (system_wq != NULL);
+
+  sema_init (&w.sema, 0);
+  call_rcu (&w.head, wake_up);
+  sema_down (&w.sema);
+}
+
+/* Prints RCU statistics. */
+void
+rcu_print_stats (void)
+{
+  printf ("RCU: %u grace periods, %u callbacks\n", gp_cnt, cb_cnt);
+}
+
+/* Inserts ELEM just before BEFORE, publishing it to readers only
+   once its own links are set.  The caller must exclude other
+   writers. */
+void
+rcu_list_insert (struct list_elem *before, struct list_elem *elem)
+{
+  ASSERT (before != NULL && before->prev != NULL);
+  ASSERT (elem != NULL);
+
+  elem->prev = before->prev;
+  elem->next = before;
+  rcu_assign_pointer (before->prev->next, elem);
+  before->prev = elem;
+}
+
+/* Inserts ELEM at the beginning of LIST, for readers walking
+   LIST at the same time.  The caller must exclude other
+   writers. */
+void
+rcu_list_push_front (struct list *list, struct list_elem *elem)
+{
+  rcu_list_insert (list_begin (list), elem);
+}
+
+/* Inserts ELEM at the end of LIST, for readers walking LIST at
+   the same time.  The caller must exclude other writers. */
+void
+rcu_list_push_back (struct list *list, struct list_elem *elem)
+{
+  rcu_list_insert (list_end (list), elem);
+}
+
+/* Removes ELEM from its list.  ELEM keeps its forward link, so
+   that a reader that is looking at ELEM can still go on to the
+   next element, and so ELEM must not be reused or freed until a
+   grace period has passed.  The caller must exclude other
+   writers. */
+void
+rcu_list_remove (struct list_elem *elem)
+{
+  list_remove (elem);
+}
+
+/* Starts a grace period for the callbacks in next_list.  QUIET,
+   if nonnull, is a CPU known to be in a quiescent state.
+   rcu_lock must be held. */
+static void
+gp_start (struct cpu *quiet)
+{
+  uint32_t cpus_mask = 0;
+  int i;
+
+  ASSERT (spin_held_by_current_thread (&rcu_lock));
+  ASSERT (list_empty (&wait_list));
+
+  while (!list_empty (&next_list))
+    list_push_back (&wait_list, list_pop_front (&next_list));
+
+  /* An idle CPU would not report a quiescent state until it woke
+     up, but it is not in a read-side critical section either,
+     unless an interrupt handler on it is. */
+  for (i = 0; i < smp_cpu_cnt; i++)
+    {
+      struct thread *t = cpus[i].current;
+      if (&cpus[i] != quiet
+          && (t != cpus[i].idle_thread || t->preempt_off > 0))
+        cpus_mask |= (uint32_t) 1 << i;
+    }
+  gp_cpus = cpus_mask;
+  if (cpus_mask == 0)
+    gp_end (quiet);
+}
+
+/* Ends the grace period in progress and starts the next one, if
+   any callbacks are waiting for one.  QUIET is as for
+   gp_start().  rcu_lock must be held. */
+static void
+gp_end (struct cpu *quiet)
+{
+  ASSERT (spin_held_by_current_thread (&rcu_lock));
+
+  while (!list_empty (&wait_list))
+    list_push_back (&done_list, list_pop_front (&wait_list));
+  gp_cnt++;
+  if (!list_empty (&next_list))
+    gp_start (quiet);
+}
+
+/* Runs the callbacks in done_list.  Runs as rcu_work. */
+static void
+run_callbacks (void *aux UNUSED)
+{
+  for (;;)
+    {
+      enum intr_level old_level;
+      struct rcu_head *head = NULL;
+
+      old_level = spin_lock_irqsave (&rcu_lock);
+      if (!list_empty (&done_list))
+        {
+          head = list_entry (list_pop_front (&done_list),
+                             struct rcu_head, elem);
+          cb_cnt++;
+        }
+      spin_unlock_irqrestore (&rcu_lock, old_level);
+
+      if (head == NULL)
+        break;
+      head->func (head);
+    }
+}
+
+/* Callback used by synchronize_rcu(). */
+static void
+wake_up (struct rcu_head *head)
+{
+  struct rcu_waiter *w = rcu_entry (head, struct rcu_waiter, head);
+  sema_up (&w->sema);
+}
@@ -0,0 +1,78 @@
+#ifndef THREADS_RCU_H
+#define THREADS_RCU_H
+
+#include <list.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "threads/synch.h"
+
+/* Read-copy update (RCU).
+
+   RCU protects data that is read far more often than it is
+   changed.  Readers take no lock and do not turn off interrupts:
+   they merely bracket their accesses with rcu_read_lock() and
+   rcu_read_unlock(), which keep the running thread from being
+   preempted.  Writers still exclude one another with an ordinary
+   lock, and publish changes so that a concurrent reader sees
+   either the old version or the new one, never a mix.  A writer
+   that unlinks an object must not free it while a reader may
+   still hold a pointer to it, so it hands the object to
+   call_rcu(), which frees it only after a grace period, once
+   every reader that could have seen the object has finished.
+
+   A read-side critical section must not sleep.  A CPU is thus
+   in a quiescent state, outside any read-side critical section,
+   whenever it switches threads and whenever a timer tick finds
+   its running thread outside one.  A grace period ends once
+   every CPU that was busy when it began has passed through a
+   quiescent state.  See rcu.c for details.
+
+   The rcu_list_*() functions change a struct list so that
+   readers may walk it forward, with list_begin() and
+   list_next(), at the same time.  Readers must not walk it
+   backward. */
+
+/* Callback for call_rcu(). */
+struct rcu_head;
+typedef void rcu_func (struct rcu_head *);
+
+/* Deferred callback, typically embedded in the object to be
+   freed. */
+struct rcu_head
+  {
+    struct list_elem elem;      /* Element in a callback list. */
+    rcu_func *func;             /* Function to call. */
+  };
+
+/* Converts pointer to RCU head RCU_HEAD into a pointer to the
+   structure that RCU_HEAD is embedded inside.  Supply the name
+   of the outer structure STRUCT and the member name MEMBER of
+   the RCU head. */
+#define rcu_entry(RCU_HEAD, STRUCT, MEMBER)             \
+        ((STRUCT *) ((uint8_t *) (RCU_HEAD)             \
+                     - offsetof (STRUCT, MEMBER)))
+
+/* Stores V into pointer P after all the stores that precede it,
+   such as those that initialize *V.  x86 does not reorder stores
+   with other stores, so an optimization barrier suffices. */
+#define rcu_assign_pointer(P, V) \
+        do { barrier (); (P) = (V); } while (0)
+
+/* Loads pointer P exactly once, for a reader. */
+#define rcu_dereference(P) (*(__typeof__ (P) volatile *) &(P))
+
+void rcu_init (void);
+void rcu_read_lock (void);
+void rcu_read_unlock (void);
+bool rcu_read_lock_held (void);
+void rcu_quiescent (void);
+void call_rcu (struct rcu_head *, rcu_func *);
+void synchronize_rcu (void);
+void rcu_print_stats (void);
+
+void rcu_list_insert (struct list_elem *before, struct list_elem *);
+void rcu_list_push_front (struct list *, struct list_elem *);
+void rcu_list_push_back (struct list *, struct list_elem *);
+void rcu_list_remove (struct list_elem *);
+
+#endif /* threads/rcu.h */
@@ -0,0 +1,464 @@
+#include "threads/smp.h"
+#include <debug.h>
+#include <packed.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/lapic.h"
+#include "devices/timer.h"
+#include "threads/ap-start.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/pte.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef USERPROG
+#include "userprog/gdt.h"
+#endif
+
+/* Symmetric multiprocessing.
+
+   smp_init() finds the CPUs in the BIOS's MultiProcessor
+   Specification tables, then starts each application processor
+   (AP) with the INIT-SIPI-SIPI sequence through the local APIC.
+   Each AP runs ap-start.S, then smp_ap_main(), and from then on
+   schedules threads like the bootstrap processor does.
+
+   Kernel lock.
+
+   Most of the kernel predates SMP and makes its critical
+   sections atomic by turning off interrupts, which only works on
+   one CPU.  Rather than rework every such critical section, we
+   allow only one CPU at a time to run kernel code.  A CPU takes
+   the kernel lock when it enters the kernel from user mode or
+   from its idle thread's halt, and releases it when it returns
+   to user mode or halts again.  The lock belongs to the CPU, not
+   to a thread, so thread switches do not affect it.  User
+   processes still run in parallel, and that is what CPU-bound
+   workloads need.
+
+   A CPU that holds the kernel lock and busy-waits for an
+   interrupt that only another CPU receives would deadlock, so
+   kernel threads never leave CPU 0, which receives all device
+   interrupts.  Only user processes migrate (see thread.c).
+
+   TLB shootdown.
+
+   A CPU that changes a page table entry of a process that other
+   CPUs are running must flush their TLBs too, before it relies
+   on the change, for example by reusing the frame that the entry
+   mapped.  It holds the kernel lock while it waits for them, so
+   they flush without taking the lock: in the shootdown IPI's
+   handler, which intr_handler() runs before it takes the lock,
+   or while they spin waiting for it in kernel_lock_enter(), when
+   they have interrupts off.
+
+   [MP] refers to the Intel MultiProcessor Specification, version
+   1.4. */
+
+/* All the CPUs. */
+struct cpu cpus[SMP_MAX_CPUS];
+
+/* Number of CPUs running. */
+int smp_cpu_cnt = 1;
+
+/* True once the kernel lock is in use. */
+bool smp_active;
+
+/* Kernel lock: nonzero while held, by kernel_lock_cpu. */
+static volatile uint32_t kernel_lock;
+static struct cpu *volatile kernel_lock_cpu;
+
+/* MP floating pointer structure.  See [MP] 4.1. */
+struct mp_fp
+  {
+    char signature[4];          /* "_MP_". */
+    uint32_t config;            /* Physical address of struct mp_config. */
+    uint8_t length;             /* Length in 16-byte units. */
+    uint8_t revision;           /* Specification revision. */
+    uint8_t checksum;           /* Makes all bytes sum to 0. */
+    uint8_t features[5];        /* Nonzero features[0]: no mp_config. */
+  }
+PACKED;
+
+/* MP configuration table header.  See [MP] 4.2. */
+struct mp_config
+  {
+    char signature[4];          /* "PCMP". */
+    uint16_t length;            /* Length of header and entries. */
+    uint8_t revision;           /* Specification revision. */
+    uint8_t checksum;           /* Makes all bytes sum to 0. */
+    char oem_product[20];       /* OEM and product ID. */
+    uint32_t oem_table;         /* Physical address of OEM table. */
+    uint16_t oem_length;        /* Length of OEM table. */
+    uint16_t entry_cnt;         /* Number of entries. */
+    uint32_t lapic;             /* Physical address of local APICs. */
+    uint16_t ext_length;        /* Length of extended entries. */
+    uint8_t ext_checksum;       /* Checksum of extended entries. */
+    uint8_t reserved;
+  }
+PACKED;
+
+/* MP configuration table processor entry.  See [MP] 4.3.1.
+   All other entries are 8 bytes long. */
+#define MP_PROC 0               /* Entry type. */
+struct mp_proc
+  {
+    uint8_t type;               /* MP_PROC. */
+    uint8_t apic_id;            /* Local APIC ID. */
+    uint8_t apic_version;       /* Local APIC version. */
+    uint8_t flags;              /* MP_PROC_* flags. */
+    uint32_t signature;         /* CPU signature. */
+    uint32_t features;          /* CPU feature flags. */
+    uint32_t reserved[2];
+  }
+PACKED;
+#define MP_PROC_ENABLED 0x01    /* Usable. */
+#define MP_PROC_BSP 0x02        /* Bootstrap processor. */
+
+static int mp_probe (uintptr_t *lapic_phys, uint8_t ap_ids[]);
+static bool start_ap (struct cpu *, uint8_t apic_id);
+static intr_handler_func resched_interrupt;
+static intr_handler_func tlb_interrupt;
+static void tlb_flush (struct cpu *);
+void smp_ap_main (void) NO_RETURN;
+
+/* Starts up to MAX_CPUS - 1 application processors, if the
+   machine has any, and turns on the kernel lock.  Interrupts
+   must be on, for timing. */
+void
+smp_init (int max_cpus)
+{
+  uint8_t ap_ids[SMP_MAX_CPUS - 1];
+  uintptr_t lapic_phys;
+  int ap_cnt, i;
+
+  ASSERT (intr_get_level () == INTR_ON);
+  ASSERT (smp_cpu_cnt == 1);
+
+  ap_cnt = mp_probe (&lapic_phys, ap_ids);
+  if (ap_cnt == 0 || max_cpus <= 1)
+    return;
+
+  lapic_init (lapic_phys);
+  lapic_timer_calibrate ();
+  cpus[0].apic_id = lapic_id ();
+  intr_register_ext (LAPIC_VEC_RESCHED, resched_interrupt, "Reschedule IPI");
+  intr_register_ext (LAPIC_VEC_TLB, tlb_interrupt, "TLB shootdown IPI");
+
+  /* Install the start-up code, and map the first 4 MB of
+     physical memory at virtual address 0 as well as at
+     PHYS_BASE, for the start-up code's switch to paging. */
+  memcpy (ptov (AP_START_PHYS), ap_start, ap_start_end - ap_start);
+  init_page_dir[0] = init_page_dir[pd_no (PHYS_BASE)];
+  ap_start_cr3 = vtop (init_page_dir);
+
+  /* We are in the kernel, so we hold the kernel lock from now
+     on. */
+  intr_disable ();
+  kernel_lock = 1;
+  kernel_lock_cpu = &cpus[0];
+  smp_active = true;
+  intr_enable ();
+
+  for (i = 0; i < ap_cnt && smp_cpu_cnt < max_cpus; i++)
+    if (!start_ap (&cpus[smp_cpu_cnt], ap_ids[i]))
+      break;
+
+  /* Remove the low mapping and flush it from the TLB. */
+  init_page_dir[0] = 0;
+  asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)) : "memory");
+
+  printf ("SMP: %d CPUs online.\n", smp_cpu_cnt);
+}
+
+/* Starts CPU, whose local APIC has ID APIC_ID, and waits for it
+   to come up.  Returns true if successful, false on failure. */
+static bool
+start_ap (struct cpu *cpu, uint8_t apic_id)
+{
+  struct thread *idle;
+  int64_t start;
+  int i;
+
+  idle = thread_create_idle (cpu);
+  if (idle == NULL)
+    return false;
+  cpu->apic_id = apic_id;
+  ap_start_esp = (uint8_t *) idle + PGSIZE;
+
+  /* The universal start-up algorithm.  See [MP] B.4. */
+  lapic_send_init (apic_id);
+  timer_mdelay (10);
+  for (i = 0; i < 2 && !cpu->started; i++)
+    {
+      lapic_send_startup (apic_id, AP_START_PHYS);
+      timer_udelay (200);
+    }
+
+  start = timer_ticks ();
+  while (!cpu->started && timer_elapsed (start) < TIMER_FREQ / 10)
+    barrier ();
+  if (!cpu->started)
+    {
+      /* Keep the idle thread around, in case the CPU starts
+         after all.  The next CPU would need a new stack, too, so
+         give up on the rest. */
+      printf ("SMP: CPU with APIC ID %d did not start.\n", apic_id);
+      return false;
+    }
+
+  smp_cpu_cnt++;
+  return true;
+}
+
+/* Main program for an application processor, called by
+   ap-start.S.  Runs in the CPU's idle thread, which
+   thread_create_idle() set up. */
+void
+smp_ap_main (void)
+{
+  struct cpu *cpu = thread_current ()->cpu;
+
+  intr_init_ap ();
+#ifdef USERPROG
+  gdt_init_ap (cpu->id);
+#endif
+  lapic_init_ap ();
+  cpu->started = true;
+
+  thread_start_ap ();
+}
+
+/* Interrupts CPU, which must not be the running CPU, to make it
+   reschedule. */
+void
+smp_resched (struct cpu *cpu)
+{
+  ASSERT (smp_active);
+  ASSERT (cpu != thread_current ()->cpu);
+
+  lapic_send_ipi (cpu->apic_id, LAPIC_VEC_RESCHED);
+}
+
+/* Reschedule IPI handler. */
+static void
+resched_interrupt (struct intr_frame *args UNUSED)
+{
+  intr_yield_on_return ();
+}
+
+#ifdef USERPROG
+/* Flushes page directory PD's entries from the TLBs of the other
+   CPUs running a thread that uses PD, and waits until they have
+   done so.  The running CPU must hold the kernel lock and flush
+   its own TLB itself. */
+void
+smp_tlb_shootdown (uint32_t *pd)
+{
+  struct cpu *self;
+  bool sent[SMP_MAX_CPUS];
+  int i;
+
+  if (!smp_active || pd == NULL)
+    return;
+  ASSERT (kernel_lock_held ());
+
+  /* Another CPU's current thread cannot change while we hold the
+     kernel lock, and a CPU whose current thread does not use PD
+     switched away from PD, flushing it, when it last switched
+     threads. */
+  self = thread_current ()->cpu;
+  for (i = 0; i < smp_cpu_cnt; i++)
+    {
+      struct cpu *cpu = &cpus[i];
+      sent[i] = (cpu != self && cpu->current != NULL
+                 && cpu->current->pagedir == pd);
+      if (sent[i])
+        {
+          cpu->tlb_stale = true;
+          lapic_send_ipi (cpu->apic_id, LAPIC_VEC_TLB);
+        }
+    }
+  for (i = 0; i < smp_cpu_cnt; i++)
+    if (sent[i])
+      while (cpus[i].tlb_stale)
+        asm volatile ("pause");
+}
+#endif
+
+/* TLB shootdown IPI handler.  Runs without the kernel lock. */
+static void
+tlb_interrupt (struct intr_frame *args UNUSED)
+{
+  tlb_flush (thread_current ()->cpu);
+}
+
+/* Flushes CPU's TLB if another CPU asked for it.  CPU must be
+   the running CPU. */
+static void
+tlb_flush (struct cpu *cpu)
+{
+  if (cpu->tlb_stale)
+    {
+      uint32_t cr3;
+
+      /* Reloading CR3 flushes the TLB.  See [IA32-v3a] 3.12
+         "Translation Lookaside Buffers (TLBs)". */
+      asm volatile ("movl %%cr3, %0; movl %0, %%cr3"
+                    : "=r" (cr3) : : "memory");
+      cpu->tlb_stale = false;
+    }
+}
+
+/* Makes sure that the running CPU holds the kernel lock,
+   waiting for it if necessary. */
+void
+kernel_lock_enter (void)
+{
+  enum intr_level old_level;
+  struct cpu *cpu;
+
+  if (!smp_active)
+    return;
+
+  old_level = intr_disable ();
+  cpu = thread_current ()->cpu;
+  if (kernel_lock_cpu != cpu)
+    {
+      uint32_t busy = 1;
+
+      for (;;)
+        {
+          asm volatile ("xchgl %0, %1"
+                        : "+r" (busy), "+m" (kernel_lock) : : "memory");
+          if (!busy)
+            break;
+          while (kernel_lock)
+            {
+              tlb_flush (cpu);
+              asm volatile ("pause");
+            }
+          busy = 1;
+        }
+      kernel_lock_cpu = cpu;
+    }
+  intr_set_level (old_level);
+}
+
+/* Releases the kernel lock, which the running CPU must hold,
+   because it is about to leave the kernel.  Interrupts must be
+   off, and stay off until it does. */
+void
+kernel_lock_exit (void)
+{
+  if (!smp_active)
+    return;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (kernel_lock_held ());
+
+  kernel_lock_cpu = NULL;
+  barrier ();
+  kernel_lock = 0;
+}
+
+/* Returns true if the running CPU holds the kernel lock, or if
+   the lock is not in use. */
+bool
+kernel_lock_held (void)
+{
+  enum intr_level old_level;
+  bool held;
+
+  if (!smp_active)
+    return true;
+
+  old_level = intr_disable ();
+  held = kernel_lock_cpu == thread_current ()->cpu;
+  intr_set_level (old_level);
+  return held;
+}
+
+/* Returns the sum of the SIZE bytes at P. */
+static uint8_t
+checksum (const void *p, size_t size)
+{
+  const uint8_t *b = p;
+  uint8_t sum = 0;
+
+  while (size-- > 0)
+    sum += *b++;
+  return sum;
+}
+
+/* Looks for an MP floating pointer structure in the SIZE bytes
+   of physical memory starting at PHYS.  Returns it if found,
+   otherwise a null pointer. */
+static struct mp_fp *
+mp_search (uintptr_t phys, size_t size)
+{
+  uintptr_t p;
+
+  if (phys == 0 || phys + size > init_ram_pages * PGSIZE)
+    return NULL;
+  for (p = phys; p + sizeof (struct mp_fp) <= phys + size; p += 16)
+    {
+      struct mp_fp *fp = ptov (p);
+      if (!memcmp (fp->signature, "_MP_", 4)
+          && checksum (fp, fp->length * 16) == 0)
+        return fp;
+    }
+  return NULL;
+}
+
+/* Finds the CPUs described in the MP configuration table.
+   Stores the local APICs' physical address into *LAPIC_PHYS and
+   the local APIC IDs of the usable application processors, up
+   to SMP_MAX_CPUS - 1 of them, into AP_IDS[].  Returns the number
+   of application processors found, which is 0 if there is no
+   usable MP configuration table. */
+static int
+mp_probe (uintptr_t *lapic_phys, uint8_t ap_ids[])
+{
+  struct mp_fp *fp;
+  struct mp_config *config;
+  uint8_t *entry, *end;
+  int ap_cnt = 0;
+  int i;
+
+  /* Search the first kB of the extended BIOS data area, the last
+     kB of base memory, and the BIOS ROM.  See [MP] 4. */
+  fp = mp_search (*(uint16_t *) ptov (0x40e) << 4, 1024);
+  if (fp == NULL)
+    fp = mp_search (*(uint16_t *) ptov (0x413) * 1024 - 1024, 1024);
+  if (fp == NULL)
+    fp = mp_search (0xf0000, 0x10000);
+  if (fp == NULL || fp->config == 0 || fp->features[0] != 0)
+    return 0;
+
+  if (fp->config + sizeof *config > init_ram_pages * PGSIZE)
+    return 0;
+  config = ptov (fp->config);
+  if (memcmp (config->signature, "PCMP", 4)
+      || fp->config + config->length > init_ram_pages * PGSIZE
+      || checksum (config, config->length) != 0)
+    return 0;
+  *lapic_phys = config->lapic;
+
+  entry = (uint8_t *) (config + 1);
+  end = (uint8_t *) config + config->length;
+  for (i = 0; i < config->entry_cnt && entry < end; i++)
+    if (*entry == MP_PROC)
+      {
+        struct mp_proc *proc = (struct mp_proc *) entry;
+        if ((proc->flags & MP_PROC_ENABLED)
+            && !(proc->flags & MP_PROC_BSP)
+            && ap_cnt < SMP_MAX_CPUS - 1)
+          ap_ids[ap_cnt++] = proc->apic_id;
+        entry += sizeof *proc;
+      }
+    else
+      entry += 8;
+
+  return ap_cnt;
+}
@@ -0,0 +1,69 @@
+#ifndef THREADS_SMP_H
+#define THREADS_SMP_H
+
+#include <heap.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/thread.h"
+
+/* Maximum number of CPUs. */
+#define SMP_MAX_CPUS 8
+
+/* A CPU.
+
+   CPU 0 is the bootstrap processor (BSP), the one that runs
+   init.c:main().  The others, the application processors (APs),
+   are started by smp_init().
+
+   Each CPU schedules threads from its own run queue, which has
+   one FIFO list per priority of threads in THREAD_READY state.
+   Bit P of ready_bitmap is set if and only if ready_queues[P] is
+   nonempty.  A CPU whose run queue offers nothing better than it
+   could find elsewhere steals a thread from another CPU's run
+   queue.  Threads in the deadline class wait apart, in
+   deadline_queue, and run before all the others.  Under the
+   stride scheduler, the other threads wait in stride_heap
+   instead of ready_queues[], ordered by pass.  See thread.c for
+   details. */
+struct cpu
+  {
+    int id;                             /* Index in cpus[]. */
+    uint8_t apic_id;                    /* Local APIC ID. */
+    volatile bool started;              /* Set by an AP once it is up. */
+    volatile bool tlb_stale;            /* Must flush its TLB. */
+
+    /* Owned by thread.c. */
+    struct thread *idle_thread;         /* This CPU's idle thread. */
+    struct thread *current;             /* Thread running on this CPU. */
+    struct list ready_queues[PRI_MAX + 1]; /* Run queue, by priority. */
+    uint64_t ready_bitmap;              /* Nonempty ready_queues[]. */
+    struct list deadline_queue;         /* Deadline threads, by deadline. */
+    struct heap stride_heap;            /* Stride run queue, by pass. */
+    int64_t stride_pass;                /* Pass of last thread from heap. */
+    int ready_cnt;                      /* Number of threads in run queue. */
+    unsigned thread_ticks;              /* # of timer ticks since last yield. */
+    long long idle_ticks;               /* # of timer ticks spent idle. */
+    unsigned steal_cnt;                 /* # of threads stolen from others. */
+  };
+
+/* All the CPUs, of which the first smp_cpu_cnt are running. */
+extern struct cpu cpus[SMP_MAX_CPUS];
+extern int smp_cpu_cnt;
+
+/* True once application processors have been started, so that
+   the kernel lock is in use. */
+extern bool smp_active;
+
+void smp_init (int max_cpus);
+void smp_resched (struct cpu *);
+#ifdef USERPROG
+void smp_tlb_shootdown (uint32_t *pd);
+#endif
+
+/* Kernel lock.  See smp.c. */
+void kernel_lock_enter (void);
+void kernel_lock_exit (void);
+bool kernel_lock_held (void);
+
+#endif /* threads/smp.h */
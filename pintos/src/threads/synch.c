@@ -27,10 +27,72 @@
 */
 
 #include "threads/synch.h"
+#include <inttypes.h>
+#include <lockstat.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Maximum length of a chain of nested priority donations,
+   e.g. H waits on a lock held by M, which waits on a lock held
+   by L.  Bounds the time spent donating with interrupts off. */
+#define DONATION_DEPTH_MAX 8
+
+/* Deadline for a wait that never times out. */
+#define NO_DEADLINE INT64_MAX
+
+static list_less_func thread_priority_less;
+static bool sema_wait (struct semaphore *, int64_t deadline);
+static bool lock_wait (struct lock *, int64_t deadline);
+static void donate_priority (struct lock *, int priority);
+static void withdraw_donation (struct lock *);
+static int waiters_max_priority (struct list *waiters);
+static void lock_record_wait (struct lock *, int64_t ticks);
+
+/* Maximum number of lock classes.  Locks and semaphores
+   initialized after all are in use get no statistics. */
+#define LOCK_CLASS_MAX 128
+
+/* Statistics for the locks and semaphores of one name. */
+struct lock_class
+  {
+    const char *name;           /* Name given at initialization. */
+    bool is_lock;               /* Lock, as opposed to semaphore? */
+    uint64_t acquire_cnt;       /* Number of acquisitions. */
+    uint64_t contend_cnt;       /* Acquisitions that had to wait. */
+    uint64_t wait_total;        /* Total wait, in TSC cycles. */
+    uint64_t wait_max;          /* Longest wait, in TSC cycles. */
+    uint64_t hold_total;        /* Total hold, in TSC cycles. */
+    uint64_t hold_max;          /* Longest hold, in TSC cycles. */
+  };
+
+/* True to keep lock statistics.
+   Controlled by kernel command-line option "-lockstat". */
+bool lockstat_enabled;
+
+/* Lock classes in order of creation. */
+static struct lock_class lock_classes[LOCK_CLASS_MAX];
+static int lock_class_cnt;
+
+/* Number of locks and semaphores left out because
+   lock_classes[] was full. */
+static unsigned lock_class_overflows;
+
+static struct lock_class *lock_class_get (const char *name, bool is_lock);
+static void lock_class_acquired (struct lock_class *, bool contended,
+                                 uint64_t wait);
+static void lock_class_released (struct lock_class *, uint64_t hold);
+
+/* Returns the time stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -40,14 +102,18 @@
      decrement it.
 
    - up or "V": increment the value (and wake up one waiting
-     thread, if any). */
+     thread, if any).
+
+   NAME selects the semaphore's lockstat class.  The sema_init()
+   macro passes the text of its SEMA argument. */
 void
-sema_init (struct semaphore *sema, unsigned value)
+sema_init_named (struct semaphore *sema, unsigned value, const char *name)
 {
   ASSERT (sema != NULL);
 
   sema->value = value;
   list_init (&sema->waiters);
+  sema->class = lock_class_get (name, false);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -66,13 +132,69 @@ sema_down (struct semaphore *sema)
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
+  sema_wait (sema, NO_DEADLINE);
+  intr_set_level (old_level);
+}
+
+/* Down or "P" operation on a semaphore, giving up after TICKS
+   timer ticks.  Returns true if the semaphore is decremented,
+   false if the time ran out first.  If TICKS is 0 or less, this
+   is the same as sema_try_down().
+
+   The wait is bounded by the timer interrupt, which wakes up the
+   thread at its deadline, so it costs no polling.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler.  This function may be called with
+   interrupts disabled, but if it sleeps then the next scheduled
+   thread will probably turn interrupts back on. */
+bool
+sema_down_timeout (struct semaphore *sema, int64_t ticks)
+{
+  enum intr_level old_level;
+  bool success;
+
+  ASSERT (sema != NULL);
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable ();
+  success = sema_wait (sema, timer_ticks () + ticks);
+  intr_set_level (old_level);
+
+  return success;
+}
+
+/* Waits for SEMA's value to become positive and then atomically
+   decrements it, unless timer_ticks() reaches DEADLINE first.
+   DEADLINE may be NO_DEADLINE to wait as long as it takes.
+   Returns true if SEMA is decremented, false if the deadline
+   passed.  Interrupts must be off. */
+static bool
+sema_wait (struct semaphore *sema, int64_t deadline)
+{
+  bool contended;
+  uint64_t wait_start = 0;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  contended = sema->value == 0;
+  if (contended && sema->class != NULL)
+    wait_start = rdtsc ();
   while (sema->value == 0)
     {
+      if (deadline != NO_DEADLINE && timer_ticks () >= deadline)
+        return false;
       list_push_back (&sema->waiters, &thread_current ()->elem);
-      thread_block ();
+      if (deadline != NO_DEADLINE)
+        timer_block_until (deadline);
+      else
+        thread_block ();
     }
   sema->value--;
-  intr_set_level (old_level);
+  if (sema->class != NULL)
+    lock_class_acquired (sema->class, contended,
+                         contended ? rdtsc () - wait_start : 0);
+  return true;
 }
 
 /* Down or "P" operation on a semaphore, but only if the
@@ -102,7 +224,10 @@ sema_try_down (struct semaphore *sema)
 }
 
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
-   and wakes up one thread of those waiting for SEMA, if any.
+   and wakes up the highest-priority thread of those waiting for
+   SEMA, if any, preempting the running thread if the woken
+   thread has a higher priority.  Waiters of equal priority are
+   woken in FIFO order.
 
    This function may be called from an interrupt handler. */
 void
@@ -114,10 +239,46 @@ sema_up (struct semaphore *sema)
 
   old_level = intr_disable ();
   if (!list_empty (&sema->waiters))
-    thread_unblock (list_entry (list_pop_front (&sema->waiters),
-                                struct thread, elem));
+    {
+      /* Waiters' priorities may have changed through donation
+         since they went to sleep, so find the maximum now
+         instead of keeping the list sorted. */
+      struct list_elem *e = list_max (&sema->waiters,
+                                      thread_priority_less, NULL);
+      list_remove (e);
+      thread_unblock (list_entry (e, struct thread, elem));
+    }
   sema->value++;
   intr_set_level (old_level);
+
+  thread_preempt ();
+}
+
+/* Returns true if the thread that owns list element A (by its
+   `elem' member) has lower priority than the one that owns B. */
+static bool
+thread_priority_less (const struct list_elem *a, const struct list_elem *b,
+                      void *aux UNUSED)
+{
+  return (list_entry (a, struct thread, elem)->priority
+          < list_entry (b, struct thread, elem)->priority);
+}
+
+/* Returns the highest priority of the threads in WAITERS, a
+   semaphore's wait list, or PRI_MIN if it is empty. */
+static int
+waiters_max_priority (struct list *waiters)
+{
+  struct list_elem *e;
+  int priority = PRI_MIN;
+
+  for (e = list_begin (waiters); e != list_end (waiters); e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, elem);
+      if (t->priority > priority)
+        priority = t->priority;
+    }
+  return priority;
 }
 
 static void sema_test_helper (void *sema_);
@@ -171,19 +332,33 @@ sema_test_helper (void *sema_)
    another one "up" it, but with a lock the same thread must both
    acquire and release it.  When these restrictions prove
    onerous, it's a good sign that a semaphore should be used,
-   instead of a lock. */
+   instead of a lock.
+
+   Unlike a semaphore, a lock has an owner, so a thread waiting
+   for a lock donates its priority to the holder, and through
+   the holder to the holder of any lock that it is waiting for in
+   turn, up to DONATION_DEPTH_MAX levels deep.  The donation lasts
+   until the holder releases the lock.
+
+   NAME selects the lock's lockstat class.  The lock_init() macro
+   passes the text of its LOCK argument. */
 void
-lock_init (struct lock *lock)
+lock_init_named (struct lock *lock, const char *name)
 {
   ASSERT (lock != NULL);
 
   lock->holder = NULL;
-  sema_init (&lock->semaphore, 1);
+  sema_init_named (&lock->semaphore, 1, NULL);
+  lock->max_priority = PRI_MIN;
+  memset (lock->wait_hist, 0, sizeof lock->wait_hist);
+  lock->class = lock_class_get (name, true);
+  lock->acquire_tsc = 0;
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
    necessary.  The lock must not already be held by the current
-   thread.
+   thread.  While sleeping, donates the current thread's priority
+   to the holder of LOCK.
 
    This function may sleep, so it must not be called within an
    interrupt handler.  This function may be called with
@@ -192,12 +367,77 @@ lock_init (struct lock *lock)
 void
 lock_acquire (struct lock *lock)
 {
+  lock_wait (lock, NO_DEADLINE);
+}
+
+/* Acquires LOCK, as lock_acquire(), but gives up after TICKS
+   timer ticks.  Returns true if LOCK was acquired, false if the
+   time ran out first.  A thread that gives up withdraws the
+   priority that it donated while waiting.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler.  This function may be called with
+   interrupts disabled, but interrupts will be turned back on if
+   we need to sleep. */
+bool
+lock_acquire_timeout (struct lock *lock, int64_t ticks)
+{
+  return lock_wait (lock, timer_ticks () + ticks);
+}
+
+/* Acquires LOCK, unless timer_ticks() reaches DEADLINE first, for
+   lock_acquire() and lock_acquire_timeout().  Returns true if
+   successful, false if the deadline passed. */
+static bool
+lock_wait (struct lock *lock, int64_t deadline)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  int64_t wait_start = -1;
+  bool contended;
+  uint64_t wait_tsc = 0;
+
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
 
-  sema_down (&lock->semaphore);
-  lock->holder = thread_current ();
+  old_level = intr_disable ();
+  contended = lock->holder != NULL;
+  if (contended)
+    {
+      cur->waiting_lock = lock;
+      donate_priority (lock, cur->priority);
+      if (cur->priority > PRI_DEFAULT)
+        wait_start = timer_ticks ();
+      if (lock->class != NULL)
+        wait_tsc = rdtsc ();
+    }
+
+  if (!sema_wait (&lock->semaphore, deadline))
+    {
+      cur->waiting_lock = NULL;
+      withdraw_donation (lock);
+      intr_set_level (old_level);
+      return false;
+    }
+
+  cur->waiting_lock = NULL;
+  if (wait_start >= 0)
+    lock_record_wait (lock, timer_elapsed (wait_start));
+  if (lock->class != NULL)
+    {
+      lock->acquire_tsc = rdtsc ();
+      lock_class_acquired (lock->class, contended,
+                           contended ? lock->acquire_tsc - wait_tsc : 0);
+    }
+  lock->holder = cur;
+  list_push_back (&cur->held_locks, &lock->elem);
+
+  /* Threads still waiting now donate to us. */
+  lock->max_priority = waiters_max_priority (&lock->semaphore.waiters);
+  thread_refresh_priority (cur);
+  intr_set_level (old_level);
+  return true;
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -209,18 +449,35 @@ lock_acquire (struct lock *lock)
 bool
 lock_try_acquire (struct lock *lock)
 {
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
   bool success;
 
   ASSERT (lock != NULL);
   ASSERT (!lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
   success = sema_try_down (&lock->semaphore);
   if (success)
-    lock->holder = thread_current ();
+    {
+      if (lock->class != NULL)
+        {
+          lock->acquire_tsc = rdtsc ();
+          lock_class_acquired (lock->class, false, 0);
+        }
+      lock->holder = cur;
+      list_push_back (&cur->held_locks, &lock->elem);
+      lock->max_priority = waiters_max_priority (&lock->semaphore.waiters);
+      thread_refresh_priority (cur);
+    }
+  intr_set_level (old_level);
   return success;
 }
 
 /* Releases LOCK, which must be owned by the current thread.
+   Gives up any priority donated through LOCK and yields at once
+   if a waiter, or any other ready thread, now has a higher
+   priority than the current thread.
 
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to release a lock within an interrupt
@@ -228,11 +485,23 @@ lock_try_acquire (struct lock *lock)
 void
 lock_release (struct lock *lock)
 {
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
+  if (lock->class != NULL)
+    lock_class_released (lock->class, rdtsc () - lock->acquire_tsc);
   lock->holder = NULL;
+  list_remove (&lock->elem);
+  lock->max_priority = PRI_MIN;
+  thread_refresh_priority (cur);
   sema_up (&lock->semaphore);
+  intr_set_level (old_level);
+
+  thread_preempt ();
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -246,13 +515,764 @@ lock_held_by_current_thread (const struct lock *lock)
   return lock->holder == thread_current ();
 }
 
+/* Donates PRIORITY to the holder of LOCK, and onward along the
+   chain of locks that each holder is itself waiting for.
+   Interrupts must be off. */
+static void
+donate_priority (struct lock *lock, int priority)
+{
+  int depth;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (thread_mlfqs)
+    return;
+
+  for (depth = 0; lock != NULL && depth < DONATION_DEPTH_MAX; depth++)
+    {
+      struct thread *holder = lock->holder;
+
+      if (lock->max_priority >= priority)
+        break;
+      lock->max_priority = priority;
+      if (holder == NULL || holder->priority >= priority)
+        break;
+      thread_refresh_priority (holder);
+      lock = holder->waiting_lock;
+    }
+}
+
+/* Recomputes the priority donated through LOCK, and onward along
+   the chain of locks that each holder is itself waiting for,
+   after a waiter has stopped waiting for LOCK without acquiring
+   it.  Interrupts must be off. */
+static void
+withdraw_donation (struct lock *lock)
+{
+  int depth;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (thread_mlfqs)
+    return;
+
+  for (depth = 0; lock != NULL && depth < DONATION_DEPTH_MAX; depth++)
+    {
+      struct thread *holder = lock->holder;
+      int old_priority;
+
+      lock->max_priority = waiters_max_priority (&lock->semaphore.waiters);
+      if (holder == NULL)
+        break;
+      old_priority = holder->priority;
+      thread_refresh_priority (holder);
+      if (holder->priority == old_priority)
+        break;
+      lock = holder->waiting_lock;
+    }
+}
+
+/* Adds a wait of TICKS ticks to LOCK's wait-time histogram. */
+static void
+lock_record_wait (struct lock *lock, int64_t ticks)
+{
+  int bucket = 0;
+
+  while (ticks > 0 && bucket < LOCK_WAIT_BUCKETS - 1)
+    {
+      ticks >>= 1;
+      bucket++;
+    }
+  lock->wait_hist[bucket]++;
+}
+
+/* Prints LOCK's wait-time histogram under the given NAME. */
+void
+lock_print_wait_hist (const struct lock *lock, const char *name)
+{
+  int bucket;
+
+  printf ("Lock %s: waits above priority %d:", name, PRI_DEFAULT);
+  for (bucket = 0; bucket < LOCK_WAIT_BUCKETS; bucket++)
+    {
+      int lo = bucket == 0 ? 0 : 1 << (bucket - 1);
+      int hi = (1 << bucket) - 1;
+
+      if (bucket == 0)
+        printf (" <1 tick: %u", lock->wait_hist[bucket]);
+      else if (bucket == LOCK_WAIT_BUCKETS - 1)
+        printf (", %d+ ticks: %u", lo, lock->wait_hist[bucket]);
+      else if (lo == hi)
+        printf (", %d tick: %u", lo, lock->wait_hist[bucket]);
+      else
+        printf (", %d-%d ticks: %u", lo, hi, lock->wait_hist[bucket]);
+    }
+  printf ("\n");
+}
+
+/* Returns the lock class named NAME, creating it if necessary,
+   or a null pointer if lockstat is disabled, NAME is null, or
+   there is no room for another class. */
+static struct lock_class *
+lock_class_get (const char *name, bool is_lock)
+{
+  struct lock_class *class = NULL;
+  enum intr_level old_level;
+  int i;
+
+  if (!lockstat_enabled || name == NULL)
+    return NULL;
+
+  old_level = intr_disable ();
+  for (i = 0; i < lock_class_cnt; i++)
+    if (lock_classes[i].is_lock == is_lock
+        && (lock_classes[i].name == name
+            || !strcmp (lock_classes[i].name, name)))
+      {
+        class = &lock_classes[i];
+        break;
+      }
+  if (class == NULL)
+    {
+      if (lock_class_cnt < LOCK_CLASS_MAX)
+        {
+          class = &lock_classes[lock_class_cnt++];
+          class->name = name;
+          class->is_lock = is_lock;
+        }
+      else
+        lock_class_overflows++;
+    }
+  intr_set_level (old_level);
+  return class;
+}
+
+/* Records an acquisition in CLASS, which waited WAIT cycles if
+   CONTENDED.  Interrupts must be off. */
+static void
+lock_class_acquired (struct lock_class *class, bool contended,
+                     uint64_t wait)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  class->acquire_cnt++;
+  if (contended)
+    {
+      class->contend_cnt++;
+      class->wait_total += wait;
+      if (wait > class->wait_max)
+        class->wait_max = wait;
+    }
+}
+
+/* Records in CLASS that a lock was held for HOLD cycles.
+   Interrupts must be off. */
+static void
+lock_class_released (struct lock_class *class, uint64_t hold)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  class->hold_total += hold;
+  if (hold > class->hold_max)
+    class->hold_max = hold;
+}
+
+/* Returns CLASS's name without the leading `&' that lock_init()
+   and sema_init() usually pick up. */
+static const char *
+lock_class_name (const struct lock_class *class)
+{
+  return class->name[0] == '&' ? class->name + 1 : class->name;
+}
+
+/* Prints the lock classes that have had contention, most total
+   wait first, if lockstat is enabled. */
+void
+lockstat_print (void)
+{
+  bool printed[LOCK_CLASS_MAX];
+  unsigned quiet_cnt = 0;
+  int i;
+
+  if (!lockstat_enabled)
+    return;
+
+  memset (printed, 0, sizeof printed);
+  for (;;)
+    {
+      struct lock_class *max = NULL;
+
+      for (i = 0; i < lock_class_cnt; i++)
+        if (!printed[i] && lock_classes[i].contend_cnt > 0
+            && (max == NULL || lock_classes[i].wait_total > max->wait_total))
+          max = &lock_classes[i];
+      if (max == NULL)
+        break;
+      printed[max - lock_classes] = true;
+
+      printf ("Lockstat: %s %s: %"PRIu64" acquired, %"PRIu64" contended, "
+              "wait %"PRIu64"/%"PRIu64, max->is_lock ? "lock" : "sema",
+              lock_class_name (max), max->acquire_cnt, max->contend_cnt,
+              max->wait_total, max->wait_max);
+      if (max->is_lock)
+        printf (", hold %"PRIu64"/%"PRIu64, max->hold_total, max->hold_max);
+      printf (" cycles (total/max)\n");
+    }
+
+  for (i = 0; i < lock_class_cnt; i++)
+    if (!printed[i])
+      quiet_cnt++;
+  printf ("Lockstat: %d classes, %u without contention, %u not tracked\n",
+          lock_class_cnt, quiet_cnt, lock_class_overflows);
+}
+
+/* Copies the statistics of up to MAX lock classes, in order of
+   creation, into STATS, and returns the number copied.  STATS
+   may be in user memory, so it is only touched with interrupts
+   on. */
+int
+lockstat_get (struct lockstat *stats, int max)
+{
+  int i;
+
+  for (i = 0; i < max && i < lock_class_cnt; i++)
+    {
+      const struct lock_class *class = &lock_classes[i];
+      struct lockstat s;
+      enum intr_level old_level;
+
+      old_level = intr_disable ();
+      strlcpy (s.name, lock_class_name (class), sizeof s.name);
+      s.acquire_cnt = class->acquire_cnt;
+      s.contend_cnt = class->contend_cnt;
+      s.wait_total = class->wait_total;
+      s.wait_max = class->wait_max;
+      s.hold_total = class->hold_total;
+      s.hold_max = class->hold_max;
+      intr_set_level (old_level);
+
+      memcpy (&stats[i], &s, sizeof s);
+    }
+  return i;
+}
+
+/* A thread waiting on a readers-writer lock. */
+struct rw_waiter
+  {
+    struct list_elem elem;              /* List element. */
+    struct thread *thread;              /* Waiting thread. */
+    bool writer;                        /* Waiting to write? */
+  };
+
+static void rw_wait (struct rwlock *, bool writer);
+static void rw_wake (struct rwlock *);
+static void rw_hold (struct rwlock *, struct thread *);
+static void rw_unhold (struct rwlock *, struct thread *);
+static void rw_donate (struct rwlock *, int priority);
+static void rw_update_donation (struct rwlock *);
+static list_less_func rw_waiter_priority_less;
+
+/* Initializes RWLOCK, which no thread holds initially.  If
+   PREFER_WRITERS is true, readers wait while any writer is
+   waiting, otherwise only while a writer holds the lock.  NAME
+   is RWLOCK's lockstat class, or null for none. */
+void
+rw_init_named (struct rwlock *rwlock, bool prefer_writers, const char *name)
+{
+  ASSERT (rwlock != NULL);
+
+  rwlock->readers = 0;
+  rwlock->writer = NULL;
+  rwlock->waiting_writers = 0;
+  rwlock->prefer_writers = prefer_writers;
+  list_init (&rwlock->waiters);
+  list_init (&rwlock->holders);
+  rwlock->max_priority = PRI_MIN;
+  rwlock->class = lock_class_get (name, true);
+  rwlock->acquire_tsc = 0;
+}
+
+/* Acquires RWLOCK for reading, sleeping until no writer holds it
+   and, with writer preference, no writer is waiting for it.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rw_read_acquire (struct rwlock *rwlock)
+{
+  enum intr_level old_level;
+  bool contended;
+  uint64_t wait_tsc = 0;
+
+  ASSERT (rwlock != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (rwlock->writer != thread_current ());
+
+  old_level = intr_disable ();
+  contended = !(rwlock->writer == NULL
+                && !(rwlock->prefer_writers && rwlock->waiting_writers > 0));
+  if (!contended)
+    {
+      rwlock->readers++;
+      rw_hold (rwlock, thread_current ());
+    }
+  else
+    {
+      if (rwlock->class != NULL)
+        wait_tsc = rdtsc ();
+      rw_wait (rwlock, false);
+    }
+  if (rwlock->class != NULL)
+    lock_class_acquired (rwlock->class, contended,
+                         contended ? rdtsc () - wait_tsc : 0);
+  intr_set_level (old_level);
+}
+
+/* Releases RWLOCK, which the current thread must hold for
+   reading. */
+void
+rw_read_release (struct rwlock *rwlock)
+{
+  enum intr_level old_level;
+
+  ASSERT (rwlock != NULL);
+
+  old_level = intr_disable ();
+  ASSERT (rwlock->readers > 0);
+  rw_unhold (rwlock, thread_current ());
+  if (--rwlock->readers == 0)
+    rw_wake (rwlock);
+  intr_set_level (old_level);
+
+  thread_preempt ();
+}
+
+/* Acquires RWLOCK for writing, sleeping until no other thread
+   holds it.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rw_write_acquire (struct rwlock *rwlock)
+{
+  enum intr_level old_level;
+  bool contended;
+  uint64_t wait_tsc = 0;
+
+  ASSERT (rwlock != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (rwlock->writer != thread_current ());
+
+  old_level = intr_disable ();
+  contended = !(rwlock->writer == NULL && rwlock->readers == 0);
+  if (!contended)
+    {
+      rwlock->writer = thread_current ();
+      rw_hold (rwlock, rwlock->writer);
+    }
+  else
+    {
+      if (rwlock->class != NULL)
+        wait_tsc = rdtsc ();
+      rw_wait (rwlock, true);
+    }
+  if (rwlock->class != NULL)
+    {
+      rwlock->acquire_tsc = rdtsc ();
+      lock_class_acquired (rwlock->class, contended,
+                           contended ? rwlock->acquire_tsc - wait_tsc : 0);
+    }
+  intr_set_level (old_level);
+}
+
+/* Releases RWLOCK, which the current thread must hold for
+   writing. */
+void
+rw_write_release (struct rwlock *rwlock)
+{
+  enum intr_level old_level;
+
+  ASSERT (rwlock != NULL);
+  ASSERT (rw_write_held_by_current_thread (rwlock));
+
+  old_level = intr_disable ();
+  if (rwlock->class != NULL)
+    lock_class_released (rwlock->class, rdtsc () - rwlock->acquire_tsc);
+  rw_unhold (rwlock, rwlock->writer);
+  rwlock->writer = NULL;
+  rw_wake (rwlock);
+  intr_set_level (old_level);
+
+  thread_preempt ();
+}
+
+/* Returns true if the current thread holds RWLOCK for writing,
+   false otherwise. */
+bool
+rw_write_held_by_current_thread (const struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  return rwlock->writer == thread_current ();
+}
+
+/* Sleeps until RWLOCK is handed to the current thread, for
+   writing if WRITER is true, otherwise for reading, donating the
+   current thread's priority to RWLOCK's holders meanwhile.
+   Interrupts must be off. */
+static void
+rw_wait (struct rwlock *rwlock, bool writer)
+{
+  struct rw_waiter waiter;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  waiter.thread = thread_current ();
+  waiter.writer = writer;
+  list_push_back (&rwlock->waiters, &waiter.elem);
+  if (writer)
+    rwlock->waiting_writers++;
+  rw_donate (rwlock, waiter.thread->priority);
+  thread_block ();
+}
+
+/* Hands RWLOCK to as many waiters as may now hold it, in order
+   of priority: either the highest-priority waiter, if it is a
+   writer and RWLOCK is free, or readers.  With writer
+   preference, readers are admitted only until the next waiter in
+   priority order is a writer.  Interrupts must be off. */
+static void
+rw_wake (struct rwlock *rwlock)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (rwlock->writer == NULL && !list_empty (&rwlock->waiters))
+    {
+      /* Waiters' priorities may have changed through donation
+         since they went to sleep, so find the maximum now
+         instead of keeping the list sorted. */
+      struct list_elem *e = list_max (&rwlock->waiters,
+                                      rw_waiter_priority_less, NULL);
+      struct rw_waiter *w = list_entry (e, struct rw_waiter, elem);
+
+      if (w->writer)
+        {
+          if (rwlock->readers > 0)
+            break;
+          rwlock->writer = w->thread;
+          rwlock->waiting_writers--;
+          rw_hold (rwlock, w->thread);
+        }
+      else if (!rwlock->prefer_writers)
+        {
+          /* Without writer preference, readers need not wait for
+             waiting writers, so admit all of them at once. */
+          for (e = list_begin (&rwlock->waiters);
+               e != list_end (&rwlock->waiters); )
+            {
+              w = list_entry (e, struct rw_waiter, elem);
+              e = list_next (e);
+              if (!w->writer)
+                {
+                  rwlock->readers++;
+                  list_remove (&w->elem);
+                  rw_hold (rwlock, w->thread);
+                  thread_unblock (w->thread);
+                }
+            }
+          break;
+        }
+      else
+        {
+          rwlock->readers++;
+          rw_hold (rwlock, w->thread);
+        }
+      list_remove (e);
+      thread_unblock (w->thread);
+    }
+  rw_update_donation (rwlock);
+}
+
+/* Records that thread T now holds RWLOCK, so that RWLOCK's
+   waiters donate to it, unless T already records RW_HOLD_MAX
+   holds.  Interrupts must be off. */
+static void
+rw_hold (struct rwlock *rwlock, struct thread *t)
+{
+  int i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (i = 0; i < RW_HOLD_MAX; i++)
+    {
+      struct rw_hold *h = &t->rw_holds[i];
+      if (h->rwlock == NULL)
+        {
+          h->rwlock = rwlock;
+          h->thread = t;
+          list_push_back (&rwlock->holders, &h->elem);
+          thread_refresh_priority (t);
+          return;
+        }
+    }
+}
+
+/* Forgets thread T's hold on RWLOCK, if recorded, and gives up
+   the priority donated through it.  Interrupts must be off. */
+static void
+rw_unhold (struct rwlock *rwlock, struct thread *t)
+{
+  int i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (i = 0; i < RW_HOLD_MAX; i++)
+    {
+      struct rw_hold *h = &t->rw_holds[i];
+      if (h->rwlock == rwlock)
+        {
+          list_remove (&h->elem);
+          h->rwlock = NULL;
+          thread_refresh_priority (t);
+          return;
+        }
+    }
+}
+
+/* Donates PRIORITY to every recorded holder of RWLOCK, and
+   onward along the chain of locks that a holder is waiting for.
+   Interrupts must be off. */
+static void
+rw_donate (struct rwlock *rwlock, int priority)
+{
+  struct list_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (thread_mlfqs || rwlock->max_priority >= priority)
+    return;
+  rwlock->max_priority = priority;
+  for (e = list_begin (&rwlock->holders); e != list_end (&rwlock->holders);
+       e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct rw_hold, elem)->thread;
+      if (t->priority < priority)
+        {
+          thread_refresh_priority (t);
+          if (t->waiting_lock != NULL)
+            donate_priority (t->waiting_lock, priority);
+        }
+    }
+}
+
+/* Recomputes the priority donated through RWLOCK after its
+   waiters have changed, and refreshes its holders to match.
+   Interrupts must be off. */
+static void
+rw_update_donation (struct rwlock *rwlock)
+{
+  struct list_elem *e;
+  int priority = PRI_MIN;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (e = list_begin (&rwlock->waiters); e != list_end (&rwlock->waiters);
+       e = list_next (e))
+    {
+      struct rw_waiter *w = list_entry (e, struct rw_waiter, elem);
+      if (w->thread->priority > priority)
+        priority = w->thread->priority;
+    }
+  rwlock->max_priority = priority;
+  for (e = list_begin (&rwlock->holders); e != list_end (&rwlock->holders);
+       e = list_next (e))
+    thread_refresh_priority (list_entry (e, struct rw_hold, elem)->thread);
+}
+
+/* Compares the priorities of the threads waiting in rw_waiters A
+   and B. */
+static bool
+rw_waiter_priority_less (const struct list_elem *a,
+                         const struct list_elem *b, void *aux UNUSED)
+{
+  return (list_entry (a, struct rw_waiter, elem)->thread->priority
+          < list_entry (b, struct rw_waiter, elem)->thread->priority);
+}
+
+/* Initializes LOCK, naming it NAME for debugging purposes.  No
+   thread holds it initially. */
+void
+spin_init (struct spinlock *lock, const char *name)
+{
+  ASSERT (lock != NULL);
+
+  lock->next = lock->serving = 0;
+  lock->holder = NULL;
+  lock->name = name;
+  lock->class = lock_class_get (name, true);
+  lock->class_tsc = 0;
+#ifdef SPINLOCK_DEBUG
+  lock->acquire_cnt = lock->contend_cnt = 0;
+  lock->acquire_tsc = lock->max_hold = 0;
+#endif
+}
+
+/* Acquires LOCK, spinning until it becomes available if
+   necessary.  The lock must not already be held by the current
+   thread.
+
+   Interrupts must be off, and must stay off until the lock is
+   released.  This function may be called from an interrupt
+   handler. */
+void
+spin_lock (struct spinlock *lock)
+{
+  uint16_t ticket = 1;
+  bool contended;
+  uint64_t wait_tsc = 0;
+
+  ASSERT (lock != NULL);
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (!spin_held_by_current_thread (lock));
+
+  asm volatile ("lock xaddw %0, %1"
+                : "+r" (ticket), "+m" (lock->next) : : "memory");
+  contended = lock->serving != ticket;
+#ifdef SPINLOCK_DEBUG
+  if (contended)
+    lock->contend_cnt++;
+#endif
+  if (contended && lock->class != NULL)
+    wait_tsc = rdtsc ();
+  while (lock->serving != ticket)
+    asm volatile ("pause" : : : "memory");
+  lock->holder = thread_current ();
+  if (lock->class != NULL)
+    {
+      lock->class_tsc = rdtsc ();
+      lock_class_acquired (lock->class, contended,
+                           contended ? lock->class_tsc - wait_tsc : 0);
+    }
+#ifdef SPINLOCK_DEBUG
+  lock->acquire_cnt++;
+  lock->acquire_tsc = rdtsc ();
+#endif
+}
+
+/* Tries to acquire LOCK and returns true if successful or false
+   on failure.  The lock must not already be held by the current
+   thread.  Interrupts must be off, as for spin_lock(). */
+bool
+spin_trylock (struct spinlock *lock)
+{
+  uint16_t ticket;
+  bool success;
+
+  ASSERT (lock != NULL);
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (!spin_held_by_current_thread (lock));
+
+  /* Take a ticket only if it would be served right away. */
+  ticket = lock->serving;
+  asm volatile ("lock cmpxchgw %3, %1; sete %2"
+                : "+a" (ticket), "+m" (lock->next), "=q" (success)
+                : "r" ((uint16_t) (ticket + 1))
+                : "memory");
+  if (success)
+    {
+      lock->holder = thread_current ();
+      if (lock->class != NULL)
+        {
+          lock->class_tsc = rdtsc ();
+          lock_class_acquired (lock->class, false, 0);
+        }
+#ifdef SPINLOCK_DEBUG
+      lock->acquire_cnt++;
+      lock->acquire_tsc = rdtsc ();
+#endif
+    }
+  return success;
+}
+
+/* Releases LOCK, which must be owned by the current thread.
+   Interrupts must still be off. */
+void
+spin_unlock (struct spinlock *lock)
+{
+  ASSERT (lock != NULL);
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (spin_held_by_current_thread (lock));
+
+  if (lock->class != NULL)
+    lock_class_released (lock->class, rdtsc () - lock->class_tsc);
+#ifdef SPINLOCK_DEBUG
+  {
+    uint64_t hold = rdtsc () - lock->acquire_tsc;
+    if (hold > lock->max_hold)
+      lock->max_hold = hold;
+  }
+#endif
+  lock->holder = NULL;
+  barrier ();
+  lock->serving++;
+}
+
+/* Disables interrupts, acquires LOCK, and returns the previous
+   interrupt level, which the caller should pass to
+   spin_unlock_irqrestore() when it releases LOCK. */
+enum intr_level
+spin_lock_irqsave (struct spinlock *lock)
+{
+  enum intr_level old_level = intr_disable ();
+  spin_lock (lock);
+  return old_level;
+}
+
+/* Releases LOCK, which must be owned by the current thread, then
+   sets the interrupt level to OLD_LEVEL. */
+void
+spin_unlock_irqrestore (struct spinlock *lock, enum intr_level old_level)
+{
+  spin_unlock (lock);
+  intr_set_level (old_level);
+}
+
+/* Returns true if the current thread holds LOCK, false
+   otherwise.  (Note that testing whether some other thread holds
+   a lock would be racy.) */
+bool
+spin_held_by_current_thread (const struct spinlock *lock)
+{
+  ASSERT (lock != NULL);
+
+  return lock->holder == thread_current ();
+}
+
+/* Prints LOCK's statistics, which are only kept if the kernel is
+   built with SPINLOCK_DEBUG defined. */
+void
+spin_print_stats (const struct spinlock *lock)
+{
+#ifdef SPINLOCK_DEBUG
+  printf ("Spinlock %s: %u acquisitions, %u contended, "
+          "longest hold %"PRIu64" cycles\n",
+          lock->name, lock->acquire_cnt, lock->contend_cnt, lock->max_hold);
+#else
+  printf ("Spinlock %s: no statistics (built without SPINLOCK_DEBUG)\n",
+          lock->name);
+#endif
+}
+
 /* One semaphore in a list. */
 struct semaphore_elem
   {
     struct list_elem elem;              /* List element. */
     struct semaphore semaphore;         /* This semaphore. */
+    struct thread *thread;              /* Thread waiting on it. */
   };
 
+static list_less_func waiter_priority_less;
+
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
    code to receive the signal and act upon it. */
@@ -294,16 +1314,55 @@ cond_wait (struct condition *cond, struct lock *lock)
   ASSERT (!intr_context ());
   ASSERT (lock_held_by_current_thread (lock));
 
-  sema_init (&waiter.semaphore, 0);
+  sema_init_named (&waiter.semaphore, 0, NULL);
+  waiter.thread = thread_current ();
   list_push_back (&cond->waiters, &waiter.elem);
   lock_release (lock);
   sema_down (&waiter.semaphore);
   lock_acquire (lock);
 }
 
+/* Like cond_wait(), but stops waiting for COND after TICKS timer
+   ticks.  LOCK is reacquired before returning either way.
+   Returns true if COND was signaled, false if the time ran out
+   first.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+bool
+cond_timedwait (struct condition *cond, struct lock *lock, int64_t ticks)
+{
+  struct semaphore_elem waiter;
+  bool signaled;
+
+  ASSERT (cond != NULL);
+  ASSERT (lock != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (lock_held_by_current_thread (lock));
+
+  sema_init_named (&waiter.semaphore, 0, NULL);
+  waiter.thread = thread_current ();
+  list_push_back (&cond->waiters, &waiter.elem);
+  lock_release (lock);
+  signaled = sema_down_timeout (&waiter.semaphore, ticks);
+  lock_acquire (lock);
+
+  /* A signal may have come between the timeout and reacquiring
+     LOCK.  cond_signal() takes a waiter off COND's list before
+     upping its semaphore, so the semaphore tells which. */
+  if (!signaled)
+    {
+      signaled = sema_try_down (&waiter.semaphore);
+      if (!signaled)
+        list_remove (&waiter.elem);
+    }
+  return signaled;
+}
+
 /* If any threads are waiting on COND (protected by LOCK), then
-   this function signals one of them to wake up from its wait.
-   LOCK must be held before calling this function.
+   this function signals the highest-priority one of them to wake
+   up from its wait.  LOCK must be held before calling this
+   function.
 
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to signal a condition variable within an
@@ -317,8 +1376,22 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED)
   ASSERT (lock_held_by_current_thread (lock));
 
   if (!list_empty (&cond->waiters))
-    sema_up (&list_entry (list_pop_front (&cond->waiters),
-                          struct semaphore_elem, elem)->semaphore);
+    {
+      struct list_elem *e = list_max (&cond->waiters,
+                                      waiter_priority_less, NULL);
+      list_remove (e);
+      sema_up (&list_entry (e, struct semaphore_elem, elem)->semaphore);
+    }
+}
+
+/* Returns true if the thread waiting on semaphore_elem A has
+   lower priority than the one waiting on B. */
+static bool
+waiter_priority_less (const struct list_elem *a, const struct list_elem *b,
+                      void *aux UNUSED)
+{
+  return (list_entry (a, struct semaphore_elem, elem)->thread->priority
+          < list_entry (b, struct semaphore_elem, elem)->thread->priority);
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
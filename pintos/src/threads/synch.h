@@ -3,32 +3,81 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include "threads/interrupt.h"
+
+/* Lock statistics ("lockstat").
+
+   With the -lockstat kernel command-line option, every lock,
+   semaphore, readers-writer lock and spinlock is assigned at
+   initialization to a class, identified by its name, and
+   acquiring it records in the class how often it was acquired,
+   how often it had to wait, and for how long, in time stamp
+   counter cycles.  Locks also record how long they were held:
+   for a readers-writer lock, only by writers, and for a
+   spinlock, time spent spinning counts as waiting.
+
+   lock_init(), sema_init() and rw_init() name the lock after the
+   expression that designates it, such as "&inode_list_lock", so
+   that all the locks initialized by the same line of code form
+   one class.  Use lock_init_named(), sema_init_named() or
+   rw_init_named() to pick a different name, for example to tell
+   apart hot locks initialized by one loop, or a null name to
+   exclude a lock from the statistics.  A spinlock's class is the
+   name passed to spin_init(). */
+extern bool lockstat_enabled;
+
+struct lock_class;
+struct lockstat;
+
+void lockstat_print (void);
+int lockstat_get (struct lockstat *, int max);
 
 /* A counting semaphore. */
 struct semaphore
   {
     unsigned value;             /* Current value. */
     struct list waiters;        /* List of waiting threads. */
+    struct lock_class *class;   /* Statistics, if any. */
   };
 
-void sema_init (struct semaphore *, unsigned value);
+#define sema_init(SEMA, VALUE) sema_init_named (SEMA, VALUE, #SEMA)
+void sema_init_named (struct semaphore *, unsigned value, const char *name);
 void sema_down (struct semaphore *);
+bool sema_down_timeout (struct semaphore *, int64_t ticks);
 bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
 void sema_self_test (void);
 
+/* Number of buckets in a lock's wait-time histogram.  Bucket 0
+   counts waits of less than one tick, bucket B > 0 counts waits
+   of 2**(B-1) to 2**B - 1 ticks, and the last bucket also counts
+   all longer waits. */
+#define LOCK_WAIT_BUCKETS 8
+
 /* Lock. */
 struct lock
   {
     struct thread *holder;      /* Thread holding lock (for debugging). */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
+    struct list_elem elem;      /* Element in holder's held_locks list. */
+    int max_priority;           /* Highest priority donated by a waiter. */
+
+    /* How long threads above PRI_DEFAULT waited to acquire. */
+    unsigned wait_hist[LOCK_WAIT_BUCKETS];
+
+    struct lock_class *class;   /* Statistics, if any. */
+    uint64_t acquire_tsc;       /* Time stamp counter at acquisition. */
   };
 
-void lock_init (struct lock *);
+#define lock_init(LOCK) lock_init_named (LOCK, #LOCK)
+void lock_init_named (struct lock *, const char *name);
 void lock_acquire (struct lock *);
+bool lock_acquire_timeout (struct lock *, int64_t ticks);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
+void lock_print_wait_hist (const struct lock *, const char *name);
 
 /* Condition variable. */
 struct condition
@@ -38,9 +87,104 @@ struct condition
 
 void cond_init (struct condition *);
 void cond_wait (struct condition *, struct lock *);
+bool cond_timedwait (struct condition *, struct lock *, int64_t ticks);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Readers-writer lock.
+
+   Any number of threads may hold the lock for reading at once,
+   or one thread may hold it for writing.  Waiters are granted
+   the lock in order of priority, highest first.
+
+   With writer preference, a thread that wants to read waits if a
+   writer is waiting, so that a steady stream of readers cannot
+   starve writers.  Without it, a reader only waits while a
+   writer holds the lock, which lets a thread that already holds
+   the lock for reading safely acquire it for reading again.
+
+   Waiters donate their priority to every thread holding the
+   lock, readers included.  Each thread records its holds in an
+   array of RW_HOLD_MAX struct rw_holds; holds beyond that still
+   work but receive no donation.  Donation does not continue past
+   a holder that is itself blocked on a readers-writer lock, only
+   past one blocked on an ordinary lock. */
+struct rwlock
+  {
+    int readers;                /* Number of threads holding for reading. */
+    struct thread *writer;      /* Thread holding for writing, if any. */
+    unsigned waiting_writers;   /* Number of writers in waiters. */
+    bool prefer_writers;        /* Make readers wait for waiting writers? */
+    struct list waiters;        /* List of waiting threads. */
+    struct list holders;        /* Recorded holds, as struct rw_holds. */
+    int max_priority;           /* Highest priority donated by a waiter. */
+    struct lock_class *class;   /* Statistics, if any. */
+    uint64_t acquire_tsc;       /* Time stamp counter at write acquisition. */
+  };
+
+/* One thread's hold on a readers-writer lock, for donation. */
+#define RW_HOLD_MAX 8
+struct rw_hold
+  {
+    struct list_elem elem;      /* Element in rwlock's holders. */
+    struct rwlock *rwlock;      /* Lock held, or null if unused. */
+    struct thread *thread;      /* Thread holding it. */
+  };
+
+#define rw_init(RWLOCK, PREFER_WRITERS) \
+        rw_init_named (RWLOCK, PREFER_WRITERS, #RWLOCK)
+void rw_init_named (struct rwlock *, bool prefer_writers, const char *name);
+void rw_read_acquire (struct rwlock *);
+void rw_read_release (struct rwlock *);
+void rw_write_acquire (struct rwlock *);
+void rw_write_release (struct rwlock *);
+bool rw_write_held_by_current_thread (const struct rwlock *);
+
+/* Spinlock.
+
+   A ticket lock: each thread that wants the lock takes the next
+   ticket and spins until the lock serves that ticket, so waiters
+   get the lock in the order they arrived.  A spinlock never
+   sleeps, so it costs no context switches and may be used in
+   interrupt handlers, but it must only protect short critical
+   sections.
+
+   A thread holding a spinlock must not be preempted, or another
+   thread could spin on it for a whole time slice, so interrupts
+   must stay off while one is held.  spin_lock() and
+   spin_unlock() expect the caller to have turned them off.
+   spin_lock_irqsave() and spin_unlock_irqrestore() do it for
+   the caller.
+
+   Defining SPINLOCK_DEBUG, e.g. by adding -DSPINLOCK_DEBUG to
+   DEFINES in Make.vars, makes each spinlock also count its
+   acquisitions, including those that had to spin, and measure
+   its longest hold time, for spin_print_stats() to report. */
+struct spinlock
+  {
+    volatile uint16_t next;     /* Next ticket to hand out. */
+    volatile uint16_t serving;  /* Ticket allowed to hold the lock. */
+    struct thread *holder;      /* Thread holding lock (for debugging). */
+    const char *name;           /* Name (for debugging). */
+    struct lock_class *class;   /* Statistics, if any. */
+    uint64_t class_tsc;         /* Time stamp counter at acquisition. */
+#ifdef SPINLOCK_DEBUG
+    unsigned acquire_cnt;       /* Number of acquisitions. */
+    unsigned contend_cnt;       /* Acquisitions that had to spin. */
+    uint64_t acquire_tsc;       /* Time stamp counter at acquisition. */
+    uint64_t max_hold;          /* Longest hold, in time stamp cycles. */
+#endif
+  };
+
+void spin_init (struct spinlock *, const char *name);
+void spin_lock (struct spinlock *);
+bool spin_trylock (struct spinlock *);
+void spin_unlock (struct spinlock *);
+enum intr_level spin_lock_irqsave (struct spinlock *);
+void spin_unlock_irqrestore (struct spinlock *, enum intr_level);
+bool spin_held_by_current_thread (const struct spinlock *);
+void spin_print_stats (const struct spinlock *);
+
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
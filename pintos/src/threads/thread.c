@@ -2,15 +2,20 @@
 #include <debug.h>
 #include <stddef.h>
 #include <random.h>
+#include <round.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
+#include "threads/rcu.h"
+#include "threads/smp.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
+#include "threads/trace.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "threads/malloc.h"
@@ -21,22 +26,47 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Each CPU has a run queue of processes in THREAD_READY state,
+   that is, processes that are ready to run but not actually
+   running, in its struct cpu (see smp.h).  There is one FIFO
+   list per priority.  Bit P of a CPU's ready_bitmap is set if
+   and only if its ready_queues[P] is nonempty, so the highest
+   nonempty queue is found with a single bit scan.  Under the
+   stride scheduler, a heap ordered by pass takes the place of
+   the lists.  A ready thread T is in the run queue of T->cpu. */
 
 /* List of all processes.  Processes are added to this list
-   when they are first scheduled and removed when they exit. */
+   when they are first scheduled and removed when they exit.
+   Writers turn interrupts off; readers use RCU, so a thread's
+   page is only freed a grace period after it leaves the list. */
 static struct list all_list;
 
-/* Idle thread. */
-static struct thread *idle_thread;
-
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
 /* Lock used by allocate_tid(). */
-static struct lock tid_lock;
+static struct spinlock tid_lock;
+
+/* Caches of recently freed thread pages and, for user programs,
+   childProc records, so that creating a thread or a process
+   usually needs neither palloc_get_page() nor malloc().  A
+   cached page is not zeroed: init_thread() clears just the
+   struct thread at its base, and the rest is stack.  Each cache
+   holds at most THREAD_CACHE_MAX objects and is protected by
+   thread_cache_lock, because pages are freed with interrupts off
+   in thread_schedule_tail(). */
+#define THREAD_CACHE_MAX 16
+static struct spinlock thread_cache_lock;
+static struct list page_cache;          /* Cached pages. */
+static unsigned page_cache_cnt;         /* Number of pages in page_cache. */
+static unsigned page_cache_hits;        /* Allocations from page_cache. */
+static unsigned page_cache_misses;      /* Allocations from palloc. */
+#ifdef USERPROG
+static struct list proc_cache;          /* Cached childProc records. */
+static unsigned proc_cache_cnt;         /* Number of records in proc_cache. */
+static unsigned proc_cache_hits;        /* Allocations from proc_cache. */
+static unsigned proc_cache_misses;      /* Allocations from malloc. */
+#endif
 
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame
@@ -53,31 +83,124 @@ static long long user_ticks;    /* # of timer ticks in user programs. */
 
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
-static unsigned thread_ticks;   /* # of timer ticks since last yield. */
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* Stride scheduling.
+
+   Under "-o stride", each thread holds a number of tickets, and
+   over time gets a share of the CPU proportional to its share of
+   the tickets of all the threads that want to run.  Unlike a
+   lottery scheduler, which picks a ticket at random, the stride
+   scheduler is deterministic, so shares hold exactly over any
+   long enough interval, not just on average.
+
+   Each thread has a pass, its virtual time.  Every tick that a
+   thread runs advances its pass by its stride, STRIDE1 divided
+   by its ticket count, and each CPU always runs the ready thread
+   with the least pass, which it finds in O(log n) time in its
+   stride_heap.  A thread with twice the tickets thus has half
+   the stride and gets picked twice as often.
+
+   The ready and running threads of a user process split the
+   process's tickets evenly, rather than each holding its own, so
+   that a process cannot raise its share by creating more
+   threads, nor lose it to threads that are blocked.
+
+   A CPU's stride_pass is the pass of the last thread it took
+   from its heap.  A thread that joins the heap with a smaller
+   pass, because it is new or has slept for a while, starts at
+   stride_pass instead, so that it cannot claim the CPU time it
+   did not use while it was away.  Priorities, and thus priority
+   donation, have no effect on the order in which threads run,
+   but the deadline class still runs before everything else. */
+#define STRIDE1 (1 << 20)       /* Stride of a thread with one ticket. */
+bool thread_stride;
+
+/* Niceness limits for the MLFQS. */
+#define NICE_MIN -20            /* Nicest. */
+#define NICE_MAX 20             /* Least nice. */
+
+/* System load average, for the MLFQS.  An estimate of the number
+   of threads ready to run over the past minute. */
+static fixed_point_t load_avg;
+
+/* Deadline scheduling.
+
+   A thread that calls thread_set_deadline() joins the deadline
+   class, whose threads run before any thread of any priority.
+   It then runs a series of jobs, one per period.  A job is
+   released at the start of its period, may use up to the
+   thread's runtime of CPU time, and should end, by calling
+   thread_deadline_yield(), by its deadline, a fixed number of
+   ticks after its release.  Ready deadline threads run earliest
+   deadline first (EDF).
+
+   EDF meets every deadline as long as the total utilization,
+   the sum over deadline threads of runtime / period, is at most
+   1.  Deadline threads do not migrate, so they all share CPU 0,
+   and thread_set_deadline() refuses to admit a thread that would
+   raise their total utilization beyond DL_UTIL_MAX, which leaves
+   some time for everyone else.  A job that uses up its runtime
+   before it ends is throttled: it misses its deadline, and the
+   thread sleeps until its next period.  Thus, a runaway deadline
+   thread can neither starve other threads nor make other
+   deadline threads miss their deadlines. */
+#define DL_UTIL_SCALE 1000      /* Utilization 1 in parts per thousand. */
+#define DL_UTIL_MAX 950         /* Most total utilization to admit. */
+static int dl_util;             /* Total utilization of deadline threads. */
+static unsigned dl_job_cnt;     /* # of deadline jobs ended. */
+static unsigned dl_miss_cnt;    /* # of deadline jobs that missed. */
+static unsigned dl_throttle_cnt; /* # of deadline jobs throttled. */
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
+static void idle_loop (void) NO_RETURN;
+static bool is_idle_thread (const struct thread *);
 static struct thread *running_thread (void);
-static struct thread *next_thread_to_run (void);
+static struct thread *next_thread_to_run (struct cpu *);
+static struct thread *steal_thread (struct cpu *, int min_priority);
+static bool thread_may_migrate (const struct thread *);
+static void kick_cpu (struct thread *);
+static void ready_push (struct thread *);
+static void ready_remove (struct thread *);
+static bool ready_outranks (const struct thread *);
+static bool thread_outranks (const struct thread *, const struct thread *);
+static list_less_func deadline_less;
+static int deadline_util (const struct thread *);
+static void deadline_tick (struct thread *);
+static void deadline_next_job (struct thread *);
+static void deadline_leave (struct thread *);
+static int ready_thread_cnt (void);
+static void change_priority (struct thread *, int priority);
+static void mlfqs_tick (struct thread *);
+static int stride (struct thread *);
+static heap_less_func stride_less;
+static struct thread *stride_pop (struct cpu *);
+static struct thread *stride_steal (struct cpu *);
+static int mlfqs_priority (const struct thread *);
+static void mlfqs_update_priority (struct thread *, void *aux);
+static void mlfqs_decay_recent_cpu (struct thread *, void *aux);
 static void init_thread (struct thread *, const char *name, int priority);
 static bool is_thread (struct thread *) UNUSED;
 static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static struct thread *alloc_thread_page (void);
+static void free_thread_page (struct thread *);
+static rcu_func free_dead_thread;
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
    general and it is possible in this case only because loader.S
    was careful to put the bottom of the stack at a page boundary.
 
-   Also initializes the run queue and the tid lock.
+   Also initializes the run queues and the tid lock.
 
    After calling this function, be sure to initialize the page
    allocator before trying to create any threads with
@@ -88,16 +211,38 @@ static tid_t allocate_tid (void);
 void
 thread_init (void)
 {
+  int i, pri;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
-  lock_init (&tid_lock);
-  list_init (&ready_list);
+  spin_init (&tid_lock, "tid");
+  spin_init (&thread_cache_lock, "thread cache");
+  list_init (&page_cache);
+#ifdef USERPROG
+  list_init (&proc_cache);
+#endif
+  for (i = 0; i < SMP_MAX_CPUS; i++)
+    {
+      struct cpu *cpu = &cpus[i];
+
+      cpu->id = i;
+      for (pri = PRI_MIN; pri <= PRI_MAX; pri++)
+        list_init (&cpu->ready_queues[pri]);
+      cpu->ready_bitmap = 0;
+      list_init (&cpu->deadline_queue);
+      heap_init (&cpu->stride_heap, stride_less, NULL);
+      cpu->stride_pass = 0;
+      cpu->ready_cnt = 0;
+    }
+  load_avg = fix_int (0);
   list_init (&all_list);
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
   init_thread (initial_thread, "main", PRI_DEFAULT);
   initial_thread->status = THREAD_RUNNING;
+  initial_thread->cpu = &cpus[0];
+  cpus[0].current = initial_thread;
   initial_thread->tid = allocate_tid ();
 }
 
@@ -118,16 +263,57 @@ thread_start (void)
   sema_down (&idle_started);
 }
 
-/* Called by the timer interrupt handler at each timer tick.
-   Thus, this function runs in an external interrupt context. */
+/* Creates the idle thread for CPU, an application processor that
+   is about to start.  Instead of being scheduled, it becomes the
+   running thread on CPU as soon as the CPU starts running on its
+   stack, then calls thread_start_ap().  Returns the new thread,
+   or a null pointer if memory is exhausted. */
+struct thread *
+thread_create_idle (struct cpu *cpu)
+{
+  struct thread *t;
+  char name[16];
+
+  t = palloc_get_page (PAL_ZERO);
+  if (t == NULL)
+    return NULL;
+
+  snprintf (name, sizeof name, "idle%d", cpu->id);
+  init_thread (t, name, PRI_MIN);
+  t->priority = t->base_priority = PRI_MIN;
+  t->tid = allocate_tid ();
+  t->status = THREAD_RUNNING;
+  t->cpu = cpu;
+  cpu->idle_thread = cpu->current = t;
+  return t;
+}
+
+/* Starts scheduling threads on an application processor, in its
+   idle thread.  Called once the CPU is initialized. */
+void
+thread_start_ap (void)
+{
+  ASSERT (is_idle_thread (thread_current ()));
+
+  kernel_lock_enter ();
+  idle_loop ();
+}
+
+/* Called by the timer interrupt handler at each timer tick, on
+   each CPU.  Thus, this function runs in an external interrupt
+   context. */
 void
 thread_tick (void)
 {
   struct thread *t = thread_current ();
+  struct cpu *cpu = t->cpu;
 
   /* Update statistics. */
-  if (t == idle_thread)
-    idle_ticks++;
+  if (is_idle_thread (t))
+    {
+      idle_ticks++;
+      cpu->idle_ticks++;
+    }
 #ifdef USERPROG
   else if (t->pagedir != NULL)
     user_ticks++;
@@ -135,8 +321,17 @@ thread_tick (void)
   else
     kernel_ticks++;
 
+  if (thread_mlfqs)
+    mlfqs_tick (t);
+  if (t->dl)
+    deadline_tick (t);
+  else if (thread_stride && !is_idle_thread (t))
+    t->pass += stride (t);
+  if (t->preempt_off == 0)
+    rcu_quiescent ();
+
   /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE)
+  if (++cpu->thread_ticks >= TIME_SLICE)
     intr_yield_on_return ();
 }
 
@@ -144,8 +339,34 @@ thread_tick (void)
 void
 thread_print_stats (void)
 {
+  int i;
+
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+  if (smp_cpu_cnt > 1)
+    for (i = 0; i < smp_cpu_cnt; i++)
+      printf ("CPU %d: %lld idle ticks, %u threads stolen\n",
+              i, cpus[i].idle_ticks, cpus[i].steal_cnt);
+  printf ("Thread cache: %u page hits, %u page misses",
+          page_cache_hits, page_cache_misses);
+#ifdef USERPROG
+  printf (", %u childProc hits, %u childProc misses",
+          proc_cache_hits, proc_cache_misses);
+#endif
+  printf ("\n");
+  if (dl_job_cnt > 0 || dl_throttle_cnt > 0)
+    printf ("Deadline: %u jobs, %u deadline misses, %u throttled\n",
+            dl_job_cnt, dl_miss_cnt, dl_throttle_cnt);
+}
+
+/* Returns the number of timer ticks spent in the idle thread. */
+long long
+thread_idle_ticks (void)
+{
+  enum intr_level old_level = intr_disable ();
+  long long t = idle_ticks;
+  intr_set_level (old_level);
+  return t;
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -160,9 +381,8 @@ thread_print_stats (void)
    scheduled.  Use a semaphore or some other form of
    synchronization if you need to ensure ordering.
 
-   The code provided sets the new thread's `priority' member to
-   PRIORITY, but no actual priority scheduling is implemented.
-   Priority scheduling is the goal of Problem 1-3. */
+   If the new thread has a higher priority than the running
+   thread, it preempts the running thread immediately. */
 tid_t
 thread_create (const char *name, int priority,
                thread_func *function, void *aux)
@@ -176,7 +396,7 @@ thread_create (const char *name, int priority,
   ASSERT (function != NULL);
 
   /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);
+  t = alloc_thread_page ();
   if (t == NULL)
     return TID_ERROR;
 
@@ -199,17 +419,6 @@ thread_create (const char *name, int priority,
   sf->eip = switch_entry;
   sf->ebp = 0;
 
-#ifdef USERPROG
-  struct childProc *cp = malloc (sizeof (struct childProc));
-  cp->pid = tid;
-  cp->exe = NULL;
-  cp->loaded = false;
-  sema_init (&cp->sema, 0);
-  cp->exit_status = -1;
-  list_push_back (&running_thread ()->children, &cp->elem);
-  t->proc = cp;
-  t->wd = running_thread ()-> wd;
-#endif
 
   /* Add to run queue. */
   thread_unblock (t);
@@ -229,7 +438,12 @@ thread_block (void)
   ASSERT (!intr_context ());
   ASSERT (intr_get_level () == INTR_OFF);
 
+  TRACE (TRACE_THREAD_BLOCK, __builtin_return_address (0), 0, 0);
   thread_current ()->status = THREAD_BLOCKED;
+#ifdef USERPROG
+  if (thread_current ()->process != NULL)
+    thread_current ()->process->runnable_cnt--;
+#endif
   schedule ();
 }
 
@@ -237,10 +451,13 @@ thread_block (void)
    This is an error if T is not blocked.  (Use thread_yield() to
    make the running thread ready.)
 
-   This function does not preempt the running thread.  This can
-   be important: if the caller had disabled interrupts itself,
-   it may expect that it can atomically unblock a thread and
-   update other data. */
+   If T has a higher priority than the running thread, T
+   preempts it, but only if the caller had interrupts enabled or
+   is an external interrupt handler.  This can be important: if
+   the caller had disabled interrupts itself, it may expect that
+   it can atomically unblock a thread and update other data.
+   Such callers should call thread_preempt() once they turn
+   interrupts back on. */
 void
 thread_unblock (struct thread *t)
 {
@@ -250,9 +467,19 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  list_push_back (&ready_list, &t->elem);
+  TRACE (TRACE_THREAD_UNBLOCK, t->tid, 0, 0);
+  ready_push (t);
   t->status = THREAD_READY;
+#ifdef USERPROG
+  if (t->process != NULL)
+    t->process->runnable_cnt++;
+#endif
+  if (smp_cpu_cnt > 1)
+    kick_cpu (t);
   intr_set_level (old_level);
+
+  if (old_level == INTR_ON || intr_context ())
+    thread_preempt ();
 }
 
 /* Returns the name of the running thread. */
@@ -303,14 +530,19 @@ thread_exit (void)
      and schedule another process.  That process will destroy us
      when it calls thread_schedule_tail(). */
   intr_disable ();
-  list_remove (&thread_current()->allelem);
+  deadline_leave (thread_current ());
+  rcu_list_remove (&thread_current()->allelem);
   thread_current ()->status = THREAD_DYING;
   schedule ();
   NOT_REACHED ();
 }
 
 /* Yields the CPU.  The current thread is not put to sleep and
-   may be scheduled again immediately at the scheduler's whim. */
+   may be scheduled again immediately at the scheduler's whim,
+   unless it is a deadline thread that has used up its budget, in
+   which case it first sleeps until its next period.  If the
+   current thread has disabled preemption, it yields only when it
+   enables it again. */
 void
 thread_yield (void)
 {
@@ -319,98 +551,583 @@ thread_yield (void)
 
   ASSERT (!intr_context ());
 
+  if (cur->preempt_off > 0)
+    {
+      cur->preempt_pending = true;
+      return;
+    }
+
   old_level = intr_disable ();
-  if (cur != idle_thread)
-    list_push_back (&ready_list, &cur->elem);
+  if (cur->dl_throttled)
+    deadline_next_job (cur);
+  if (!is_idle_thread (cur))
+    ready_push (cur);
   cur->status = THREAD_READY;
   schedule ();
   intr_set_level (old_level);
 }
 
+/* Yields the CPU if a thread in its run queue outranks the
+   running thread.  Within an external interrupt handler, the
+   yield happens when the handler returns.  Does nothing if
+   interrupts are off outside an interrupt handler, because the
+   caller may be relying on running atomically. */
+void
+thread_preempt (void)
+{
+  if (intr_context ())
+    {
+      if (ready_outranks (thread_current ()))
+        intr_yield_on_return ();
+    }
+  else if (intr_get_level () == INTR_ON
+           && ready_outranks (thread_current ()))
+    thread_yield ();
+}
+
+/* Keeps the running thread from being preempted, without
+   turning interrupts off, until a matching call to
+   thread_preempt_enable().  Calls may nest.  The thread must not
+   sleep in between.  This is what makes an RCU read-side
+   critical section (see rcu.h). */
+void
+thread_preempt_disable (void)
+{
+  thread_current ()->preempt_off++;
+  barrier ();
+}
+
+/* Undoes a call to thread_preempt_disable().  If that was the
+   last such call and a yield was put off in the meantime, yields
+   now, or if interrupts are off, leaves it to the next timer
+   tick. */
+void
+thread_preempt_enable (void)
+{
+  struct thread *cur = thread_current ();
+
+  ASSERT (cur->preempt_off > 0);
+
+  barrier ();
+  if (--cur->preempt_off == 0 && cur->preempt_pending)
+    {
+      cur->preempt_pending = false;
+      if (intr_context ())
+        intr_yield_on_return ();
+      else if (intr_get_level () == INTR_ON)
+        thread_yield ();
+    }
+}
+
 /* Invoke function 'func' on all threads, passing along 'aux'.
-   This function must be called with interrupts off. */
+   FUNC runs in an RCU read-side critical section, so it must
+   not sleep, but interrupts need not be off. */
 void
 thread_foreach (thread_action_func *func, void *aux)
 {
   struct list_elem *e;
 
-  ASSERT (intr_get_level () == INTR_OFF);
-
+  rcu_read_lock ();
   for (e = list_begin (&all_list); e != list_end (&all_list);
        e = list_next (e))
     {
       struct thread *t = list_entry (e, struct thread, allelem);
       func (t, aux);
     }
+  rcu_read_unlock ();
 }
 
-/* Sets the current thread's priority to NEW_PRIORITY. */
+/* Sets the current thread's base priority to NEW_PRIORITY and
+   yields if it no longer has the highest priority.  Priority
+   donated to the thread still applies.  Ignored by the MLFQS,
+   which computes priorities itself. */
 void
 thread_set_priority (int new_priority)
 {
-  thread_current ()->priority = new_priority;
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (PRI_MIN <= new_priority && new_priority <= PRI_MAX);
+
+  if (thread_mlfqs)
+    return;
+
+  old_level = intr_disable ();
+  cur->base_priority = new_priority;
+  thread_refresh_priority (cur);
+  intr_set_level (old_level);
+
+  thread_preempt ();
 }
 
-/* Returns the current thread's priority. */
+/* Returns the current thread's effective priority, including any
+   donated priority. */
 int
 thread_get_priority (void)
 {
   return thread_current ()->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
+/* Recomputes T's effective priority as the higher of its base
+   priority and the highest priority donated through any lock or
+   readers-writer lock it holds.  If T is ready, moves it to the
+   matching run queue.  Interrupts must be off.  Does nothing
+   under the MLFQS, which does not donate. */
+void
+thread_refresh_priority (struct thread *t)
+{
+  int priority;
+  struct list_elem *e;
+  int i;
+
+  ASSERT (is_thread (t));
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (thread_mlfqs)
+    return;
+
+  priority = t->base_priority;
+  for (e = list_begin (&t->held_locks); e != list_end (&t->held_locks);
+       e = list_next (e))
+    {
+      struct lock *lock = list_entry (e, struct lock, elem);
+      if (lock->max_priority > priority)
+        priority = lock->max_priority;
+    }
+  for (i = 0; i < RW_HOLD_MAX; i++)
+    {
+      struct rwlock *rwlock = t->rw_holds[i].rwlock;
+      if (rwlock != NULL && rwlock->max_priority > priority)
+        priority = rwlock->max_priority;
+    }
+  change_priority (t, priority);
+}
+
+/* Sets T's effective priority to PRIORITY, moving T to the
+   matching run queue if it is ready.  Interrupts must be off. */
+static void
+change_priority (struct thread *t, int priority)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+  if (priority == t->priority)
+    return;
+  if (t->status == THREAD_READY && !thread_stride)
+    {
+      ready_remove (t);
+      t->priority = priority;
+      ready_push (t);
+    }
+  else
+    t->priority = priority;
+}
+
+/* Puts the running thread in the deadline class, or changes its
+   parameters if it is already in it.  From now on, a job is
+   released every PERIOD ticks, the first one now, and may use
+   RUNTIME ticks of CPU time.  It should end, by calling
+   thread_deadline_yield(), within DEADLINE ticks of its
+   release.  Returns true if successful, false if the parameters
+   are invalid, which they are unless 0 < RUNTIME <= DEADLINE <=
+   PERIOD, or if admitting the thread would let deadline threads
+   use more than DL_UTIL_MAX of the CPU. */
+bool
+thread_set_deadline (int64_t runtime, int64_t deadline, int64_t period)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  int64_t util;
+  bool admitted = false;
+
+  if (runtime <= 0 || runtime > deadline || deadline > period)
+    return false;
+  util = DIV_ROUND_UP (runtime * DL_UTIL_SCALE, period);
+
+  old_level = intr_disable ();
+  if (dl_util - (cur->dl ? deadline_util (cur) : 0) + util <= DL_UTIL_MAX)
+    {
+      deadline_leave (cur);
+      dl_util += util;
+      cur->dl = true;
+      cur->dl_runtime = runtime;
+      cur->dl_rel_deadline = deadline;
+      cur->dl_period = period;
+      cur->dl_release = timer_ticks ();
+      cur->dl_deadline = cur->dl_release + deadline;
+      cur->dl_budget = runtime;
+      cur->dl_missed = false;
+      admitted = true;
+    }
+  intr_set_level (old_level);
+  return admitted;
+}
+
+/* Takes the running thread out of the deadline class, returning
+   it to scheduling by priority. */
 void
-thread_set_nice (int nice UNUSED)
+thread_clear_deadline (void)
+{
+  enum intr_level old_level = intr_disable ();
+  deadline_leave (thread_current ());
+  intr_set_level (old_level);
+
+  thread_preempt ();
+}
+
+/* Ends the running deadline thread's current job and sleeps
+   until its next job is released.  Returns true if the job met
+   its deadline, false if it missed it. */
+bool
+thread_deadline_yield (void)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  bool met;
+
+  ASSERT (!intr_context ());
+  ASSERT (cur->dl);
+
+  old_level = intr_disable ();
+  met = !cur->dl_missed && timer_ticks () <= cur->dl_deadline;
+  if (!met && !cur->dl_missed)
+    dl_miss_cnt++;
+  dl_job_cnt++;
+  cur->dl_missed = false;
+  deadline_next_job (cur);
+  intr_set_level (old_level);
+  return met;
+}
+
+/* Returns deadline thread T's utilization, in units of
+   1 / DL_UTIL_SCALE, rounded up. */
+static int
+deadline_util (const struct thread *t)
 {
-  /* Not yet implemented. */
+  return DIV_ROUND_UP (t->dl_runtime * DL_UTIL_SCALE, t->dl_period);
+}
+
+/* Charges deadline thread T, which is running, for a timer tick,
+   and throttles it if that uses up its budget.  Counts a missed
+   deadline at most once per job. */
+static void
+deadline_tick (struct thread *t)
+{
+  ASSERT (intr_context ());
+
+  if (!t->dl_missed && timer_ticks () > t->dl_deadline)
+    {
+      t->dl_missed = true;
+      dl_miss_cnt++;
+    }
+  if (--t->dl_budget <= 0 && !t->dl_throttled)
+    {
+      /* The job cannot end by its deadline now: its next chance
+         to run is its next period, which starts no earlier. */
+      t->dl_throttled = true;
+      dl_throttle_cnt++;
+      if (!t->dl_missed)
+        {
+          t->dl_missed = true;
+          dl_miss_cnt++;
+        }
+      intr_yield_on_return ();
+    }
+}
+
+/* Starts deadline thread T's next job: refills its budget and,
+   if its next period has not started yet, sleeps until it does.
+   A thread that falls behind by more than a period starts its
+   next job at once.  T must be the running thread, and
+   interrupts must be off. */
+static void
+deadline_next_job (struct thread *t)
+{
+  int64_t now = timer_ticks ();
+  int64_t release = t->dl_release + t->dl_period;
+
+  ASSERT (t == thread_current ());
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (release < now)
+    release = now;
+  t->dl_release = release;
+  t->dl_deadline = release + t->dl_rel_deadline;
+  t->dl_budget = t->dl_runtime;
+  t->dl_throttled = false;
+  timer_sleep_until (release);
+}
+
+/* Takes T, which must not be ready, out of the deadline class
+   if it is in it.  Interrupts must be off. */
+static void
+deadline_leave (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->status != THREAD_READY);
+
+  if (t->dl)
+    {
+      dl_util -= deadline_util (t);
+      t->dl = t->dl_throttled = t->dl_missed = false;
+    }
+}
+
+/* Returns true if deadline thread A's deadline is earlier than
+   deadline thread B's. */
+static bool
+deadline_less (const struct list_elem *a, const struct list_elem *b,
+               void *aux UNUSED)
+{
+  return (list_entry (a, struct thread, elem)->dl_deadline
+          < list_entry (b, struct thread, elem)->dl_deadline);
+}
+
+/* Sets the current thread's nice value to NICE, recalculates
+   its priority, and yields if it no longer has the highest
+   priority. */
+void
+thread_set_nice (int nice)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (NICE_MIN <= nice && nice <= NICE_MAX);
+
+  old_level = intr_disable ();
+  cur->nice = nice;
+  if (thread_mlfqs)
+    mlfqs_update_priority (cur, NULL);
+  intr_set_level (old_level);
+
+  thread_preempt ();
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void)
 {
-  /* Not yet implemented. */
-  return 0;
+  return thread_current ()->nice;
+}
+
+/* Returns the current thread's ticket count, which for a thread
+   of a user process is the whole process's. */
+int
+thread_get_tickets (void)
+{
+#ifdef USERPROG
+  struct process *p = thread_current ()->process;
+  if (p != NULL)
+    return p->tickets;
+#endif
+  return thread_current ()->tickets;
 }
 
+/* Sets the current thread's ticket count to TICKETS, which sets
+   its share of the CPU under the stride scheduler.  Threads that
+   it creates from now on inherit the new count.  In a user
+   process, sets the process's count instead, which all of its
+   threads share. */
+void
+thread_set_tickets (int tickets)
+{
+#ifdef USERPROG
+  struct process *p = thread_current ()->process;
+#endif
+
+  ASSERT (TICKETS_MIN <= tickets && tickets <= TICKETS_MAX);
+
+#ifdef USERPROG
+  if (p != NULL)
+    {
+      p->tickets = tickets;
+      return;
+    }
+#endif
+  thread_current ()->tickets = tickets;
+}
+
+/* Returns T's stride, by which its pass advances each tick that
+   it runs. */
+static int
+stride (struct thread *t)
+{
+#ifdef USERPROG
+  struct process *p = t->process;
+  if (p != NULL)
+    return STRIDE1 / p->tickets * (p->runnable_cnt > 1 ? p->runnable_cnt : 1);
+#endif
+  return STRIDE1 / t->tickets;
+}
+
+#ifdef USERPROG
+/* Makes the running thread one of process P's, or a kernel
+   thread if P is null, keeping count of the threads of each
+   process that are ready or running. */
+void
+thread_set_process (struct process *p)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level = intr_disable ();
+
+  if (cur->process != NULL)
+    cur->process->runnable_cnt--;
+  cur->process = p;
+  if (p != NULL)
+    p->runnable_cnt++;
+  intr_set_level (old_level);
+}
+#endif
+
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void)
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int load = fix_round (fix_scale (load_avg, 100));
+  intr_set_level (old_level);
+  return load;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void)
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int recent = fix_round (fix_scale (thread_current ()->recent_cpu, 100));
+  intr_set_level (old_level);
+  return recent;
+}
+
+/* Does the MLFQS bookkeeping for timer tick, with CUR running.
+
+   Between the once-per-second recalculations of load_avg and
+   recent_cpu, the only input to any thread's priority that
+   changes is the running thread's recent_cpu.  So instead of
+   recomputing every thread's priority every TIME_SLICE ticks, we
+   recompute only the running thread's then, and do a single pass
+   over all_list once per second, which both decays recent_cpu
+   and recomputes the priority of every thread. */
+static void
+mlfqs_tick (struct thread *cur)
+{
+  int64_t ticks = timer_ticks ();
+
+  ASSERT (intr_context ());
+
+  if (!is_idle_thread (cur))
+    cur->recent_cpu = fix_add (cur->recent_cpu, fix_int (1));
+
+  /* Only CPU 0's timer ticks advance timer_ticks(), so the
+     once-per-second work is its job alone. */
+  if (ticks % TIMER_FREQ == 0 && cur->cpu->id == 0)
+    {
+      /* load_avg = (59/60)*load_avg + (1/60)*ready_threads. */
+      int ready_threads = ready_thread_cnt ();
+      fixed_point_t coeff;
+
+      load_avg = fix_add (fix_mul (fix_frac (59, 60), load_avg),
+                          fix_frac (ready_threads, 60));
+
+      /* coeff = (2*load_avg)/(2*load_avg + 1), shared by every
+         thread's decay. */
+      coeff = fix_div (fix_scale (load_avg, 2),
+                       fix_add (fix_scale (load_avg, 2), fix_int (1)));
+      thread_foreach (mlfqs_decay_recent_cpu, &coeff);
+    }
+  else if (ticks % TIME_SLICE == 0)
+    mlfqs_update_priority (cur, NULL);
+
+  if (ready_outranks (cur))
+    intr_yield_on_return ();
+}
+
+/* Decays T's recent_cpu by the coefficient that AUX points to,
+   then recalculates T's priority.  Used as a thread_foreach()
+   callback. */
+static void
+mlfqs_decay_recent_cpu (struct thread *t, void *aux)
+{
+  fixed_point_t *coeff = aux;
+
+  if (is_idle_thread (t))
+    return;
+
+  t->recent_cpu = fix_add (fix_mul (*coeff, t->recent_cpu),
+                           fix_int (t->nice));
+  mlfqs_update_priority (t, NULL);
+}
+
+/* Returns the MLFQS priority for T,
+   PRI_MAX - (recent_cpu / 4) - (nice * 2),
+   clamped to the range PRI_MIN...PRI_MAX. */
+static int
+mlfqs_priority (const struct thread *t)
+{
+  int priority = fix_trunc (fix_sub (fix_int (PRI_MAX - t->nice * 2),
+                                     fix_unscale (t->recent_cpu, 4)));
+  if (priority < PRI_MIN)
+    return PRI_MIN;
+  else if (priority > PRI_MAX)
+    return PRI_MAX;
+  else
+    return priority;
+}
+
+/* Recalculates T's priority from its recent_cpu and nice values,
+   moving T to its new run queue if it is ready.  Interrupts must
+   be off. */
+static void
+mlfqs_update_priority (struct thread *t, void *aux UNUSED)
+{
+  if (!is_idle_thread (t))
+    change_priority (t, mlfqs_priority (t));
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
 
-   The idle thread is initially put on the ready list by
-   thread_start().  It will be scheduled once initially, at which
-   point it initializes idle_thread, "up"s the semaphore passed
-   to it to enable thread_start() to continue, and immediately
-   blocks.  After that, the idle thread never appears in the
-   ready list.  It is returned by next_thread_to_run() as a
-   special case when the ready list is empty. */
+   The bootstrap processor's idle thread is initially put on the
+   ready list by thread_start().  It will be scheduled once
+   initially, at which point it initializes its CPU's
+   idle_thread, "up"s the semaphore passed to it to enable
+   thread_start() to continue, and immediately blocks.  After
+   that, the idle thread never appears in the ready list.  It is
+   returned by next_thread_to_run() as a special case when the
+   ready list is empty.  Application processors' idle threads
+   are made by thread_create_idle() instead. */
 static void
 idle (void *idle_started_ UNUSED)
 {
   struct semaphore *idle_started = idle_started_;
-  idle_thread = thread_current ();
+  struct thread *cur = thread_current ();
+
+  cur->cpu->idle_thread = cur;
+
+  /* The MLFQS gave us a computed priority in init_thread(), but
+     the idle thread must never outrank another thread. */
+  cur->priority = cur->base_priority = PRI_MIN;
   sema_up (idle_started);
 
+  idle_loop ();
+}
+
+/* Body of each CPU's idle thread. */
+static void
+idle_loop (void)
+{
   for (;;)
     {
       /* Let someone else run. */
       intr_disable ();
       thread_block ();
 
+      /* Let a tickless timer skip ticks until the next event. */
+      timer_idle_enter ();
+
+      /* Let other CPUs into the kernel while we wait.  The
+         interrupt that wakes us takes the kernel lock back. */
+      kernel_lock_exit ();
+
       /* Re-enable interrupts and wait for the next one.
 
          The `sti' instruction disables interrupts until the
@@ -427,6 +1144,13 @@ idle (void *idle_started_ UNUSED)
     }
 }
 
+/* Returns true if T is its CPU's idle thread. */
+static bool
+is_idle_thread (const struct thread *t)
+{
+  return t == t->cpu->idle_thread;
+}
+
 /* Function used as the basis for a kernel thread. */
 static void
 kernel_thread (thread_func *function, void *aux)
@@ -474,17 +1198,33 @@ init_thread (struct thread *t, const char *name, int priority)
   t->status = THREAD_BLOCKED;
   strlcpy (t->name, name, sizeof t->name);
   t->stack = (uint8_t *) t + PGSIZE;
-  t->priority = priority;
+  t->priority = t->base_priority = priority;
+  list_init (&t->held_locks);
+  t->cpu = running_thread ()->cpu;
   t->magic = THREAD_MAGIC;
 
+  /* A new thread inherits its creator's nice and recent_cpu.
+     The initial thread, which is its own creator, starts with
+     both at zero. */
+  t->nice = running_thread ()->nice;
+  t->recent_cpu = running_thread ()->recent_cpu;
+  if (thread_mlfqs)
+    t->priority = mlfqs_priority (t);
+
+  /* Likewise for tickets, except that the initial thread starts
+     with the default.  The pass is set when T is first made
+     ready. */
+  t->tickets = (t != running_thread () ? running_thread ()->tickets
+                : TICKETS_DEFAULT);
+
 #ifdef USERPROG
-  list_init(&t->children);
-  list_init(&t->file_list);
-  t->next_fd = 2;
+  t->process = NULL;
+  t->uthread = NULL;
+  list_init (&t->children);
 #endif
 
   old_level = intr_disable ();
-  list_push_back (&all_list, &t->allelem);
+  rcu_list_push_back (&all_list, &t->allelem);
   intr_set_level (old_level);
 }
 
@@ -501,18 +1241,356 @@ alloc_frame (struct thread *t, size_t size)
   return t->stack;
 }
 
-/* Chooses and returns the next thread to be scheduled.  Should
-   return a thread from the run queue, unless the run queue is
-   empty.  (If the running thread can continue running, then it
-   will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
-static struct thread *
-next_thread_to_run (void)
+/* Returns the index of the most significant set bit in X, which
+   must be nonzero.  Uses BSR, which only scans 32 bits at a
+   time.  See [IA32-v2a] "BSR--Bit Scan Reverse". */
+static inline int
+bit_scan_reverse (uint64_t x)
+{
+  uint32_t hi = x >> 32;
+  uint32_t lo = x;
+  uint32_t idx;
+
+  ASSERT (x != 0);
+  if (hi != 0)
+    {
+      asm ("bsrl %1, %0" : "=r" (idx) : "rm" (hi));
+      return idx + 32;
+    }
+  asm ("bsrl %1, %0" : "=r" (idx) : "rm" (lo));
+  return idx;
+}
+
+/* Returns true if T may run on a CPU other than CPU 0.  Only
+   user processes may, because a kernel thread could busy-wait
+   for an interrupt that only CPU 0 receives while holding the
+   kernel lock (see smp.c), and even then not in the deadline
+   class, whose admission control counts on one CPU. */
+static bool
+thread_may_migrate (const struct thread *t UNUSED)
 {
-  if (list_empty (&ready_list))
-    return idle_thread;
+#ifdef USERPROG
+  return t->pagedir != NULL && !t->dl;
+#else
+  return false;
+#endif
+}
+
+/* Adds T to the back of the run queue for its priority on the
+   CPU it last ran on, or for a deadline thread, to that CPU's
+   deadline_queue in order of deadline.  Under the stride
+   scheduler, adds T to that CPU's stride_heap instead, first
+   bringing its pass up to the CPU's stride_pass.  Interrupts
+   must be off. */
+static void
+ready_push (struct thread *t)
+{
+  struct cpu *cpu;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+  if (!thread_may_migrate (t))
+    t->cpu = &cpus[0];
+  cpu = t->cpu;
+  if (t->dl)
+    list_insert_ordered (&cpu->deadline_queue, &t->elem, deadline_less, NULL);
+  else if (thread_stride)
+    {
+      if (t->pass < cpu->stride_pass)
+        t->pass = cpu->stride_pass;
+      heap_push (&cpu->stride_heap, &t->stride_elem);
+    }
   else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+    {
+      list_push_back (&cpu->ready_queues[t->priority], &t->elem);
+      cpu->ready_bitmap |= (uint64_t) 1 << t->priority;
+    }
+  cpu->ready_cnt++;
+}
+
+/* Removes ready thread T from its run queue.  Interrupts must be
+   off.  A heap only gives up its least element, so under the
+   stride scheduler T must be a deadline thread. */
+static void
+ready_remove (struct thread *t)
+{
+  struct cpu *cpu = t->cpu;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->status == THREAD_READY);
+  ASSERT (t->dl || !thread_stride);
+
+  list_remove (&t->elem);
+  if (!t->dl && list_empty (&cpu->ready_queues[t->priority]))
+    cpu->ready_bitmap &= ~((uint64_t) 1 << t->priority);
+  cpu->ready_cnt--;
+}
+
+/* Returns true if the thread that the running CPU's run queue
+   would run next outranks T. */
+static bool
+ready_outranks (const struct thread *t)
+{
+  enum intr_level old_level = intr_disable ();
+  struct cpu *cpu = running_thread ()->cpu;
+  bool outranks;
+
+  if (!list_empty (&cpu->deadline_queue))
+    outranks = thread_outranks (list_entry (list_front (&cpu->deadline_queue),
+                                            struct thread, elem), t);
+  else if (thread_stride)
+    outranks = (!heap_empty (&cpu->stride_heap)
+                && thread_outranks (heap_entry (heap_top (&cpu->stride_heap),
+                                                struct thread, stride_elem),
+                                    t));
+  else
+    outranks = (!t->dl && cpu->ready_bitmap != 0
+                && bit_scan_reverse (cpu->ready_bitmap) > t->priority);
+  intr_set_level (old_level);
+  return outranks;
+}
+
+/* Returns true if thread A should run in preference to thread B:
+   if only A is in the deadline class, if both are and A's
+   deadline is earlier, or if neither is and A has the higher
+   priority, or under the stride scheduler, if B is idle or A has
+   the smaller pass. */
+static bool
+thread_outranks (const struct thread *a, const struct thread *b)
+{
+  if (a->dl != b->dl)
+    return a->dl;
+  else if (a->dl)
+    return a->dl_deadline < b->dl_deadline;
+  else if (thread_stride)
+    return is_idle_thread (b) || a->pass < b->pass;
+  else
+    return a->priority > b->priority;
+}
+
+/* Returns the number of threads that are ready or running,
+   not counting idle threads.  Interrupts must be off. */
+static int
+ready_thread_cnt (void)
+{
+  int cnt = 0;
+  int i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (i = 0; i < smp_cpu_cnt; i++)
+    cnt += cpus[i].ready_cnt + !is_idle_thread (cpus[i].current);
+  return cnt;
+}
+
+/* Chooses and returns the next thread to be scheduled on CPU.
+   Should return a thread from CPU's run queue, unless the run
+   queue is empty.  (If the running thread can continue running,
+   then it will be in the run queue.)  If the run queue is empty,
+   return CPU's idle thread.
+
+   A deadline thread, the one with the earliest deadline, comes
+   first.  Otherwise, the front thread of the highest nonempty
+   priority queue is chosen, so threads of equal priority run
+   round-robin.  This takes constant time regardless of the
+   number of ready threads.  With more than one CPU, though, a
+   thread of higher priority in another CPU's run queue is stolen
+   instead.  Under the stride scheduler, the thread with the
+   least pass is chosen, in logarithmic time, and a thread is
+   stolen only if CPU would otherwise go idle. */
+static struct thread *
+next_thread_to_run (struct cpu *cpu)
+{
+  struct list *queue;
+  struct thread *t;
+  int pri;
+
+  if (!list_empty (&cpu->deadline_queue))
+    {
+      cpu->ready_cnt--;
+      return list_entry (list_pop_front (&cpu->deadline_queue),
+                         struct thread, elem);
+    }
+
+  if (thread_stride)
+    {
+      if (!heap_empty (&cpu->stride_heap))
+        return stride_pop (cpu);
+      t = smp_cpu_cnt > 1 ? stride_steal (cpu) : NULL;
+      return t != NULL ? t : cpu->idle_thread;
+    }
+
+  pri = cpu->ready_bitmap != 0 ? bit_scan_reverse (cpu->ready_bitmap) : -1;
+  if (smp_cpu_cnt > 1)
+    {
+      t = steal_thread (cpu, pri);
+      if (t != NULL)
+        return t;
+    }
+  if (pri < 0)
+    return cpu->idle_thread;
+
+  queue = &cpu->ready_queues[pri];
+  t = list_entry (list_pop_front (queue), struct thread, elem);
+  if (list_empty (queue))
+    cpu->ready_bitmap &= ~((uint64_t) 1 << pri);
+  cpu->ready_cnt--;
+  return t;
+}
+
+/* Looks in the other CPUs' run queues for a thread that may
+   migrate to CPU and has priority greater than MIN_PRIORITY.  If
+   there is one, removes the highest-priority one (the first in
+   its queue, among equals) from its run queue and returns it.
+   Otherwise returns a null pointer.  Interrupts must be off.
+
+   This is linear in the number of CPUs and, because threads that
+   may not migrate are skipped over, in the number of ready
+   threads in the worst case, but an idle CPU has nothing better
+   to do. */
+static struct thread *
+steal_thread (struct cpu *cpu, int min_priority)
+{
+  struct thread *best = NULL;
+  int i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (i = 0; i < smp_cpu_cnt; i++)
+    {
+      struct cpu *victim = &cpus[i];
+      uint64_t bitmap = victim->ready_bitmap;
+
+      if (victim == cpu)
+        continue;
+      while (bitmap != 0)
+        {
+          int pri = bit_scan_reverse (bitmap);
+          struct list *queue = &victim->ready_queues[pri];
+          struct list_elem *e;
+
+          if (pri <= min_priority)
+            break;
+          for (e = list_begin (queue); e != list_end (queue);
+               e = list_next (e))
+            {
+              struct thread *t = list_entry (e, struct thread, elem);
+              if (thread_may_migrate (t))
+                {
+                  best = t;
+                  min_priority = pri;
+                  break;
+                }
+            }
+          bitmap &= ~((uint64_t) 1 << pri);
+        }
+    }
+
+  if (best != NULL)
+    {
+      ready_remove (best);
+      cpu->steal_cnt++;
+    }
+  return best;
+}
+
+/* Returns true if thread A's pass is less than thread B's.  Used
+   to order the stride run queues. */
+static bool
+stride_less (const struct heap_elem *a_, const struct heap_elem *b_,
+             void *aux UNUSED)
+{
+  const struct thread *a = heap_entry (a_, struct thread, stride_elem);
+  const struct thread *b = heap_entry (b_, struct thread, stride_elem);
+
+  return a->pass < b->pass;
+}
+
+/* Removes the thread with the least pass from CPU's nonempty
+   stride_heap, advances CPU's stride_pass to its pass, and
+   returns it.  Interrupts must be off. */
+static struct thread *
+stride_pop (struct cpu *cpu)
+{
+  struct thread *t = heap_entry (heap_pop (&cpu->stride_heap),
+                                 struct thread, stride_elem);
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  cpu->ready_cnt--;
+  if (t->pass > cpu->stride_pass)
+    cpu->stride_pass = t->pass;
+  return t;
+}
+
+/* Looks in the other CPUs' stride run queues for one whose next
+   thread may migrate to CPU.  If there is one, removes that
+   thread from it and returns it, with its pass moved from the
+   other CPU's virtual time to CPU's, so that it keeps its place
+   relative to the other threads.  Otherwise returns a null
+   pointer.  Only the least thread of each queue is considered,
+   so this takes time linear in the number of CPUs.  Interrupts
+   must be off. */
+static struct thread *
+stride_steal (struct cpu *cpu)
+{
+  int i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (i = 0; i < smp_cpu_cnt; i++)
+    {
+      struct cpu *victim = &cpus[i];
+      struct thread *t;
+      int64_t lag;
+
+      if (victim == cpu || heap_empty (&victim->stride_heap))
+        continue;
+      t = heap_entry (heap_top (&victim->stride_heap),
+                      struct thread, stride_elem);
+      if (!thread_may_migrate (t))
+        continue;
+
+      lag = t->pass - victim->stride_pass;
+      stride_pop (victim);
+      t->pass = cpu->stride_pass + lag;
+      if (t->pass > cpu->stride_pass)
+        cpu->stride_pass = t->pass;
+      cpu->steal_cnt++;
+      return t;
+    }
+  return NULL;
+}
+
+/* Called when T, which is in a run queue, has just become
+   ready.  If another CPU should run T now, interrupts it to
+   reschedule: preferably an idle CPU, if T may migrate,
+   otherwise T's own CPU, if T outranks the thread running
+   there.  The running CPU takes care of itself through
+   thread_preempt().  Interrupts must be off. */
+static void
+kick_cpu (struct thread *t)
+{
+  struct cpu *self = running_thread ()->cpu;
+  struct cpu *target = NULL;
+  int i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (thread_may_migrate (t))
+    for (i = 0; i < smp_cpu_cnt; i++)
+      if (&cpus[i] != self && is_idle_thread (cpus[i].current))
+        {
+          target = &cpus[i];
+          break;
+        }
+  if (target == NULL && t->cpu != self
+      && thread_outranks (t, t->cpu->current))
+    target = t->cpu;
+
+  if (target != NULL)
+    smp_resched (target);
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -540,9 +1618,15 @@ thread_schedule_tail (struct thread *prev)
 
   /* Mark us as running. */
   cur->status = THREAD_RUNNING;
+  cur->cpu->current = cur;
 
   /* Start new time slice. */
-  thread_ticks = 0;
+  cur->cpu->thread_ticks = 0;
+  if (prev != NULL && is_idle_thread (prev))
+    timer_idle_exit ();
+
+  /* A thread switch is a quiescent state for RCU. */
+  rcu_quiescent ();
 
 #ifdef USERPROG
   /* Activate the new address space. */
@@ -551,13 +1635,14 @@ thread_schedule_tail (struct thread *prev)
 
   /* If the thread we switched from is dying, destroy its struct
      thread.  This must happen late so that thread_exit() doesn't
-     pull out the rug under itself.  (We don't free
-     initial_thread because its memory was not obtained via
-     palloc().) */
+     pull out the rug under itself, and only after a grace period,
+     because a thread_foreach() caller may still be looking at it.
+     (We don't free initial_thread because its memory was not
+     obtained via palloc().) */
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread)
     {
       ASSERT (prev != cur);
-      palloc_free_page (prev);
+      call_rcu (&prev->rcu, free_dead_thread);
     }
 }
 
@@ -572,28 +1657,141 @@ static void
 schedule (void)
 {
   struct thread *cur = running_thread ();
-  struct thread *next = next_thread_to_run ();
+  struct thread *next = next_thread_to_run (cur->cpu);
   struct thread *prev = NULL;
 
   ASSERT (intr_get_level () == INTR_OFF);
   ASSERT (cur->status != THREAD_RUNNING);
+  ASSERT (cur->preempt_off == 0);
   ASSERT (is_thread (next));
 
+  next->cpu = cur->cpu;
   if (cur != next)
-    prev = switch_threads (cur, next);
+    {
+      TRACE (TRACE_SCHEDULE, cur->tid, next->tid, 0);
+      prev = switch_threads (cur, next);
+    }
   thread_schedule_tail (prev);
 }
 
+/* Returns a page for a new thread, from the cache if possible,
+   or a null pointer if memory is exhausted.  The caller must
+   initialize it with init_thread(). */
+static struct thread *
+alloc_thread_page (void)
+{
+  enum intr_level old_level;
+  struct thread *t = NULL;
+
+  old_level = spin_lock_irqsave (&thread_cache_lock);
+  if (!list_empty (&page_cache))
+    {
+      t = (struct thread *) list_pop_front (&page_cache);
+      page_cache_cnt--;
+      page_cache_hits++;
+    }
+  else
+    page_cache_misses++;
+  spin_unlock_irqrestore (&thread_cache_lock, old_level);
+
+  if (t == NULL)
+    t = palloc_get_page (0);
+  return t;
+}
+
+/* Frees dead thread T's page, or keeps it in the cache. */
+static void
+free_thread_page (struct thread *t)
+{
+  enum intr_level old_level;
+  bool cached = false;
+
+  old_level = spin_lock_irqsave (&thread_cache_lock);
+  if (page_cache_cnt < THREAD_CACHE_MAX)
+    {
+      /* Reuse the start of the page as a list element. */
+      list_push_front (&page_cache, (struct list_elem *) t);
+      page_cache_cnt++;
+      cached = true;
+    }
+  spin_unlock_irqrestore (&thread_cache_lock, old_level);
+
+  if (!cached)
+    palloc_free_page (t);
+}
+
+/* Frees the page of a thread that has exited, once no
+   thread_foreach() caller can still be looking at it.  Used as an
+   RCU callback. */
+static void
+free_dead_thread (struct rcu_head *head)
+{
+  free_thread_page (rcu_entry (head, struct thread, rcu));
+}
+
+#ifdef USERPROG
+/* Returns a childProc record with one reference, from the cache
+   if possible, or a null pointer if memory is exhausted. */
+struct childProc *
+child_proc_alloc (void)
+{
+  enum intr_level old_level;
+  struct childProc *cp = NULL;
+
+  old_level = spin_lock_irqsave (&thread_cache_lock);
+  if (!list_empty (&proc_cache))
+    {
+      cp = list_entry (list_pop_front (&proc_cache), struct childProc, elem);
+      proc_cache_cnt--;
+      proc_cache_hits++;
+    }
+  else
+    proc_cache_misses++;
+  spin_unlock_irqrestore (&thread_cache_lock, old_level);
+
+  if (cp == NULL)
+    cp = malloc (sizeof *cp);
+  if (cp != NULL)
+    cp->ref_cnt = 1;
+  return cp;
+}
+
+/* Drops a reference to childProc record CP.  A parent and its
+   child process each hold one, so that whichever of them is done
+   with CP last frees it, or keeps it in the cache.  By then CP
+   must not be in any list. */
+void
+child_proc_free (struct childProc *cp)
+{
+  enum intr_level old_level;
+  bool last, cached = false;
+
+  old_level = spin_lock_irqsave (&thread_cache_lock);
+  last = --cp->ref_cnt == 0;
+  if (last && proc_cache_cnt < THREAD_CACHE_MAX)
+    {
+      list_push_front (&proc_cache, &cp->elem);
+      proc_cache_cnt++;
+      cached = true;
+    }
+  spin_unlock_irqrestore (&thread_cache_lock, old_level);
+
+  if (last && !cached)
+    free (cp);
+}
+#endif
+
 /* Returns a tid to use for a new thread. */
 static tid_t
 allocate_tid (void)
 {
   static tid_t next_tid = 1;
+  enum intr_level old_level;
   tid_t tid;
 
-  lock_acquire (&tid_lock);
+  old_level = spin_lock_irqsave (&tid_lock);
   tid = next_tid++;
-  lock_release (&tid_lock);
+  spin_unlock_irqrestore (&tid_lock, old_level);
 
   return tid;
 }
@@ -601,19 +1799,3 @@ allocate_tid (void)
 /* Offset of `stack' member within `struct thread'.
    Used by switch.S, which can't figure it out on its own. */
 uint32_t thread_stack_ofs = offsetof (struct thread, stack);
-
-struct childProc *get_child_process(pid_t pid)
-{
-  struct thread *cur = thread_current();
-  struct list *list = &cur->children;
-  struct list_elem *e = list_head(list);
-  while((e = list_next(e)) != list_tail(list))
-  {
-    struct childProc *cp = list_entry (e, struct childProc, elem);
-    if(cp->pid == pid)
-    {
-      return cp;
-    }
-  }
-  return NULL;
-}
\ No newline at end of file
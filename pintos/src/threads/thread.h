@@ -2,8 +2,10 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <heap.h>
 #include <list.h>
 #include <stdint.h>
+#include "threads/rcu.h"
 #include "threads/synch.h"
 #include "threads/fixed-point.h"
 
@@ -27,6 +29,11 @@ typedef int pid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Ticket counts, for the stride scheduler. */
+#define TICKETS_MIN 1                   /* Smallest share. */
+#define TICKETS_DEFAULT 100             /* Default share. */
+#define TICKETS_MAX 10000               /* Largest share. */
+
 /* A kernel thread or user process.
 
    Each thread structure is stored in its own 4 kB page.  The
@@ -90,20 +97,47 @@ struct thread
     enum thread_status status;          /* Thread state. */
     char name[16];                      /* Name (for debugging purposes). */
     uint8_t *stack;                     /* Saved stack pointer. */
-    int priority;                       /* Priority. */
+    int priority;                       /* Effective priority. */
+    int base_priority;                  /* Priority before donation. */
+    int nice;                           /* Niceness, for the MLFQS. */
+    fixed_point_t recent_cpu;           /* Recent CPU time, for the MLFQS. */
+    int tickets;                        /* CPU share, for the stride scheduler. */
+    int64_t pass;                       /* Virtual time, for the stride scheduler. */
+    struct heap_elem stride_elem;       /* Heap element for stride run queue. */
+    bool dl;                            /* In the deadline class? */
+    bool dl_throttled;                  /* Used up its budget? */
+    bool dl_missed;                     /* Current job missed its deadline? */
+    int64_t dl_runtime;                 /* Budget per period, in ticks. */
+    int64_t dl_rel_deadline;            /* Deadline after release, in ticks. */
+    int64_t dl_period;                  /* Period, in ticks. */
+    int64_t dl_release;                 /* Current job's release tick. */
+    int64_t dl_deadline;                /* Current job's deadline tick. */
+    int64_t dl_budget;                  /* Ticks left in current job. */
+    struct cpu *cpu;                    /* CPU it runs or last ran on. */
     struct list_elem allelem;           /* List element for all threads list. */
+    int preempt_off;                    /* Preemption disabled if nonzero. */
+    bool preempt_pending;               /* Yield put off by preempt_off? */
+    struct rcu_head rcu;                /* Frees page after thread exits. */
 
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
+    struct list held_locks;             /* Locks held, for donation. */
+    struct lock *waiting_lock;          /* Lock being waited for, if any. */
+    struct rw_hold rw_holds[RW_HOLD_MAX]; /* Rwlocks held, for donation. */
+
+    /* Owned by devices/timer.c. */
+    int64_t wake_time;                  /* When to wake up, in ns since boot. */
+    struct list_elem sleepelem;         /* List element for sleep list. */
+    bool timed_wait;                    /* In sleep_list for a timed wait? */
+    bool timed_out;                     /* Timed wait ran out of time? */
 
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
-    struct childProc *proc;
-    struct list children;
-    struct list file_list;
-    int next_fd;
-    struct dir *wd;                     /* Working directory. */
+    struct process *process;            /* Process, null if kernel thread. */
+    struct uthread *uthread;            /* Set if made by thread_spawn(). */
+    struct list children;               /* A kernel thread's children. */
+    void *user_esp;                     /* User esp at last system call. */
 #endif
 
     /* Owned by thread.c. */
@@ -113,25 +147,39 @@ struct thread
 struct childProc
   {
     pid_t pid;
-    struct file *exe;
     bool loaded;
     struct list_elem elem;
     struct semaphore sema;
     int exit_status;
+    int ref_cnt;                /* Parent and child, while alive. */
   };
 
-struct childProc *get_child_process(pid_t pid);
+#ifdef USERPROG
+struct childProc *child_proc_alloc (void);
+void child_proc_free (struct childProc *);
+void thread_set_process (struct process *);
+#endif
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* If true, use the stride scheduler, which ignores priorities
+   and divides the CPU among threads in proportion to their
+   tickets.  Controlled by kernel command-line option
+   "-o stride". */
+extern bool thread_stride;
+
 void thread_init (void);
 void thread_start (void);
 
+struct thread *thread_create_idle (struct cpu *);
+void thread_start_ap (void) NO_RETURN;
+
 void thread_tick (void);
 void thread_print_stats (void);
+long long thread_idle_ticks (void);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
@@ -145,6 +193,9 @@ const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
+void thread_preempt (void);
+void thread_preempt_disable (void);
+void thread_preempt_enable (void);
 
 /* Performs some operation on thread t, given auxiliary data AUX. */
 typedef void thread_action_func (struct thread *t, void *aux);
@@ -152,10 +203,18 @@ void thread_foreach (thread_action_func *, void *);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
+void thread_refresh_priority (struct thread *);
+
+bool thread_set_deadline (int64_t runtime, int64_t deadline, int64_t period);
+void thread_clear_deadline (void);
+bool thread_deadline_yield (void);
 
 int thread_get_nice (void);
 void thread_set_nice (int);
 int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
 
+int thread_get_tickets (void);
+void thread_set_tickets (int);
+
 #endif /* threads/thread.h */
\ No newline at end of file
@@ -0,0 +1,269 @@
+#include "threads/trace.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/smp.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "devices/block.h"
+#include "devices/timer.h"
+
+/* Dump format.
+
+   A dump is one BLOCK_SECTOR_SIZE-byte header sector, which
+   begins with a struct trace_header followed by the event
+   names, then the entries, oldest first.  Each event name is a
+   null-terminated string of the form "NAME:ARG,ARG,...", which
+   names the event's arguments in order, so that the decoder
+   needs no list of its own.
+
+   On the console, each line of the dump is "trace: " followed
+   by up to 32 bytes in hex: 16 lines for the header sector,
+   then one line per entry.  On the scratch device, the dump
+   starts at sector 0. */
+
+/* Magic number that begins a dump. */
+#define TRACE_MAGIC "PINTRACE"
+
+/* Dump header. */
+struct trace_header
+  {
+    char magic[8];              /* TRACE_MAGIC, without null. */
+    uint32_t version;           /* Format version, 1. */
+    uint32_t entry_size;        /* sizeof (struct trace_entry). */
+    uint32_t entry_cnt;         /* Number of entries in the dump. */
+    uint32_t lost_cnt;          /* Number of entries overwritten. */
+    uint64_t start_tsc;         /* Time stamp counter at trace_init(). */
+    int64_t start_ns;           /* timer_ns() at trace_init(). */
+    uint64_t end_tsc;           /* Time stamp counter at trace_dump(). */
+    int64_t end_ns;             /* timer_ns() at trace_dump(). */
+    uint32_t event_cnt;         /* Number of event names. */
+  };
+
+/* Names of the events and their arguments. */
+static const char *event_names[TRACE_EVENT_CNT] =
+  {
+    [TRACE_SCHEDULE] = "schedule:prev,next",
+    [TRACE_THREAD_BLOCK] = "thread_block:caller",
+    [TRACE_THREAD_UNBLOCK] = "thread_unblock:tid",
+    [TRACE_INTR_ENTER] = "intr_enter:vec,eip",
+    [TRACE_INTR_EXIT] = "intr_exit:vec",
+    [TRACE_BLOCK_READ] = "block_read:sector,type",
+    [TRACE_BLOCK_WRITE] = "block_write:sector,type",
+    [TRACE_CACHE_HIT] = "cache_hit:sector",
+    [TRACE_CACHE_MISS] = "cache_miss:sector",
+    [TRACE_CACHE_EVICT] = "cache_evict:sector,dirty",
+    [TRACE_SYSCALL_ENTER] = "syscall_enter:nr,eip",
+    [TRACE_SYSCALL_EXIT] = "syscall_exit:nr,result",
+    [TRACE_PAGE_FAULT] = "page_fault:addr,eip,error",
+  };
+
+/* Number of pages in the ring buffer. */
+#define TRACE_PAGES \
+        DIV_ROUND_UP (TRACE_ENTRY_CNT * sizeof (struct trace_entry), PGSIZE)
+
+bool trace_enabled;
+bool trace_to_scratch;
+
+/* Ring buffer.  Entry number SEQ goes into
+   entries[SEQ % TRACE_ENTRY_CNT]. */
+static struct trace_entry *entries;
+
+/* Sequence number of the next entry. */
+static uint32_t next_seq;
+
+/* Time stamp counter and time when tracing started. */
+static uint64_t start_tsc;
+static int64_t start_ns;
+
+/* Sector being written by the dump. */
+static uint8_t sector_buf[BLOCK_SECTOR_SIZE];
+
+static void make_header (uint8_t *, uint32_t entry_cnt, uint32_t lost_cnt);
+static void dump_console (uint32_t first, uint32_t last);
+static void dump_scratch (struct block *, uint32_t first, uint32_t last);
+static void print_hex_line (const void *, size_t);
+
+/* Returns the current value of the time stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Allocates the ring buffer and starts tracing.  Called after
+   palloc_init() if the "-trace" option was given. */
+void
+trace_init (void)
+{
+  entries = palloc_get_multiple (PAL_ZERO, TRACE_PAGES);
+  if (entries == NULL)
+    {
+      printf ("trace: out of memory, tracing disabled\n");
+      return;
+    }
+  start_tsc = rdtsc ();
+  start_ns = timer_ns ();
+  barrier ();
+  trace_enabled = true;
+}
+
+/* Records EVENT with arguments ARG0, ARG1, and ARG2.  Use the
+   TRACE macro instead, which skips the call when tracing is off.
+
+   Claims its entry with an atomic increment, so it neither turns
+   off interrupts nor takes a lock, and may be called from any
+   context on any CPU. */
+void
+trace_record (enum trace_event event, uint32_t arg0, uint32_t arg1,
+              uint32_t arg2)
+{
+  uint32_t seq = __sync_fetch_and_add (&next_seq, 1);
+  struct trace_entry *e = &entries[seq % TRACE_ENTRY_CNT];
+  struct thread *t;
+
+  /* Like thread_current(), but without its assertions, since
+     some tracepoints run in the middle of a thread switch. */
+  asm ("mov %%esp, %0" : "=g" (t));
+  t = pg_round_down (t);
+
+  e->tsc = rdtsc ();
+  e->seq = seq;
+  e->tid = t->tid;
+  e->event = event;
+  e->cpu = t->cpu != NULL ? t->cpu->id : 0;
+  e->flags = intr_context () ? TRACE_F_INTR : 0;
+  e->arg[0] = arg0;
+  e->arg[1] = arg1;
+  e->arg[2] = arg2;
+}
+
+/* Stops tracing and writes out the ring buffer, to the scratch
+   device if "-trace=scratch" was given and there is one, and to
+   the console otherwise.  Called at power off. */
+void
+trace_dump (void)
+{
+  uint32_t first, last;
+  struct block *scratch;
+
+  if (!trace_enabled)
+    return;
+  trace_enabled = false;
+  barrier ();
+
+  last = next_seq;
+  first = last > TRACE_ENTRY_CNT ? last - TRACE_ENTRY_CNT : 0;
+
+  scratch = trace_to_scratch ? block_get_role (BLOCK_SCRATCH) : NULL;
+  if (scratch != NULL)
+    {
+      /* Keep the newest entries that fit. */
+      uint32_t max_cnt = ((block_size (scratch) - 1)
+                          * (BLOCK_SECTOR_SIZE / sizeof (struct trace_entry)));
+      if (last - first > max_cnt)
+        first = last - max_cnt;
+      dump_scratch (scratch, first, last);
+    }
+  else
+    {
+      if (trace_to_scratch)
+        printf ("trace: no scratch device, dumping to console\n");
+      dump_console (first, last);
+    }
+  printf ("Trace: %"PRIu32" events, %"PRIu32" kept, dumped to %s\n",
+          last, last - first, scratch != NULL ? block_name (scratch)
+          : "console");
+}
+
+/* Fills in BUF, which must be BLOCK_SECTOR_SIZE bytes, with a
+   header sector for a dump of ENTRY_CNT entries, after LOST_CNT
+   entries that were overwritten or left out. */
+static void
+make_header (uint8_t *buf, uint32_t entry_cnt, uint32_t lost_cnt)
+{
+  struct trace_header *h = (struct trace_header *) buf;
+  size_t ofs = sizeof *h;
+  int i;
+
+  memset (buf, 0, BLOCK_SECTOR_SIZE);
+  memcpy (h->magic, TRACE_MAGIC, sizeof h->magic);
+  h->version = 1;
+  h->entry_size = sizeof (struct trace_entry);
+  h->entry_cnt = entry_cnt;
+  h->lost_cnt = lost_cnt;
+  h->start_tsc = start_tsc;
+  h->start_ns = start_ns;
+  h->end_tsc = rdtsc ();
+  h->end_ns = timer_ns ();
+  h->event_cnt = TRACE_EVENT_CNT;
+  for (i = 0; i < TRACE_EVENT_CNT; i++)
+    {
+      size_t len = strlen (event_names[i]) + 1;
+      ASSERT (ofs + len <= BLOCK_SECTOR_SIZE);
+      memcpy (buf + ofs, event_names[i], len);
+      ofs += len;
+    }
+}
+
+/* Prints entries FIRST up to but not including LAST to the
+   console. */
+static void
+dump_console (uint32_t first, uint32_t last)
+{
+  uint32_t seq;
+  size_t ofs;
+
+  make_header (sector_buf, last - first, first);
+  for (ofs = 0; ofs < BLOCK_SECTOR_SIZE; ofs += 32)
+    print_hex_line (sector_buf + ofs, 32);
+  for (seq = first; seq != last; seq++)
+    print_hex_line (&entries[seq % TRACE_ENTRY_CNT],
+                    sizeof (struct trace_entry));
+}
+
+/* Writes entries FIRST up to but not including LAST to SCRATCH,
+   which must be big enough. */
+static void
+dump_scratch (struct block *scratch, uint32_t first, uint32_t last)
+{
+  const size_t per_sector = BLOCK_SECTOR_SIZE / sizeof (struct trace_entry);
+  block_sector_t sector;
+  uint32_t seq;
+
+  make_header (sector_buf, last - first, first);
+  block_write (scratch, 0, sector_buf);
+  sector = 1;
+  for (seq = first; seq != last; )
+    {
+      size_t i;
+
+      memset (sector_buf, 0, BLOCK_SECTOR_SIZE);
+      for (i = 0; i < per_sector && seq != last; i++, seq++)
+        memcpy (sector_buf + i * sizeof (struct trace_entry),
+                &entries[seq % TRACE_ENTRY_CNT],
+                sizeof (struct trace_entry));
+      block_write (scratch, sector++, sector_buf);
+    }
+}
+
+/* Prints the SIZE bytes at P as one line of the console dump. */
+static void
+print_hex_line (const void *p_, size_t size)
+{
+  const uint8_t *p = p_;
+  char line[80];
+  size_t i;
+
+  ASSERT (size <= 32);
+  for (i = 0; i < size; i++)
+    snprintf (line + i * 2, 3, "%02x", p[i]);
+  line[size * 2] = '\0';
+  printf ("trace: %s\n", line);
+}
@@ -0,0 +1,84 @@
+#ifndef THREADS_TRACE_H
+#define THREADS_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Kernel tracing.
+
+   Static tracepoints throughout the kernel record fixed-size,
+   time-stamped events into a ring buffer in memory, where they
+   cost a few dozen cycles each instead of the milliseconds that
+   a printf() to the serial port takes.  The buffer keeps the
+   most recent TRACE_ENTRY_CNT events of the boot.  At power
+   off, trace_dump() writes it out, either to the console as hex
+   or raw to the scratch block device, and utils/trace-decode
+   turns the dump into a timeline.
+
+   Tracing is off unless the "-trace" kernel command-line option
+   is given.  While it is off, a tracepoint costs one load and
+   one well-predicted branch. */
+
+/* Traced events.  The arguments of each are listed in
+   event_names[] in trace.c. */
+enum trace_event
+  {
+    TRACE_SCHEDULE,             /* Thread switch. */
+    TRACE_THREAD_BLOCK,         /* Running thread blocks. */
+    TRACE_THREAD_UNBLOCK,       /* Blocked thread made ready. */
+    TRACE_INTR_ENTER,           /* Interrupt handler entry. */
+    TRACE_INTR_EXIT,            /* Interrupt handler exit. */
+    TRACE_BLOCK_READ,           /* Block device sector read. */
+    TRACE_BLOCK_WRITE,          /* Block device sector write. */
+    TRACE_CACHE_HIT,            /* Buffer cache hit. */
+    TRACE_CACHE_MISS,           /* Buffer cache miss. */
+    TRACE_CACHE_EVICT,          /* Buffer cache eviction. */
+    TRACE_SYSCALL_ENTER,        /* System call entry. */
+    TRACE_SYSCALL_EXIT,         /* System call exit. */
+    TRACE_PAGE_FAULT,           /* Page fault. */
+    TRACE_EVENT_CNT             /* Number of events. */
+  };
+
+/* One traced event.  The dump holds these exactly as they are
+   laid out here, in the byte order of the x86. */
+struct trace_entry
+  {
+    uint64_t tsc;               /* Time stamp counter. */
+    uint32_t seq;               /* Sequence number since boot. */
+    int32_t tid;                /* Running thread. */
+    uint8_t event;              /* One of enum trace_event. */
+    uint8_t cpu;                /* Running CPU. */
+    uint16_t flags;             /* TRACE_F_* flags. */
+    uint32_t arg[3];            /* Event-specific arguments. */
+  };
+
+/* trace_entry flags. */
+#define TRACE_F_INTR 0x1        /* In an external interrupt handler. */
+
+/* Number of entries in the ring buffer.  Must be a power of 2. */
+#define TRACE_ENTRY_CNT 4096
+
+/* True while tracing.  Set by trace_init(), which runs if the
+   kernel command-line option "-trace" is given. */
+extern bool trace_enabled;
+
+/* True to dump to the scratch device instead of the console.
+   Set by kernel command-line option "-trace=scratch". */
+extern bool trace_to_scratch;
+
+/* Records EVENT with arguments A0, A1, and A2 if tracing is
+   enabled. */
+#define TRACE(EVENT, A0, A1, A2)                                        \
+        do                                                              \
+          {                                                             \
+            if (__builtin_expect (trace_enabled, 0))                    \
+              trace_record ((EVENT), (uint32_t) (A0), (uint32_t) (A1),  \
+                            (uint32_t) (A2));                           \
+          }                                                             \
+        while (0)
+
+void trace_init (void);
+void trace_record (enum trace_event, uint32_t, uint32_t, uint32_t);
+void trace_dump (void);
+
+#endif /* threads/trace.h */
@@ -0,0 +1,328 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "devices/timer.h"
+
+/* Work queues.
+
+   A work queue lets code hand slow work, such as writing data
+   back to disk, to a pool of kernel threads instead of doing it
+   inline on a latency-critical path such as a system call or an
+   interrupt handler.
+
+   Each queue keeps one FIFO list of pending work per priority.
+   A worker thread takes the oldest work of the highest priority
+   and runs it at that priority.  A semaphore counts queued work,
+   so idle workers sleep in sema_down() until there is some.
+
+   The queues are protected by turning interrupts off, so work
+   may be submitted from interrupt handlers.  Delayed work waits
+   on delayed_list, sorted by the tick at which it is due, until
+   the timer interrupt handler calls workqueue_tick(). */
+
+/* Number of worker threads in system_wq. */
+#define SYSTEM_WQ_WORKERS 2
+
+/* Default work queue. */
+struct workqueue *system_wq;
+
+/* Delayed work of all queues, in order of increasing run_tick.
+   Work with equal run_tick stays in submission order. */
+static struct list delayed_list;
+
+static thread_func worker;
+static void enqueue (struct work *);
+static void finish (struct workqueue *);
+static list_less_func run_tick_less;
+
+/* Initializes the work queue module and creates system_wq.
+   Must be called after thread_start(). */
+void
+workqueue_init (void)
+{
+  list_init (&delayed_list);
+  system_wq = workqueue_create ("events", SYSTEM_WQ_WORKERS);
+  if (system_wq == NULL)
+    PANIC ("could not create system work queue");
+}
+
+/* Creates and returns a work queue named NAME with WORKER_CNT
+   worker threads.  Returns a null pointer if memory allocation
+   fails.  Work queues are never destroyed. */
+struct workqueue *
+workqueue_create (const char *name, int worker_cnt)
+{
+  struct workqueue *wq;
+  int pri, i;
+
+  ASSERT (name != NULL);
+  ASSERT (worker_cnt > 0);
+
+  wq = malloc (sizeof *wq);
+  if (wq == NULL)
+    return NULL;
+
+  wq->name = name;
+  for (pri = PRI_MIN; pri <= PRI_MAX; pri++)
+    list_init (&wq->queues[pri]);
+  sema_init (&wq->work_cnt, 0);
+  wq->busy_cnt = 0;
+  list_init (&wq->flushers);
+
+  for (i = 0; i < worker_cnt; i++)
+    {
+      char worker_name[16];
+
+      snprintf (worker_name, sizeof worker_name, "%s/%d", name, i);
+      if (thread_create (worker_name, PRI_DEFAULT, worker, wq) == TID_ERROR
+          && i == 0)
+        PANIC ("could not start any worker for work queue %s", name);
+    }
+  return wq;
+}
+
+/* Initializes WORK to run FUNC(AUX) at the given PRIORITY when
+   it is submitted to a work queue. */
+void
+work_init (struct work *work, work_func *func, void *aux, int priority)
+{
+  ASSERT (work != NULL);
+  ASSERT (func != NULL);
+  ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+  work->func = func;
+  work->aux = aux;
+  work->priority = priority;
+  work->pending = false;
+  work->wq = NULL;
+  work->run_tick = 0;
+}
+
+/* Queues WORK on WQ, to be run by one of WQ's workers.  Returns
+   true if successful, false if WORK was already pending.
+
+   This function may be called from an interrupt handler. */
+bool
+workqueue_submit (struct workqueue *wq, struct work *work)
+{
+  enum intr_level old_level;
+  bool success = false;
+
+  ASSERT (wq != NULL);
+  ASSERT (work != NULL);
+
+  old_level = intr_disable ();
+  if (!work->pending)
+    {
+      work->pending = true;
+      work->wq = wq;
+      wq->busy_cnt++;
+      enqueue (work);
+      success = true;
+    }
+  intr_set_level (old_level);
+  return success;
+}
+
+/* Queues WORK on WQ once TICKS timer ticks have passed.  Returns
+   true if successful, false if WORK was already pending.
+
+   This function may be called from an interrupt handler. */
+bool
+workqueue_submit_delayed (struct workqueue *wq, struct work *work,
+                          int64_t ticks)
+{
+  enum intr_level old_level;
+  bool success = false;
+
+  ASSERT (wq != NULL);
+  ASSERT (work != NULL);
+
+  if (ticks <= 0)
+    return workqueue_submit (wq, work);
+
+  old_level = intr_disable ();
+  if (!work->pending)
+    {
+      work->pending = true;
+      work->wq = wq;
+      work->run_tick = timer_ticks () + ticks;
+      wq->busy_cnt++;
+      list_insert_ordered (&delayed_list, &work->elem, run_tick_less, NULL);
+      success = true;
+    }
+  intr_set_level (old_level);
+  return success;
+}
+
+/* Removes WORK from its queue if it is pending, so that it will
+   not run.  Returns true if WORK was pending, false if it was
+   not, in which case it may be running now.
+
+   This function may be called from an interrupt handler. */
+bool
+workqueue_cancel (struct work *work)
+{
+  enum intr_level old_level;
+  bool was_pending;
+
+  ASSERT (work != NULL);
+
+  old_level = intr_disable ();
+  was_pending = work->pending;
+  if (was_pending)
+    {
+      list_remove (&work->elem);
+      work->pending = false;
+      if (work->run_tick == 0)
+        sema_try_down (&work->wq->work_cnt);
+      finish (work->wq);
+    }
+  intr_set_level (old_level);
+  return was_pending;
+}
+
+/* Waits until WQ has no queued, delayed, or running work, which
+   means that all the work submitted to WQ before the call has
+   finished.  Work submitted meanwhile also delays the return.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler, or by one of WQ's own workers. */
+void
+workqueue_flush (struct workqueue *wq)
+{
+  enum intr_level old_level;
+
+  ASSERT (wq != NULL);
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable ();
+  if (wq->busy_cnt > 0)
+    {
+      struct thread *cur = thread_current ();
+
+      list_push_back (&wq->flushers, &cur->elem);
+      thread_block ();
+    }
+  intr_set_level (old_level);
+}
+
+/* Queues delayed work that is due by tick NOW.  Called by the
+   timer interrupt handler on each tick. */
+void
+workqueue_tick (int64_t now)
+{
+  ASSERT (intr_context ());
+
+  /* Timer interrupts start before workqueue_init(). */
+  if (system_wq == NULL)
+    return;
+
+  while (!list_empty (&delayed_list))
+    {
+      struct work *work = list_entry (list_front (&delayed_list),
+                                      struct work, elem);
+      if (work->run_tick > now)
+        break;
+      list_pop_front (&delayed_list);
+      enqueue (work);
+    }
+}
+
+/* Returns the tick at which the earliest delayed work is due, or
+   INT64_MAX if there is no delayed work.  Lets a tickless timer
+   know how long it may let the CPU sleep.  Interrupts must be
+   off. */
+int64_t
+workqueue_next_tick (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (system_wq == NULL || list_empty (&delayed_list))
+    return INT64_MAX;
+  return list_entry (list_front (&delayed_list), struct work, elem)->run_tick;
+}
+
+/* Worker thread function, which runs work from work queue WQ_
+   forever. */
+static void
+worker (void *wq_)
+{
+  struct workqueue *wq = wq_;
+
+  for (;;)
+    {
+      enum intr_level old_level;
+      struct work *work = NULL;
+      work_func *func;
+      void *aux;
+      int pri;
+
+      sema_down (&wq->work_cnt);
+
+      old_level = intr_disable ();
+      for (pri = PRI_MAX; pri >= PRI_MIN; pri--)
+        if (!list_empty (&wq->queues[pri]))
+          {
+            work = list_entry (list_pop_front (&wq->queues[pri]),
+                               struct work, elem);
+            break;
+          }
+      if (work == NULL)
+        {
+          /* The work we were woken for was cancelled. */
+          intr_set_level (old_level);
+          continue;
+        }
+      work->pending = false;
+      func = work->func;
+      aux = work->aux;
+      intr_set_level (old_level);
+
+      /* FUNC may free WORK, so do not touch it afterward. */
+      thread_set_priority (pri);
+      func (aux);
+
+      old_level = intr_disable ();
+      finish (wq);
+      intr_set_level (old_level);
+    }
+}
+
+/* Puts WORK on its queue and wakes a worker to run it.
+   Interrupts must be off. */
+static void
+enqueue (struct work *work)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  work->run_tick = 0;
+  list_push_back (&work->wq->queues[work->priority], &work->elem);
+  sema_up (&work->wq->work_cnt);
+}
+
+/* Accounts for one work of WQ having run or been cancelled, and
+   wakes up flushers if WQ is now idle.  Interrupts must be
+   off. */
+static void
+finish (struct workqueue *wq)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (wq->busy_cnt > 0);
+
+  if (--wq->busy_cnt == 0)
+    while (!list_empty (&wq->flushers))
+      thread_unblock (list_entry (list_pop_front (&wq->flushers),
+                                  struct thread, elem));
+}
+
+/* Returns true if delayed work A is due before delayed work B. */
+static bool
+run_tick_less (const struct list_elem *a, const struct list_elem *b,
+               void *aux UNUSED)
+{
+  return (list_entry (a, struct work, elem)->run_tick
+          < list_entry (b, struct work, elem)->run_tick);
+}
@@ -0,0 +1,55 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* A function run by a work queue's worker thread. */
+typedef void work_func (void *aux);
+
+/* A piece of deferred work.
+
+   The submitter owns the struct work, which it typically embeds
+   in a larger structure, and must keep it alive until FUNC has
+   run.  FUNC may free it. */
+struct work
+  {
+    struct list_elem elem;      /* Element in a queue or delayed_list. */
+    work_func *func;            /* Function to run. */
+    void *aux;                  /* Argument to FUNC. */
+    int priority;               /* Priority to run FUNC at. */
+    bool pending;               /* Queued or delayed, not yet run? */
+    struct workqueue *wq;       /* Queue it was submitted to. */
+    int64_t run_tick;           /* For delayed work, when to queue it. */
+  };
+
+/* A work queue: a pool of kernel threads that run submitted work
+   in order of priority, highest first, and in submission order
+   within a priority. */
+struct workqueue
+  {
+    const char *name;           /* Name, for worker thread names. */
+    struct list queues[PRI_MAX + 1]; /* Pending work, by priority. */
+    struct semaphore work_cnt;  /* Number of queued works. */
+    int busy_cnt;               /* Queued, delayed, or running works. */
+    struct list flushers;       /* Threads waiting in workqueue_flush(). */
+  };
+
+/* Default work queue, for work that does not need its own. */
+extern struct workqueue *system_wq;
+
+void workqueue_init (void);
+struct workqueue *workqueue_create (const char *name, int worker_cnt);
+void work_init (struct work *, work_func *, void *aux, int priority);
+bool workqueue_submit (struct workqueue *, struct work *);
+bool workqueue_submit_delayed (struct workqueue *, struct work *,
+                               int64_t ticks);
+bool workqueue_cancel (struct work *);
+void workqueue_flush (struct workqueue *);
+void workqueue_tick (int64_t now);
+int64_t workqueue_next_tick (void);
+
+#endif /* threads/workqueue.h */
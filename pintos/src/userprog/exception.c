@@ -4,6 +4,12 @@
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
+#include "threads/vaddr.h"
+#include "userprog/process.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -20,9 +26,10 @@ static void page_fault (struct intr_frame *);
    signals.  Instead, we'll make them simply kill the user
    process.
 
-   Page faults are an exception.  Here they are treated the same
-   way as other exceptions, but this will need to change to
-   implement virtual memory.
+   Page faults are an exception.  With virtual memory, a fault
+   on a page that has not been brought in yet loads it;
+   otherwise they are treated the same way as other
+   exceptions.
 
    Refer to [IA32-v3a] section 5.15 "Exception and Interrupt
    Reference" for a description of each of these exceptions. */
@@ -89,7 +96,7 @@ kill (struct intr_frame *f)
       printf ("%s: dying due to interrupt %#04x (%s).\n",
               thread_name (), f->vec_no, intr_name (f->vec_no));
       intr_dump_frame (f);
-      thread_exit ();
+      process_terminate (-1);
 
     case SEL_KCSEG:
       /* Kernel's code segment, which indicates a kernel bug.
@@ -108,9 +115,10 @@ kill (struct intr_frame *f)
     }
 }
 
-/* Page fault handler.  This is a skeleton that must be filled in
-   to implement virtual memory.  Some solutions to project 2 may
-   also require modifying this code.
+/* Page fault handler.  With virtual memory, brings in the page
+   that faulted if the process has one there, whether the process
+   itself or the kernel, on its behalf, touched it.  Any other
+   fault kills the process, or panics the kernel.
 
    At entry, the address that faulted is in CR2 (Control Register
    2) and information about the fault, formatted as described in
@@ -142,15 +150,35 @@ page_fault (struct intr_frame *f)
 
   /* Count page faults. */
   page_fault_cnt++;
+  TRACE (TRACE_PAGE_FAULT, fault_addr, f->eip, f->error_code);
 
   /* Determine cause. */
   not_present = (f->error_code & PF_P) == 0;
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
-  /* To implement virtual memory, delete the rest of the function
-     body, and replace it with code that brings in the page to
-     which fault_addr refers. */
+#ifdef VM
+  /* A page that has not been loaded yet. */
+  if (not_present && is_user_vaddr (fault_addr) && page_in (fault_addr))
+    return;
+#endif
+
+  /* A stack that needs to grow.  A fault from the kernel is on a
+     user address that a system call was passed, so compare it to
+     the user stack pointer as of the system call. */
+  if (not_present
+      && process_grow_stack (fault_addr,
+                             user ? f->esp : thread_current ()->user_esp))
+    return;
+
+#ifdef VM
+  /* A write to a page shared copy-on-write.  Kernel writes to user
+     pages fault too, since CR0.WP is set. */
+  if (!not_present && write && is_user_vaddr (fault_addr)
+      && page_unshare (fault_addr))
+    return;
+#endif
+
   printf ("Page fault at %p: %s error %s page in %s context.\n",
           fault_addr,
           not_present ? "not present" : "rights violation",
@@ -0,0 +1,311 @@
+#include "userprog/futex.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdint.h>
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
+
+/* Futexes ("fast user-space mutexes").
+
+   A futex is an ordinary int in user memory.  User code
+   manipulates it with atomic instructions and only enters the
+   kernel when it has to sleep, with futex_wait(), or when it has
+   to wake a sleeper, with futex_wake().  An uncontended mutex
+   therefore costs no system call at all.  See lib/user/synch.c.
+
+   A futex is identified by a key that does not depend on which
+   frame its page happens to occupy, since the page may be
+   evicted and brought back into a different frame, or get a
+   frame of its own when a copy-on-write page is written, while
+   threads wait on it.  A futex in a shared file mapping is
+   identified by the file's inode and its offset in the file, so
+   that processes mapping the file at different addresses still
+   agree on which futex they mean.  Any other futex is private to
+   its process and identified by the process and its user
+   address.
+
+   Only futexes with sleepers have a struct futex, kept in
+   futex_table.  futex_wait() checks the futex's value and
+   queues the caller while holding futex_lock, and futex_wake()
+   also holds futex_lock, so a wake-up that follows a change of
+   the value cannot slip in between a waiter's check and its
+   going to sleep. */
+
+/* Identifies a futex. */
+struct futex_key
+  {
+    const void *object;         /* Process, or inode for a shared mapping. */
+    uintptr_t offset;           /* User address, or offset in the inode. */
+  };
+
+/* Threads waiting on one futex. */
+struct futex
+  {
+    struct hash_elem elem;      /* Element in futex_table. */
+    struct futex_key key;       /* The futex's identity. */
+    struct list waiters;        /* Waiting threads, in FIFO order. */
+    struct list_elem dead_elem; /* Used by futex_cancel(). */
+  };
+
+/* A thread waiting in futex_wait(). */
+struct futex_waiter
+  {
+    struct list_elem elem;      /* Element in struct futex's waiters. */
+    struct thread *thread;      /* The waiting thread. */
+    struct semaphore sema;      /* Upped to wake the thread. */
+  };
+
+/* Futexes with waiters, keyed on key. */
+static struct hash futex_table;
+
+/* Protects futex_table and the futexes in it. */
+static struct lock futex_lock;
+
+static hash_hash_func futex_hash;
+static hash_less_func futex_less;
+static bool futex_key (const int *uaddr, struct futex_key *);
+static bool futex_fault_in (const int *uaddr);
+static void futex_release (const int *uaddr);
+static struct futex *futex_find (const struct futex_key *);
+
+/* Initializes the futex table. */
+void
+futex_init (void)
+{
+  if (!hash_init (&futex_table, futex_hash, futex_less, NULL))
+    PANIC ("could not allocate futex table");
+  lock_init (&futex_lock);
+}
+
+/* If the int at user address UADDR still equals EXPECTED, sleeps
+   until another thread wakes UADDR with futex_wake(), and
+   returns 0.  Otherwise, or if UADDR is not a mapped and aligned
+   user address, memory is short, or the process is exiting,
+   returns -1 at once. */
+int
+futex_wait (const int *uaddr, int expected)
+{
+  struct futex_waiter w;
+  struct futex_key key;
+  struct futex *f;
+
+  if (!futex_key (uaddr, &key) || !futex_fault_in (uaddr))
+    return -1;
+
+  lock_acquire (&futex_lock);
+  if (*uaddr != expected || process_exiting ())
+    {
+      lock_release (&futex_lock);
+      futex_release (uaddr);
+      return -1;
+    }
+
+  f = futex_find (&key);
+  if (f == NULL)
+    {
+      f = malloc (sizeof *f);
+      if (f == NULL)
+        {
+          lock_release (&futex_lock);
+          futex_release (uaddr);
+          return -1;
+        }
+      f->key = key;
+      list_init (&f->waiters);
+      hash_insert (&futex_table, &f->elem);
+    }
+  w.thread = thread_current ();
+  sema_init (&w.sema, 0);
+  list_push_back (&f->waiters, &w.elem);
+  lock_release (&futex_lock);
+  futex_release (uaddr);
+
+  /* futex_wake() removes W from F, and frees F when it empties
+     it, before waking us. */
+  sema_down (&w.sema);
+  return 0;
+}
+
+/* Wakes up to CNT threads sleeping in futex_wait() on the int at
+   user address UADDR, in the order they went to sleep.  Returns
+   the number of threads woken, or -1 if UADDR is not a mapped
+   and aligned user address. */
+int
+futex_wake (const int *uaddr, int cnt)
+{
+  struct futex_key key;
+  struct futex *f;
+  int woken = 0;
+
+  if (!futex_key (uaddr, &key))
+    return -1;
+
+  lock_acquire (&futex_lock);
+  f = futex_find (&key);
+  if (f != NULL)
+    {
+      while (woken < cnt && !list_empty (&f->waiters))
+        {
+          struct futex_waiter *w = list_entry (list_pop_front (&f->waiters),
+                                               struct futex_waiter, elem);
+          sema_up (&w->sema);
+          woken++;
+        }
+      if (list_empty (&f->waiters))
+        {
+          hash_delete (&futex_table, &f->elem);
+          free (f);
+        }
+    }
+  lock_release (&futex_lock);
+  return woken;
+}
+
+/* Wakes every thread of process P that sleeps in futex_wait(),
+   so that it can notice that P is exiting.  P must already be
+   marked as exiting, so that its threads no longer go to sleep
+   on a futex. */
+void
+futex_cancel (struct process *p)
+{
+  struct hash_iterator i;
+  struct list dead;
+
+  ASSERT (p->exiting);
+
+  list_init (&dead);
+  lock_acquire (&futex_lock);
+  hash_first (&i, &futex_table);
+  while (hash_next (&i))
+    {
+      struct futex *f = hash_entry (hash_cur (&i), struct futex, elem);
+      struct list_elem *e = list_begin (&f->waiters);
+
+      while (e != list_end (&f->waiters))
+        {
+          struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+
+          e = list_next (e);
+          if (w->thread->process == p)
+            {
+              list_remove (&w->elem);
+              sema_up (&w->sema);
+            }
+        }
+
+      /* Deleting F now would invalidate the iterator. */
+      if (list_empty (&f->waiters))
+        list_push_back (&dead, &f->dead_elem);
+    }
+  while (!list_empty (&dead))
+    {
+      struct futex *f = list_entry (list_pop_front (&dead),
+                                    struct futex, dead_elem);
+      hash_delete (&futex_table, &f->elem);
+      free (f);
+    }
+  lock_release (&futex_lock);
+}
+
+/* Stores in *KEY the key of the futex at user address UADDR in
+   the running process.  Returns true if successful, false if
+   UADDR is misaligned, not a user address, or not in a page of
+   the process.  The page need not be in memory. */
+static bool
+futex_key (const int *uaddr, struct futex_key *key)
+{
+  struct process *p = thread_current ()->process;
+
+  if ((uintptr_t) uaddr % sizeof *uaddr != 0 || !is_user_vaddr (uaddr))
+    return false;
+#ifdef VM
+  {
+    struct inode *inode;
+    off_t ofs;
+
+    if (!page_shared_key (uaddr, &inode, &ofs))
+      return false;
+    if (inode != NULL)
+      {
+        key->object = inode;
+        key->offset = ofs;
+        return true;
+      }
+  }
+#else
+  if (pagedir_get_page (p->pagedir, uaddr) == NULL)
+    return false;
+#endif
+  key->object = p;
+  key->offset = (uintptr_t) uaddr;
+  return true;
+}
+
+/* Brings the page holding the futex at UADDR into memory, if it
+   is not there already, and keeps it there until
+   futex_release(), so that futex_wait() can read the futex
+   without faulting.  Returns false if the page cannot be brought
+   in. */
+static bool
+futex_fault_in (const int *uaddr)
+{
+#ifdef VM
+  return page_pin (uaddr, sizeof *uaddr, false);
+#else
+  return pagedir_get_page (thread_current ()->pagedir, uaddr) != NULL;
+#endif
+}
+
+/* Lets the page that futex_fault_in(UADDR) brought in be evicted
+   again. */
+static void
+futex_release (const int *uaddr UNUSED)
+{
+#ifdef VM
+  page_unpin (uaddr, sizeof *uaddr);
+#endif
+}
+
+/* Returns the futex with the given KEY, or a null pointer if no
+   thread waits on it.  futex_lock must be held. */
+static struct futex *
+futex_find (const struct futex_key *key)
+{
+  struct futex f;
+  struct hash_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&futex_lock));
+
+  f.key = *key;
+  e = hash_find (&futex_table, &f.elem);
+  return e != NULL ? hash_entry (e, struct futex, elem) : NULL;
+}
+
+/* Returns a hash value for futex E. */
+static unsigned
+futex_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct futex *f = hash_entry (e, struct futex, elem);
+  return hash_bytes (&f->key, sizeof f->key);
+}
+
+/* Returns true if futex A precedes futex B. */
+static bool
+futex_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  const struct futex_key *ka = &hash_entry (a, struct futex, elem)->key;
+  const struct futex_key *kb = &hash_entry (b, struct futex, elem)->key;
+
+  if (ka->object != kb->object)
+    return ka->object < kb->object;
+  return ka->offset < kb->offset;
+}
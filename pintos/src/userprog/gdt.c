@@ -29,13 +29,16 @@ static uint64_t make_code_desc (int dpl);
 static uint64_t make_data_desc (int dpl);
 static uint64_t make_tss_desc (void *laddr);
 static uint64_t make_gdtr_operand (uint16_t limit, void *base);
+static void gdt_load (int cpu_id);
 
 /* Sets up a proper GDT.  The bootstrap loader's GDT didn't
-   include user-mode selectors or a TSS, but we need both now. */
+   include user-mode selectors or a TSS, but we need both now.
+   There is one TSS per CPU, with CPU N's at selector
+   SEL_TSS + 8 * N. */
 void
 gdt_init (void)
 {
-  uint64_t gdtr_operand;
+  int i;
 
   /* Initialize GDT. */
   gdt[SEL_NULL / sizeof *gdt] = 0;
@@ -43,14 +46,32 @@ gdt_init (void)
   gdt[SEL_KDSEG / sizeof *gdt] = make_data_desc (0);
   gdt[SEL_UCSEG / sizeof *gdt] = make_code_desc (3);
   gdt[SEL_UDSEG / sizeof *gdt] = make_data_desc (3);
-  gdt[SEL_TSS / sizeof *gdt] = make_tss_desc (tss_get ());
+  for (i = 0; i < SMP_MAX_CPUS; i++)
+    gdt[SEL_TSS / sizeof *gdt + i] = make_tss_desc (tss_get (i));
+
+  gdt_load (0);
+}
+
+/* Loads the GDT that gdt_init() set up on an application
+   processor, with its own TSS. */
+void
+gdt_init_ap (int cpu_id)
+{
+  gdt_load (cpu_id);
+}
+
+/* Loads GDTR, and TR with the TSS for the CPU with ID CPU_ID.
+   See [IA32-v3a] 2.4.1 "Global Descriptor Table Register
+   (GDTR)", 2.4.4 "Task Register (TR)", and 6.2.4 "Task
+   Register".  */
+static void
+gdt_load (int cpu_id)
+{
+  uint64_t gdtr_operand = make_gdtr_operand (sizeof gdt - 1, gdt);
+  uint16_t tss_sel = SEL_TSS + cpu_id * sizeof *gdt;
 
-  /* Load GDTR, TR.  See [IA32-v3a] 2.4.1 "Global Descriptor
-     Table Register (GDTR)", 2.4.4 "Task Register (TR)", and
-     6.2.4 "Task Register".  */
-  gdtr_operand = make_gdtr_operand (sizeof gdt - 1, gdt);
   asm volatile ("lgdt %0" : : "m" (gdtr_operand));
-  asm volatile ("ltr %w0" : : "q" (SEL_TSS));
+  asm volatile ("ltr %w0" : : "q" (tss_sel));
 }
 
 /* System segment or code/data segment? */
@@ -5,6 +5,7 @@
 #include "threads/init.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
+#include "threads/smp.h"
 
 static uint32_t *active_pd (void);
 static void invalidate_pagedir (uint32_t *);
@@ -214,6 +215,23 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
     }
 }
 
+/* Makes the PTE for virtual page VPAGE in PD writable if
+   WRITABLE is true, read-only otherwise, preserving its other
+   bits.  Does nothing if PD contains no PTE for VPAGE. */
+void
+pagedir_set_writable (uint32_t *pd, const void *vpage, bool writable)
+{
+  uint32_t *pte = lookup_page (pd, vpage, false);
+  if (pte != NULL)
+    {
+      if (writable)
+        *pte |= PTE_W;
+      else
+        *pte &= ~(uint32_t) PTE_W;
+      invalidate_pagedir (pd);
+    }
+}
+
 /* Loads page directory PD into the CPU's page directory base
    register. */
 void
@@ -250,7 +268,9 @@ active_pd (void)
 
    This function invalidates the TLB if PD is the active page
    directory.  (If PD is not active then its entries are not in
-   the TLB, so there is no need to invalidate anything.) */
+   the TLB, so there is no need to invalidate anything.)  It also
+   invalidates the TLBs of any other CPUs that are running
+   threads of PD's process. */
 static void
 invalidate_pagedir (uint32_t *pd)
 {
@@ -260,4 +280,5 @@ invalidate_pagedir (uint32_t *pd)
          "Translation Lookaside Buffers (TLBs)". */
       pagedir_activate (pd);
     }
+  smp_tlb_shootdown (pd);
 }
@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "userprog/futex.h"
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
 #include "userprog/tss.h"
@@ -16,12 +17,86 @@
 #include "threads/interrupt.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/smp.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
+
+/* A thread created by thread_spawn(), as seen by thread_join().
+   The record outlives the thread until it is joined or its
+   process ends. */
+struct uthread
+  {
+    struct list_elem elem;      /* Element in struct process's uthreads. */
+    struct process *process;    /* Process the thread belongs to. */
+    tid_t tid;                  /* Thread identifier. */
+    int slot;                   /* User stack slot. */
+    void *eip;                  /* Initial user instruction pointer. */
+    void *esp;                  /* Initial user stack pointer. */
+    uint32_t retval;            /* Value passed to thread_exit(). */
+    bool joined;                /* Claimed by a thread_join() call? */
+    struct semaphore exited;    /* Upped when the thread exits. */
+  };
+
+/* Each thread of a process has its own user stack, in a slot of
+   user_stack_limit bytes.  Slot 0, just below PHYS_BASE,
+   belongs to the process's initial thread and slot N to a
+   thread made by thread_spawn(), so the initial thread's stack
+   is where a single-threaded process has always had it.  Only
+   the top page of a slot is mapped at first.  The stack grows
+   down through the rest of the slot as the thread faults on it;
+   see process_grow_stack(). */
+size_t user_stack_limit = USER_STACK_DEFAULT;
+
+/* Bytes below the stack pointer that an instruction may touch
+   before it moves the stack pointer: PUSHA pushes 32 bytes. */
+#define STACK_SLACK 32
+
+/* Arguments passed by process_execute() to start_process(). */
+struct exec_info
+  {
+    char *cmd_line;             /* Command line, in its own page. */
+    struct process *process;    /* The new process. */
+    int64_t start_ns;           /* timer_ns() when exec began. */
+  };
+
+#ifdef VM
+/* Arguments passed by process_fork() to start_fork(). */
+struct fork_info
+  {
+    struct process *process;    /* The new process. */
+    struct process *parent;     /* The process being copied. */
+    struct intr_frame frame;    /* Registers at the fork() call. */
+  };
+#endif
+
+/* Statistics on the time from process_execute() to the new
+   process's first user instruction. */
+static long long exec_cnt;      /* # of processes started. */
+static int64_t exec_total_ns;   /* Total time. */
+static int64_t exec_max_ns;     /* Longest time. */
 
 static thread_func start_process NO_RETURN;
+static thread_func uthread_start NO_RETURN;
+#ifdef VM
+static thread_func start_fork NO_RETURN;
+static bool copy_process (struct process *, struct process *parent);
+#endif
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
+static struct process *process_create (struct childProc *);
+static struct list *lock_child_list (void);
+static void unlock_child_list (void);
+static struct childProc *find_child (struct list *, pid_t);
+static bool add_child (struct childProc *);
+static uint8_t *stack_slot_page (int slot);
+static int stack_slot (const void *uaddr);
+static bool add_stack_page (struct process *, uint8_t *upage);
+static void free_stack_slot (struct process *, int slot);
 
 /* Starts a new thread running a user program loaded from
    FILENAME.  The new thread may be scheduled (and may even exit)
@@ -30,9 +105,13 @@ static bool load (const char *cmdline, void (**eip) (void), void **esp);
 tid_t
 process_execute (const char *file_name)
 {
+  struct exec_info info;
+  struct childProc *cp;
   char *fn_copy;
   tid_t tid;
 
+  info.start_ns = timer_ns ();
+
   /* Make a copy of FILE_NAME.
      Otherwise there's a race between the caller and load(). */
   fn_copy = palloc_get_page (0);
@@ -40,39 +119,243 @@ process_execute (const char *file_name)
     return TID_ERROR;
   strlcpy (fn_copy, file_name, PGSIZE);
 
+  /* Set up the new process and the record through which we wait
+     for it. */
+  cp = child_proc_alloc ();
+  info.process = cp != NULL ? process_create (cp) : NULL;
+  if (info.process == NULL)
+    {
+      if (cp != NULL)
+        child_proc_free (cp);
+      palloc_free_page (fn_copy);
+      return TID_ERROR;
+    }
+  info.cmd_line = fn_copy;
+
   /* Get only the file name from argument  - strtok_r giving some bugs*/
   size_t name_len = strcspn (file_name, " ") + 1;
   char *name = malloc (name_len * sizeof (char));
   strlcpy (name, file_name, name_len);
 
   /* Create a new thread to execute FILE_NAME. */
-  tid = thread_create (name, PRI_DEFAULT, start_process, fn_copy);
+  tid = thread_create (name, PRI_DEFAULT, start_process, &info);
+  free (name);
   if (tid == TID_ERROR)
-    palloc_free_page (fn_copy);
+    {
+      /* Drop the new process's reference to CP, then ours. */
+      child_proc_free (cp);
+      child_proc_free (cp);
+      dir_close (info.process->wd);
+#ifdef VM
+      page_table_destroy (info.process);
+#endif
+      free (info.process);
+      palloc_free_page (fn_copy);
+      return TID_ERROR;
+    }
+  cp->pid = tid;
 
-  free (name);
+  /* Wait for the load to finish.  This also keeps INFO alive
+     until the new thread is done with it. */
+  sema_down (&cp->sema);
+  return add_child (cp) ? tid : TID_ERROR;
+}
+
+#ifdef VM
+/* Starts a new process that is a copy of the running one, as
+   the running thread saw it when it made the system call whose
+   interrupt frame is F.  The copy has a single thread, which
+   returns 0 from the system call.  The two processes share their
+   pages in memory copy-on-write, so that neither reads anything
+   from disk.  Returns the new process's thread id, or TID_ERROR
+   if it could not be made. */
+tid_t
+process_fork (const struct intr_frame *f)
+{
+  struct thread *cur = thread_current ();
+  struct fork_info info;
+  struct childProc *cp;
+  tid_t tid;
 
-  struct childProc *cp = get_child_process (tid);
+  cp = child_proc_alloc ();
+  info.process = cp != NULL ? process_create (cp) : NULL;
+  if (info.process == NULL)
+    {
+      if (cp != NULL)
+        child_proc_free (cp);
+      return TID_ERROR;
+    }
+  info.parent = cur->process;
+  info.frame = *f;
+
+  tid = thread_create (cur->name, PRI_DEFAULT, start_fork, &info);
+  if (tid == TID_ERROR)
+    {
+      /* Drop the new process's reference to CP, then ours. */
+      child_proc_free (cp);
+      child_proc_free (cp);
+      dir_close (info.process->wd);
+      page_table_destroy (info.process);
+      free (info.process);
+      return TID_ERROR;
+    }
+  cp->pid = tid;
+
+  /* Wait for the copy to finish, as process_execute() waits for
+     the load. */
   sema_down (&cp->sema);
-  if (cp->loaded)
-  {
-    return tid;
-  }
-  else
-  {
-    return TID_ERROR;
-  }
+  return add_child (cp) ? tid : TID_ERROR;
+}
+
+/* A thread function that copies the process that called fork()
+   and returns to user mode in the copy. */
+static void
+start_fork (void *info_)
+{
+  struct fork_info *info = info_;
+  struct thread *t = thread_current ();
+  struct process *p = info->process;
+  struct intr_frame if_ = info->frame;
+
+  thread_set_process (p);
+  t->pagedir = p->pagedir = pagedir_create ();
+  if (t->pagedir == NULL)
+    process_terminate (-1);
+  process_activate ();
+  if (!copy_process (p, info->parent))
+    process_terminate (-1);
+
+  p->cp->loaded = true;
+  sema_up (&p->cp->sema);
+
+  /* Enter user mode as start_process() does, returning 0 from
+     fork(). */
+  if_.eax = 0;
+  intr_disable ();
+  kernel_lock_exit ();
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+
+/* Gives P, made by fork(), copies of PARENT's executable, open
+   files, and address space.  The copied files are opened anew
+   and start at the same positions.  Returns false if memory or
+   swap is exhausted. */
+static bool
+copy_process (struct process *p, struct process *parent)
+{
+  struct list_elem *e;
+  bool success = true;
+
+  p->exe = file_reopen (parent->exe);
+  if (p->exe == NULL)
+    return false;
+  file_deny_write (p->exe);
+
+  lock_acquire (&parent->lock);
+  for (e = list_begin (&parent->file_list);
+       success && e != list_end (&parent->file_list); e = list_next (e))
+    {
+      struct file_pointer *fp = list_entry (e, struct file_pointer, elem);
+      struct file_pointer *copy = malloc (sizeof *copy);
+
+      if (copy == NULL)
+        {
+          success = false;
+          break;
+        }
+      *copy = *fp;
+      copy->ref_cnt = 1;
+      if (fp->is_dir)
+        success = (copy->dir = dir_reopen (fp->dir)) != NULL;
+      else
+        {
+          copy->file = file_reopen (fp->file);
+          success = copy->file != NULL;
+          if (success)
+            file_seek (copy->file, file_tell (fp->file));
+        }
+      if (success)
+        list_push_back (&p->file_list, &copy->elem);
+      else
+        free (copy);
+    }
+  p->next_fd = parent->next_fd;
+  p->stack_slots = parent->stack_slots;
+  lock_release (&parent->lock);
+
+  return (success
+          && page_table_copy (p, parent)
+          && mmap_copy (p, parent));
+}
+#endif
+
+/* Returns a new process whose parent waits for it through CP,
+   or a null pointer if memory is exhausted.  If successful, the
+   process takes a reference to CP, which it drops when it exits.
+   The process inherits the running thread's working
+   directory. */
+static struct process *
+process_create (struct childProc *cp)
+{
+  struct process *parent = thread_current ()->process;
+  struct process *p = malloc (sizeof *p);
+
+  if (p == NULL)
+    return NULL;
+
+  cp->pid = TID_ERROR;
+  cp->loaded = false;
+  sema_init (&cp->sema, 0);
+  cp->exit_status = -1;
+
+  p->cp = cp;
+  p->exe = NULL;
+  p->pagedir = NULL;
+  p->wd = NULL;
+  if (parent != NULL)
+    {
+      lock_acquire (&parent->lock);
+      p->wd = dir_reopen (parent->wd);
+      lock_release (&parent->lock);
+    }
+  list_init (&p->children);
+  lock_init (&p->lock);
+  list_init (&p->file_list);
+  p->next_fd = 2;
+  p->thread_cnt = 1;
+  p->runnable_cnt = 0;
+  p->tickets = thread_get_tickets ();
+  p->stack_slots = 1;
+  list_init (&p->uthreads);
+  p->exiting = false;
+#ifdef VM
+  if (!page_table_init (p))
+    {
+      dir_close (p->wd);
+      free (p);
+      return NULL;
+    }
+  mmap_init (p);
+#endif
+  cp->ref_cnt++;
+  return p;
 }
 
 /* A thread function that loads a user process and starts it
    running. */
 static void
-start_process (void *file_name_)
+start_process (void *info_)
 {
-  char *file_name = file_name_;
+  struct exec_info *info = info_;
+  char *file_name = info->cmd_line;
   struct intr_frame if_;
+  int64_t start_ns = info->start_ns;
+  int64_t elapsed_ns;
   bool success;
 
+  thread_set_process (info->process);
+
   size_t function_size = strlen (file_name) + 1;
   char **argv = malloc (64*sizeof (char*));
   size_t argc = 0;
@@ -81,7 +364,7 @@ start_process (void *file_name_)
   char *token = strtok_r (file_name, " ", &save_ptr);
 
   argv[argc] = file_name;
-  int offset = PHYS_BASE - function_size - file_name_;
+  int offset = PHYS_BASE - function_size - (void *) file_name;
 
   while (token != NULL)
   {
@@ -100,10 +383,10 @@ start_process (void *file_name_)
 
   /* If load failed, quit. */
   if (!success)
-    thread_exit ();
+    process_terminate (-1);
 
   if_.esp -= function_size;
-  memcpy (if_.esp, file_name_, function_size);
+  memcpy (if_.esp, file_name, function_size);
 
   size_t argv_sz = (argc + 1) * sizeof (char *);
 
@@ -121,7 +404,7 @@ start_process (void *file_name_)
 
   palloc_free_page (file_name);
 
-  struct childProc *cp = thread_current ()->proc;
+  struct childProc *cp = thread_current ()->process->cp;
   cp->loaded = true;
   sema_up (&cp->sema);
 
@@ -130,7 +413,15 @@ start_process (void *file_name_)
      threads/intr-stubs.S).  Because intr_exit takes all of its
      arguments on the stack in the form of a `struct intr_frame',
      we just point the stack pointer (%esp) to our stack frame
-     and jump to it. */
+     and jump to it.  Like any return to user mode, this leaves
+     the kernel, so release the kernel lock. */
+  intr_disable ();
+  elapsed_ns = timer_ns () - start_ns;
+  exec_cnt++;
+  exec_total_ns += elapsed_ns;
+  if (elapsed_ns > exec_max_ns)
+    exec_max_ns = elapsed_ns;
+  kernel_lock_exit ();
   asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
   NOT_REACHED ();
 }
@@ -147,55 +438,155 @@ start_process (void *file_name_)
 int
 process_wait (tid_t child_tid)
 {
-  struct childProc *cp = get_child_process (child_tid);
+  /* Take the child off the list before waiting, so that a wait
+     for it by another of our threads returns -1 at once. */
+  struct childProc *cp = find_child (lock_child_list (), child_tid);
+  if (cp != NULL)
+    list_remove (&cp->elem);
+  unlock_child_list ();
+
   if (cp == NULL)
   {
     return -1;
   }
   else
   {
+    int exit_status;
+
     sema_down (&cp->sema);
-    list_remove (&cp->elem);
-    return cp->exit_status;
+    exit_status = cp->exit_status;
+    child_proc_free (cp);
+    return exit_status;
   }
 }
 
-/* Free the current process's resources. */
+/* Returns the running thread's list of child processes, locked:
+   its process's list, or for a kernel thread, such as the one
+   that runs the initial user program, its own.  Release it with
+   unlock_child_list(). */
+static struct list *
+lock_child_list (void)
+{
+  struct thread *t = thread_current ();
+
+  if (t->process == NULL)
+    return &t->children;
+  lock_acquire (&t->process->lock);
+  return &t->process->children;
+}
+
+/* Releases the list locked by lock_child_list(). */
+static void
+unlock_child_list (void)
+{
+  struct thread *t = thread_current ();
+
+  if (t->process != NULL)
+    lock_release (&t->process->lock);
+}
+
+/* Once the new process with record CP has loaded, or failed to,
+   makes it a child of the running process and returns true, or
+   drops our reference to CP and returns false.  Until then, no
+   other thread can find CP to wait on it, so that a wait cannot
+   take the wakeup meant for the load. */
+static bool
+add_child (struct childProc *cp)
+{
+  if (!cp->loaded)
+    {
+      child_proc_free (cp);
+      return false;
+    }
+  list_push_back (lock_child_list (), &cp->elem);
+  unlock_child_list ();
+  return true;
+}
+
+/* Returns the child in LIST, locked by lock_child_list(), with
+   the given PID, or a null pointer if there is none. */
+static struct childProc *
+find_child (struct list *list, pid_t pid)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (list); e != list_end (list); e = list_next (e))
+    {
+      struct childProc *cp = list_entry (e, struct childProc, elem);
+      if (cp->pid == pid)
+        return cp;
+    }
+  return NULL;
+}
+
+/* Free the current thread's resources, and if it is the last
+   thread of its process, the process's. */
 void
 process_exit (void)
 {
   struct thread *cur = thread_current ();
+  struct process *p = cur->process;
   uint32_t *pd;
+  bool last;
 
-  file_close (cur->proc->exe);
+  /* Kernel threads have no process. */
+  if (p == NULL)
+    return;
 
-  /* Destroy the current process's page directory and switch back
-     to the kernel-only page directory. */
-  pd = cur->pagedir;
-  if (pd != NULL)
+  lock_acquire (&p->lock);
+  if (cur->uthread != NULL)
     {
-      /* Correct ordering here is crucial.  We must set
-         cur->pagedir to NULL before switching page directories,
-         so that a timer interrupt can't switch back to the
-         process page directory.  We must activate the base page
-         directory before destroying the process's page
-         directory, or our active page directory will be one
-         that's been freed (and cleared). */
-      cur->pagedir = NULL;
-      pagedir_activate (NULL);
-      pagedir_destroy (pd);
+      free_stack_slot (p, cur->uthread->slot);
+      sema_up (&cur->uthread->exited);
     }
+  last = --p->thread_cnt == 0;
+  lock_release (&p->lock);
+  cur->uthread = NULL;
+
+  /* Correct ordering here is crucial.  We must set cur->pagedir
+     to NULL before switching page directories, so that a timer
+     interrupt can't switch back to the process page directory.
+     We must activate the base page directory before destroying
+     the process's page directory, or our active page directory
+     will be one that's been freed (and cleared). */
+  cur->pagedir = NULL;
+  pagedir_activate (NULL);
+  thread_set_process (NULL);
+  if (!last)
+    return;
+
+  /* The last thread to exit cleans up after the process.  A
+     process whose threads all left through thread_exit(), without
+     calling exit(), exits with status 0. */
+  if (!p->exiting)
+    p->cp->exit_status = 0;
+
+#ifdef VM
+  /* Release the process's pages while its page directory and
+     executable, which they refer to, still exist.  Unmapping its
+     mapped files writes back the pages it modified. */
+  mmap_destroy (p);
+  page_table_destroy (p);
+#endif
+  file_close (p->exe);
+
+  /* Destroy the process's page directory. */
+  pd = p->pagedir;
+  if (pd != NULL)
+    pagedir_destroy (pd);
 
-  while (!list_empty (&cur->children))
+  /* Children that are still running keep their records until
+     they exit. */
+  while (!list_empty (&p->children))
     {
-      struct list_elem *e = list_pop_front (&cur->children);
-      free (list_entry (e, struct childProc, elem));
+      struct list_elem *e = list_pop_front (&p->children);
+      child_proc_free (list_entry (e, struct childProc, elem));
     }
 
   /* Close open files and dirs */  
-  while (!list_empty (&cur->file_list))
+  while (!list_empty (&p->file_list))
     {
-      struct list_elem *e = list_pop_front (&cur->file_list);
+      struct list_elem *e = list_pop_front (&p->file_list);
       struct file_pointer *f = list_entry (e, struct file_pointer, elem);
       if (f->is_dir)
         dir_close (f->dir);
@@ -205,10 +596,349 @@ process_exit (void)
     }
 
   /* Close working directory */  
-  dir_close (cur->wd);
+  dir_close (p->wd);
+
+  /* Free the records of threads that no one joined. */
+  while (!list_empty (&p->uthreads))
+    free (list_entry (list_pop_front (&p->uthreads), struct uthread, elem));
 
-  printf ("%s: exit(%d)\n", (char *) &cur->name, cur->proc->exit_status);
-  sema_up (&cur->proc->sema);
+  printf ("%s: exit(%d)\n", (char *) &cur->name, p->cp->exit_status);
+  sema_up (&p->cp->sema);
+  child_proc_free (p->cp);
+  free (p);
+}
+
+/* Ends the running process with the given exit STATUS, unless
+   it is already exiting, in which case the status is the one
+   given first.  Terminates the running thread at once.  The
+   process's other threads terminate the next time they would
+   return to user mode, and those sleeping on a futex are woken
+   up so that they do. */
+void
+process_terminate (int status)
+{
+  struct process *p = thread_current ()->process;
+  bool others;
+
+  lock_acquire (&p->lock);
+  if (!p->exiting)
+    {
+      p->exiting = true;
+      p->cp->exit_status = status;
+    }
+  others = p->thread_cnt > 1;
+  lock_release (&p->lock);
+
+  if (others)
+    futex_cancel (p);
+  thread_exit ();
+}
+
+/* Returns true if the running thread belongs to a process that
+   is exiting, in which case it must not return to user mode. */
+bool
+process_exiting (void)
+{
+  struct process *p = thread_current ()->process;
+  return p != NULL && p->exiting;
+}
+
+/* Prints statistics on starting processes.  The time runs from
+   process_execute() to the new process's first user
+   instruction, which includes loading the executable.  With
+   demand paging, the pages it touches are read afterward, by
+   page faults. */
+void
+process_print_stats (void)
+{
+  if (exec_cnt == 0)
+    return;
+  printf ("Exec: %lld processes, %"PRId64" us average, %"PRId64" us max "
+          "to first instruction\n", exec_cnt,
+          exec_total_ns / exec_cnt / 1000, exec_max_ns / 1000);
+}
+
+/* Starts a new thread in the running process.  The thread begins
+   executing user code at EIP, on a new user stack, as if called
+   with arguments FUNC and AUX.  Returns the new thread's
+   identifier, or TID_ERROR if the process is exiting, already
+   has PROCESS_THREAD_MAX threads, or memory is short. */
+tid_t
+process_thread_spawn (void *eip, void *func, void *aux)
+{
+  struct thread *cur = thread_current ();
+  struct process *p = cur->process;
+  struct uthread *ut;
+  uint32_t *frame;
+  int slot;
+  tid_t tid;
+
+  ut = malloc (sizeof *ut);
+  if (ut == NULL)
+    return TID_ERROR;
+
+  /* Claim a stack slot. */
+  lock_acquire (&p->lock);
+  for (slot = 1; slot < PROCESS_THREAD_MAX; slot++)
+    if ((p->stack_slots & (1u << slot)) == 0)
+      break;
+  if (p->exiting || slot >= PROCESS_THREAD_MAX)
+    {
+      lock_release (&p->lock);
+      goto error;
+    }
+  p->stack_slots |= 1u << slot;
+  lock_release (&p->lock);
+
+  if (!add_stack_page (p, stack_slot_page (slot)))
+    {
+      lock_acquire (&p->lock);
+      p->stack_slots &= ~(1u << slot);
+      lock_release (&p->lock);
+      goto error;
+    }
+
+  /* Lay out the stack as if EIP had been called as
+     EIP(FUNC, AUX), with a null return address.  P's page
+     directory is the active one, so write through the user
+     address. */
+  frame = (uint32_t *) (stack_slot_page (slot) + PGSIZE) - 3;
+  frame[0] = 0;
+  frame[1] = (uint32_t) func;
+  frame[2] = (uint32_t) aux;
+
+  ut->process = p;
+  ut->tid = TID_ERROR;
+  ut->slot = slot;
+  ut->eip = eip;
+  ut->esp = frame;
+  ut->retval = 0;
+  ut->joined = false;
+  sema_init (&ut->exited, 0);
+
+  lock_acquire (&p->lock);
+  list_push_back (&p->uthreads, &ut->elem);
+  p->thread_cnt++;
+  lock_release (&p->lock);
+
+  tid = thread_create (cur->name, PRI_DEFAULT, uthread_start, ut);
+
+  lock_acquire (&p->lock);
+  if (tid != TID_ERROR)
+    ut->tid = tid;
+  else
+    {
+      list_remove (&ut->elem);
+      p->thread_cnt--;
+      free_stack_slot (p, slot);
+      free (ut);
+    }
+  lock_release (&p->lock);
+  return tid;
+
+ error:
+  free (ut);
+  return TID_ERROR;
+}
+
+/* A thread function that starts a thread made by
+   process_thread_spawn() running in user mode. */
+static void
+uthread_start (void *ut_)
+{
+  struct uthread *ut = ut_;
+  struct thread *t = thread_current ();
+  struct intr_frame if_;
+
+  thread_set_process (ut->process);
+  t->uthread = ut;
+  t->pagedir = ut->process->pagedir;
+  process_activate ();
+
+  if (process_exiting ())
+    thread_exit ();
+
+  memset (&if_, 0, sizeof if_);
+  if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
+  if_.cs = SEL_UCSEG;
+  if_.eflags = FLAG_IF | FLAG_MBS;
+  if_.eip = ut->eip;
+  if_.esp = ut->esp;
+
+  /* Enter user mode as start_process() does. */
+  intr_disable ();
+  kernel_lock_exit ();
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+
+/* Waits for thread TID of the running process, which must have
+   been made by thread_spawn(), to exit, and stores the value it
+   passed to thread_exit() in *RETVAL.  Returns false at once if
+   there is no such thread, if it is the running thread, or if
+   another thread_join() call has already claimed it. */
+bool
+process_thread_join (tid_t tid, uint32_t *retval)
+{
+  struct thread *cur = thread_current ();
+  struct process *p = cur->process;
+  struct uthread *ut = NULL;
+  struct list_elem *e;
+
+  lock_acquire (&p->lock);
+  for (e = list_begin (&p->uthreads); e != list_end (&p->uthreads);
+       e = list_next (e))
+    if (list_entry (e, struct uthread, elem)->tid == tid)
+      {
+        ut = list_entry (e, struct uthread, elem);
+        break;
+      }
+  if (ut == NULL || ut->joined || ut == cur->uthread)
+    {
+      lock_release (&p->lock);
+      return false;
+    }
+  ut->joined = true;
+  lock_release (&p->lock);
+
+  sema_down (&ut->exited);
+
+  lock_acquire (&p->lock);
+  list_remove (&ut->elem);
+  lock_release (&p->lock);
+  *retval = ut->retval;
+  free (ut);
+  return true;
+}
+
+/* Terminates the running thread, making RETVAL available to
+   thread_join().  The process goes on running until its last
+   thread exits. */
+void
+process_thread_exit (uint32_t retval)
+{
+  struct thread *cur = thread_current ();
+
+  if (cur->uthread != NULL)
+    cur->uthread->retval = retval;
+  thread_exit ();
+}
+
+/* Returns the lowest user page of stack slot SLOT, the one that
+   is mapped. */
+static uint8_t *
+stack_slot_page (int slot)
+{
+  return (uint8_t *) PHYS_BASE - slot * user_stack_limit - PGSIZE;
+}
+
+/* Adds a zeroed page at UPAGE to process P, which must be the
+   running process, for use as stack.  Returns false if UPAGE is
+   already mapped or memory is exhausted. */
+static bool
+add_stack_page (struct process *p UNUSED, uint8_t *upage)
+{
+#ifdef VM
+  /* The page is brought in when the caller first writes to it,
+     through UPAGE, like any other page. */
+  return page_add_zero (upage, true);
+#else
+  uint8_t *kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+
+  if (kpage == NULL)
+    return false;
+  if (pagedir_get_page (p->pagedir, upage) != NULL
+      || !pagedir_set_page (p->pagedir, upage, kpage, true))
+    {
+      palloc_free_page (kpage);
+      return false;
+    }
+  return true;
+#endif
+}
+
+/* Returns the stack slot that contains user address UADDR, or
+   -1 if UADDR is below the stack area. */
+static int
+stack_slot (const void *uaddr)
+{
+  size_t depth = (uint8_t *) PHYS_BASE - (const uint8_t *) uaddr - 1;
+  int slot = depth / user_stack_limit;
+
+  return slot < PROCESS_THREAD_MAX ? slot : -1;
+}
+
+/* Unmaps and frees the stack pages of stack slot SLOT in process
+   P and makes the slot available again.  P's lock must be
+   held. */
+static void
+free_stack_slot (struct process *p, int slot)
+{
+  uint8_t *top = stack_slot_page (slot);
+  uint8_t *upage;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+
+  for (upage = top; upage > top - user_stack_limit; upage -= PGSIZE)
+    {
+#ifdef VM
+      page_remove (p, upage);
+#else
+      void *kpage = pagedir_get_page (p->pagedir, upage);
+      if (kpage != NULL)
+        {
+          pagedir_clear_page (p->pagedir, upage);
+          palloc_free_page (kpage);
+        }
+#endif
+    }
+  p->stack_slots &= ~(1u << slot);
+}
+
+/* Returns true if UADDR is in the part of user virtual memory
+   set aside for the stacks of the threads of a process, which
+   other mappings may not use. */
+bool
+process_in_stack_area (const void *uaddr)
+{
+  return is_user_vaddr (uaddr) && stack_slot (uaddr) >= 0;
+}
+
+/* Grows the stack of the running process that contains user
+   address UADDR, if UADDR is in the stack slot of one of its
+   threads and no more than STACK_SLACK bytes below ESP, the
+   user stack pointer of the thread that accessed it, by adding
+   the page that contains UADDR.  Returns true if that page is now
+   mapped, false if UADDR is not a valid stack address or memory
+   is exhausted. */
+bool
+process_grow_stack (const void *uaddr, const void *esp)
+{
+  struct process *p = thread_current ()->process;
+  uint8_t *upage = pg_round_down (uaddr);
+  int slot;
+  bool in_use;
+
+  if (p == NULL || !is_user_vaddr (uaddr)
+      || (const uint8_t *) uaddr + STACK_SLACK < (const uint8_t *) esp)
+    return false;
+  slot = stack_slot (uaddr);
+  if (slot < 0)
+    return false;
+
+  lock_acquire (&p->lock);
+  in_use = (p->stack_slots & (1u << slot)) != 0;
+  lock_release (&p->lock);
+  if (!in_use)
+    return false;
+
+  /* Another thread may have added the page first. */
+  add_stack_page (p, upage);
+#ifdef VM
+  return page_in (uaddr);
+#else
+  return pagedir_get_page (p->pagedir, uaddr) != NULL;
+#endif
 }
 
 /* Sets up the CPU for running user code in the current
@@ -311,20 +1041,18 @@ load (const char *file_name, void (**eip) (void), void **esp)
   int i;
 
   /* Allocate and activate page directory. */
-  t->pagedir = pagedir_create ();
+  t->pagedir = t->process->pagedir = pagedir_create ();
   if (t->pagedir == NULL)
     goto done;
   process_activate ();
 
   /* Set working directory */
-  if (t->wd == NULL)
-    t->wd = dir_open_root ();
-  else
-    t->wd = dir_reopen (t->wd);
+  if (t->process->wd == NULL)
+    t->process->wd = dir_open_root ();
 
   /* Open executable file. */
   char name[NAME_MAX + 1];
-  struct dir *dir = dir_find (t->wd, file_name, name);
+  struct dir *dir = dir_find (t->process->wd, file_name, name);
   file = filesys_open_dir (dir, name);
   dir_close (dir);
   if (file == NULL)
@@ -332,7 +1060,7 @@ load (const char *file_name, void (**eip) (void), void **esp)
       printf ("load: %s: open failed\n", file_name);
       goto done;
     }
-  t->proc->exe = file;
+  t->process->exe = file;
   file_deny_write (file);
 
   /* Read and verify executable header. */
@@ -423,7 +1151,9 @@ load (const char *file_name, void (**eip) (void), void **esp)
 
 /* load() helpers. */
 
+#ifndef VM
 static bool install_page (void *upage, void *kpage, bool writable);
+#endif
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
@@ -482,6 +1212,10 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
    The pages initialized by this function must be writable by the
    user process if WRITABLE is true, read-only otherwise.
 
+   With virtual memory, the pages are only entered in the
+   supplemental page table here, and each one is read in when the
+   process first touches it.  Otherwise, they are all read now.
+
    Return true if successful, false if a memory allocation error
    or disk read error occurs. */
 static bool
@@ -492,7 +1226,9 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
+#ifndef VM
   file_seek (file, ofs);
+#endif
   while (read_bytes > 0 || zero_bytes > 0)
     {
       /* Calculate how to fill this page.
@@ -501,6 +1237,14 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
+#ifdef VM
+      /* Record where the page comes from. */
+      if (page_read_bytes > 0
+          ? !page_add_file (upage, file, ofs, page_read_bytes, writable)
+          : !page_add_zero (upage, writable))
+        return false;
+      ofs += page_read_bytes;
+#else
       /* Get a page of memory. */
       uint8_t *kpage = palloc_get_page (PAL_USER);
       if (kpage == NULL)
@@ -520,6 +1264,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
           palloc_free_page (kpage);
           return false;
         }
+#endif
 
       /* Advance. */
       read_bytes -= page_read_bytes;
@@ -534,21 +1279,15 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 static bool
 setup_stack (void **esp)
 {
-  uint8_t *kpage;
-  bool success = false;
+  struct process *p = thread_current ()->process;
 
-  kpage = palloc_get_page (PAL_USER | PAL_ZERO);
-  if (kpage != NULL)
-    {
-      success = install_page (((uint8_t *) PHYS_BASE) - PGSIZE, kpage, true);
-      if (success)
-        *esp = PHYS_BASE;
-      else
-        palloc_free_page (kpage);
-    }
-  return success;
+  if (!add_stack_page (p, ((uint8_t *) PHYS_BASE) - PGSIZE))
+    return false;
+  *esp = PHYS_BASE;
+  return true;
 }
 
+#ifndef VM
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
@@ -568,3 +1307,4 @@ install_page (void *upage, void *kpage, bool writable)
   return (pagedir_get_page (t->pagedir, upage) == NULL
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
+#endif
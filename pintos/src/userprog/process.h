@@ -1,8 +1,15 @@
 #ifndef USERPROG_PROCESS_H
 #define USERPROG_PROCESS_H
 
+#include <stdint.h>
+#ifdef VM
+#include <hash.h>
+#endif
+#include "threads/synch.h"
 #include "threads/thread.h"
 
+struct intr_frame;
+
 struct file_pointer
   {
     int fd;
@@ -10,12 +17,67 @@ struct file_pointer
     bool is_dir;
     struct file *file;
     struct dir *dir;
+    int ref_cnt;                /* Open fd plus syscalls using it. */
     struct list_elem elem;
   };
 
+/* Most threads a process may have, counting its initial thread. */
+#define PROCESS_THREAD_MAX 32
+
+/* Each thread of a process has a stack of up to user_stack_limit
+   bytes, which grows on demand.  Set by the kernel command-line
+   option "-stack", to at most USER_STACK_MAX.  The stacks take up
+   the top PROCESS_THREAD_MAX * user_stack_limit bytes of user
+   virtual memory. */
+#define USER_STACK_DEFAULT (1024 * 1024)
+#define USER_STACK_MAX (8 * 1024 * 1024)
+extern size_t user_stack_limit;
+
+/* A user process, which owns the state that all of its threads
+   share.  The process ends when its last thread exits. */
+struct process
+  {
+    struct childProc *cp;       /* Exit status, shared with parent. */
+    struct file *exe;           /* Executable, denied writes. */
+    uint32_t *pagedir;          /* Page directory. */
+    struct dir *wd;             /* Working directory. */
+    int runnable_cnt;           /* Threads ready or running, changed
+                                   by thread.c with interrupts off. */
+
+    struct lock lock;           /* Protects the members below. */
+    struct list children;       /* Child processes, as struct childProc. */
+    struct list file_list;      /* Open files, as struct file_pointer. */
+    int next_fd;                /* Next file descriptor to hand out. */
+    int thread_cnt;             /* Number of threads that have not exited. */
+    uint32_t stack_slots;       /* Bit N set if user stack slot N in use. */
+    struct list uthreads;       /* Threads made by thread_spawn(). */
+    bool exiting;               /* Set by exit(); threads must stop. */
+    int tickets;                /* CPU share, split among runnable_cnt. */
+
+#ifdef VM
+    /* Owned by vm/page.c. */
+    struct hash pages;          /* Supplemental page table. */
+    struct lock pages_lock;     /* Protects pages. */
+
+    /* Owned by vm/mmap.c, under lock. */
+    struct list mappings;       /* Mapped files, as struct mapping. */
+    int next_mapid;             /* Next mapping identifier to hand out. */
+#endif
+  };
+
 tid_t process_execute (const char *file_name);
+tid_t process_fork (const struct intr_frame *);
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (void);
+void process_terminate (int status) NO_RETURN;
+bool process_exiting (void);
+bool process_grow_stack (const void *uaddr, const void *esp);
+bool process_in_stack_area (const void *uaddr);
+void process_print_stats (void);
+
+tid_t process_thread_spawn (void *eip, void *func, void *aux);
+bool process_thread_join (tid_t, uint32_t *retval);
+void process_thread_exit (uint32_t retval) NO_RETURN;
 
 #endif /* userprog/process.h */
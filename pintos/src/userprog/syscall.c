@@ -4,6 +4,7 @@
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/directory.h"
@@ -19,70 +20,185 @@
 #include "filesys/cache.h"
 #include <threads/fixed-point.h>
 #include "devices/block.h"
+#include <lockstat.h>
+#include "userprog/futex.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
+
+/* Most lockstat entries copied by one lockstat() call. */
+#define LOCKSTAT_MAX_ENTRIES 256
 
 static void syscall_handler (struct intr_frame *);
 void check_ptr (void *ptr, size_t size);
 void check_string (char *ptr);
 struct file_pointer *get_file (int fd);
+static void put_file (struct file_pointer *);
+static struct dir *get_wd (void);
+static bool user_page_ok (const void *uaddr);
 
 void
 syscall_init (void)
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
+  futex_init ();
+}
+
+/* Returns true if UADDR is a user address in a page that is
+   mapped, bringing the page in first if it has not been loaded
+   yet, or growing the stack to it if it is just below it. */
+static bool
+user_page_ok (const void *uaddr)
+{
+  struct thread *t = thread_current ();
+
+  if (!is_user_vaddr (uaddr))
+    return false;
+  if (pagedir_get_page (t->pagedir, uaddr) != NULL)
+    return true;
+#ifdef VM
+  if (page_in (uaddr))
+    return true;
+#endif
+  return process_grow_stack (uaddr, t->user_esp);
 }
 
+/* Terminates the process unless every page holding the SIZE
+   bytes at PTR is mapped.  Brings in any that are not loaded yet,
+   so that the kernel does not fault on them while it holds
+   locks. */
 void
 check_ptr (void *ptr, size_t size)
 {
-  if (is_user_vaddr (ptr)
-      && pagedir_get_page (thread_current ()->pagedir, ptr) != NULL
-      && is_user_vaddr (ptr + size)
-      && pagedir_get_page (thread_current ()->pagedir, ptr + size) != NULL)
+  uint8_t *start = ptr;
+  uint8_t *last = start + size - 1;
+  uint8_t *upage;
+
+  if (size == 0)
     return;
-  else
-    thread_exit ();
+  if (last < start)
+    process_terminate (-1);
+  for (upage = pg_round_down (start); upage <= last; upage += PGSIZE)
+    if (!user_page_ok (upage < start ? start : upage))
+      process_terminate (-1);
 }
 
+/* Terminates the process unless the whole null-terminated string
+   at USTR is in mapped pages. */
 void
 check_string (char *ustr)
 {
-  if (is_user_vaddr (ustr))
+  char *p;
+
+  for (p = ustr; ; p++)
     {
-      char *kstr = pagedir_get_page (thread_current ()->pagedir, ustr);
-      if (kstr != NULL && is_user_vaddr (ustr + strlen (kstr) + 1)
-          && pagedir_get_page (thread_current ()->pagedir, (ustr + strlen (kstr) + 1)) != NULL)
+      if ((p == ustr || pg_ofs (p) == 0) && !user_page_ok (p))
+        process_terminate (-1);
+      if (*p == '\0')
         return;
     }
-  thread_exit ();
 }
 
+/* Returns the running process's open file with descriptor FD,
+   or a null pointer if there is none.  The caller must release
+   it with put_file(), so that a close() by another thread of the
+   process does not free it in the meantime. */
 struct file_pointer *
 get_file (int fd)
 {
-  struct list *list_ = &thread_current ()->file_list;
+  struct process *p = thread_current ()->process;
+  struct list *list_ = &p->file_list;
   struct list_elem *e = list_head (list_);
+  struct file_pointer *found = NULL;
+
+  lock_acquire (&p->lock);
   while ((e = list_next (e)) != list_tail (list_))
     {
       struct file_pointer *f = list_entry (e, struct file_pointer, elem);
       if (f->fd == fd)
-      return f;
+        {
+          found = f;
+          found->ref_cnt++;
+          break;
+        }
+    }
+  lock_release (&p->lock);
+  return found;
+}
+
+/* Releases FP, obtained from get_file(), and closes it if it was
+   the last reference.  A null FP is ignored. */
+static void
+put_file (struct file_pointer *fp)
+{
+  struct process *p = thread_current ()->process;
+  bool last;
+
+  if (fp == NULL)
+    return;
+  lock_acquire (&p->lock);
+  last = --fp->ref_cnt == 0;
+  lock_release (&p->lock);
+  if (last)
+    {
+      /* locks in inode_close ()*/
+      if (fp->is_dir)
+        dir_close (fp->dir);
+      else
+        file_close (fp->file);
+      free (fp);
     }
-  return NULL;
+}
+
+/* Returns a new reference to the running process's working
+   directory, which the caller must close.  Another thread of the
+   process may change the working directory at any time. */
+static struct dir *
+get_wd (void)
+{
+  struct process *p = thread_current ()->process;
+  struct dir *wd;
+
+  lock_acquire (&p->lock);
+  wd = dir_reopen (p->wd);
+  lock_release (&p->lock);
+  return wd;
+}
+
+/* Looks up the directory part of user path PATH relative to the
+   working directory, as dir_find(). */
+static struct dir *
+find_dir (const char *path, char *name)
+{
+  struct dir *wd = get_wd ();
+  struct dir *dir = dir_find (wd, path, name);
+
+  dir_close (wd);
+  return dir;
 }
 
 static void
 syscall_handler (struct intr_frame *f UNUSED)
 {
   uint32_t* args = ((uint32_t*) f->esp);
+#ifdef VM
+  void *pinned_buf = NULL;
+  size_t pinned_size = 0;
+#endif
 
+  thread_current ()->user_esp = f->esp;
   check_ptr (args, sizeof (uint32_t));
   switch (args[0]) {
-    case SYS_READ: case SYS_WRITE:
+    case SYS_READ: case SYS_WRITE: case SYS_THREAD_SPAWN:
       check_ptr (&args[3], sizeof (uint32_t));
-    case SYS_CREATE: case SYS_SEEK:
+    case SYS_CREATE: case SYS_SEEK: case SYS_LOCKSTAT:
+    case SYS_FUTEX_WAIT: case SYS_FUTEX_WAKE: case SYS_THREAD_JOIN:
+    case SYS_MMAP:
       check_ptr (&args[2], sizeof (uint32_t));
     case SYS_PRACTICE: case SYS_EXIT: case SYS_EXEC: case SYS_WAIT: case SYS_REMOVE:
     case SYS_OPEN: case SYS_FILESIZE: case SYS_TELL: case SYS_CLOSE:
+    case SYS_THREAD_EXIT: case SYS_MUNMAP: case SYS_SET_TICKETS:
       check_ptr (&args[1], sizeof (uint32_t));
   }
 
@@ -90,8 +206,20 @@ syscall_handler (struct intr_frame *f UNUSED)
       || args[0] ==  SYS_REMOVE || args[0] == SYS_OPEN)
     check_string ((char *) args[1]);
   else if (args[0] == SYS_WRITE || args[0] == SYS_READ)
-    check_ptr ((void *) args[2], args[3]);
+    {
+      check_ptr ((void *) args[2], args[3]);
+#ifdef VM
+      /* Keep the buffer in memory while the file system copies to
+         or from it.  Bringing a page in there could need the very
+         file system locks that the copy holds. */
+      if (!page_pin ((void *) args[2], args[3], args[0] == SYS_READ))
+        process_terminate (-1);
+      pinned_buf = (void *) args[2];
+      pinned_size = args[3];
+#endif
+    }
 
+  TRACE (TRACE_SYSCALL_ENTER, args[0], f->eip, 0);
   switch (args[0]) {
     case SYS_PRACTICE:
       f->eax = args[1] + 1;
@@ -104,8 +232,7 @@ syscall_handler (struct intr_frame *f UNUSED)
       break;
     case SYS_EXIT:
       {
-        thread_current ()->proc->exit_status = args[1];
-        thread_exit ();
+        process_terminate (args[1]);
         break;
       }
     case SYS_EXEC:
@@ -133,11 +260,10 @@ syscall_handler (struct intr_frame *f UNUSED)
           {
             struct file_pointer *fn = get_file (args[1]);
             if (fn == NULL || fn->is_dir)
-              {
-                f->eax = -1;
-                break;
-              }
-            f->eax = file_read (fn->file, (void *) args[2], args[3]);
+              f->eax = -1;
+            else
+              f->eax = file_read (fn->file, (void *) args[2], args[3]);
+            put_file (fn);
           }
         break;
       }
@@ -154,18 +280,17 @@ syscall_handler (struct intr_frame *f UNUSED)
           {
             struct file_pointer *fn = get_file (args[1]);
             if (fn == NULL || fn->is_dir)
-              {
-                f->eax = -1;
-                break;
-              }
-            f->eax = file_write (fn->file, (void *) args[2], args[3]);
+              f->eax = -1;
+            else
+              f->eax = file_write (fn->file, (void *) args[2], args[3]);
+            put_file (fn);
           }
         break;
       }
     case SYS_CREATE:
       {
         char filename[NAME_MAX + 1];
-        struct dir *dir = dir_find (thread_current ()->wd, (char *) args[1], filename);
+        struct dir *dir = find_dir ((char *) args[1], filename);
         if (dir == NULL)
           {
             f->eax = false;
@@ -179,7 +304,7 @@ syscall_handler (struct intr_frame *f UNUSED)
       {
         /* Locks in inode_close (), as well as dir_remove () */
         char filename[NAME_MAX + 1];
-        struct dir *dir = dir_find (thread_current ()->wd, (char *) args[1], filename);
+        struct dir *dir = find_dir ((char *) args[1], filename);
         if (dir == NULL)
           f->eax = -1;
         else
@@ -215,7 +340,7 @@ syscall_handler (struct intr_frame *f UNUSED)
     case SYS_OPEN:
       {
         char filename[NAME_MAX + 1];
-        struct dir *dir = dir_find (thread_current ()->wd, (char *) args[1], filename);
+        struct dir *dir = find_dir ((char *) args[1], filename);
         if (dir == NULL)
           {
             f->eax = -1;
@@ -236,7 +361,8 @@ syscall_handler (struct intr_frame *f UNUSED)
         if (found)
           {
             struct file_pointer *fp = malloc (sizeof (struct file_pointer));
-            struct thread *t = thread_current ();
+            struct process *p = thread_current ()->process;
+            fp->ref_cnt = 1;
             if (inode_is_dir (inode))
               {
                 struct dir *dir = dir_open (inode);
@@ -249,8 +375,10 @@ syscall_handler (struct intr_frame *f UNUSED)
                 fp->file = file;
                 fp->is_dir = false;
               }
-            fp->fd = t->next_fd++;
-            list_push_back (&t->file_list, &fp->elem);
+            lock_acquire (&p->lock);
+            fp->fd = p->next_fd++;
+            list_push_back (&p->file_list, &fp->elem);
+            lock_release (&p->lock);
             f->eax = fp->fd;
           }
         else
@@ -262,19 +390,29 @@ syscall_handler (struct intr_frame *f UNUSED)
     case SYS_FILESIZE:
       {
         struct file_pointer *fn = get_file (args[1]);
-        f->eax = file_length (fn->file);
+        if (fn == NULL || fn->is_dir)
+          f->eax = -1;
+        else
+          f->eax = file_length (fn->file);
+        put_file (fn);
         break;
       }
     case SYS_SEEK:
       {
         struct file_pointer *fn = get_file (args[1]);
-        file_seek (fn->file, args[2]);
+        if (fn != NULL && !fn->is_dir)
+          file_seek (fn->file, args[2]);
+        put_file (fn);
         break;
       }
     case SYS_TELL:
       {
         struct file_pointer *fn = get_file (args[1]);
-        f->eax = file_tell (fn->file);
+        if (fn == NULL || fn->is_dir)
+          f->eax = -1;
+        else
+          f->eax = file_tell (fn->file);
+        put_file (fn);
         break;
       }
     case SYS_CLOSE:
@@ -283,22 +421,23 @@ syscall_handler (struct intr_frame *f UNUSED)
           {
             break;
           }
+        /* Unlink the descriptor before closing it, so that a
+           second close() of it, even from another thread, finds
+           nothing. */
         struct file_pointer *fn = get_file (args[1]);
         if (fn == NULL)
           break;
-        /* locks in inode_close ()*/
-        if (fn->is_dir)
-          dir_close (fn->dir);
-        else
-          file_close (fn->file);
+        lock_acquire (&thread_current ()->process->lock);
         list_remove (&fn->elem);
-        free (fn);
+        fn->ref_cnt--;
+        lock_release (&thread_current ()->process->lock);
+        put_file (fn);
         break;
       }
     case SYS_CHDIR:
       {
         char filename[NAME_MAX + 1];
-        struct dir *dir = dir_find (thread_current ()->wd, (char *) args[1], filename);
+        struct dir *dir = find_dir ((char *) args[1], filename);
         struct inode *inode = NULL;
         bool found_dir = dir_lookup (dir, filename, &inode);
 
@@ -315,15 +454,20 @@ syscall_handler (struct intr_frame *f UNUSED)
             f->eax = false;
             break;
           }
-        dir_close (thread_current ()->wd);
-        thread_current ()->wd = dir_open (inode);
+        struct process *p = thread_current ()->process;
+        struct dir *old_wd;
+        lock_acquire (&p->lock);
+        old_wd = p->wd;
+        p->wd = dir_open (inode);
+        lock_release (&p->lock);
+        dir_close (old_wd);
         f->eax = true;
         break;
       }
     case SYS_MKDIR:
       {
         char filename[NAME_MAX + 1];
-        struct dir *dir = dir_find (thread_current ()->wd, (char *) args[1], filename);
+        struct dir *dir = find_dir ((char *) args[1], filename);
         if (dir == NULL) {
           f->eax = false;
           break;
@@ -339,6 +483,7 @@ syscall_handler (struct intr_frame *f UNUSED)
           f->eax = false;
         else
           f->eax =  dir_readdir (fp->dir, (char *) args[2]);
+        put_file (fp);
         break;
       }
     case SYS_ISDIR:
@@ -348,6 +493,7 @@ syscall_handler (struct intr_frame *f UNUSED)
           f->eax = false;
         else
           f->eax = true;
+        put_file (fp);
         break;
       }
     case SYS_INUMBER:
@@ -364,6 +510,7 @@ syscall_handler (struct intr_frame *f UNUSED)
         else
           inode = file_get_inode (fp->file);
         f->eax = inode_get_inumber (inode);
+        put_file (fp);
         break;
       }
     case SYS_CACHE_STAT:
@@ -389,5 +536,99 @@ syscall_handler (struct intr_frame *f UNUSED)
         f->eax = device_write_cnt (fs_device);
         break;
       }
+    case SYS_LOCKSTAT:
+      {
+        struct lockstat *stats = (struct lockstat *) args[1];
+        int max = args[2];
+
+        if (max > LOCKSTAT_MAX_ENTRIES)
+          max = LOCKSTAT_MAX_ENTRIES;
+        if (max <= 0)
+          {
+            f->eax = 0;
+            break;
+          }
+        check_ptr (stats, max * sizeof *stats);
+        f->eax = lockstat_get (stats, max);
+        break;
+      }
+    case SYS_FUTEX_WAIT:
+      {
+        check_ptr ((void *) args[1], sizeof (int));
+        f->eax = futex_wait ((int *) args[1], args[2]);
+        break;
+      }
+    case SYS_FUTEX_WAKE:
+      {
+        check_ptr ((void *) args[1], sizeof (int));
+        f->eax = futex_wake ((int *) args[1], args[2]);
+        break;
+      }
+    case SYS_THREAD_SPAWN:
+      {
+        f->eax = process_thread_spawn ((void *) args[1], (void *) args[2],
+                                       (void *) args[3]);
+        break;
+      }
+    case SYS_THREAD_JOIN:
+      {
+        uint32_t *retval = (uint32_t *) args[2];
+        uint32_t value;
+
+        if (retval != NULL)
+          check_ptr (retval, sizeof *retval);
+        f->eax = process_thread_join (args[1], &value) ? 0 : -1;
+        if (f->eax == 0 && retval != NULL)
+          *retval = value;
+        break;
+      }
+    case SYS_THREAD_EXIT:
+      {
+        process_thread_exit (args[1]);
+        break;
+      }
+#ifdef VM
+    case SYS_MMAP:
+      {
+        struct file_pointer *fn = get_file (args[1]);
+        if (fn == NULL || fn->is_dir)
+          f->eax = MAP_FAILED;
+        else
+          f->eax = mmap_map (fn->file, (void *) args[2]);
+        put_file (fn);
+        break;
+      }
+    case SYS_MUNMAP:
+      {
+        mmap_unmap (args[1]);
+        break;
+      }
+#endif
+    case SYS_FORK:
+      {
+#ifdef VM
+        f->eax = process_fork (f);
+#else
+        f->eax = TID_ERROR;
+#endif
+        break;
+      }
+    case SYS_GET_TICKETS:
+      f->eax = thread_get_tickets ();
+      break;
+    case SYS_SET_TICKETS:
+      {
+        int tickets = args[1];
+
+        f->eax = TICKETS_MIN <= tickets && tickets <= TICKETS_MAX;
+        if (f->eax)
+          thread_set_tickets (tickets);
+        break;
+      }
   }
+#ifdef VM
+  if (pinned_buf != NULL)
+    page_unpin (pinned_buf, pinned_size);
+#endif
+  TRACE (TRACE_SYSCALL_EXIT, args[0], f->eax, 0);
 }
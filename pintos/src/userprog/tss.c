@@ -4,6 +4,7 @@
 #include "userprog/gdt.h"
 #include "threads/thread.h"
 #include "threads/palloc.h"
+#include "threads/smp.h"
 #include "threads/vaddr.h"
 
 /* The Task-State Segment (TSS).
@@ -47,7 +48,10 @@
    See [IA32-v3a] 6.2.1 "Task-State Segment (TSS)" for a
    description of the TSS.  See [IA32-v3a] 5.12.1 "Exception- or
    Interrupt-Handler Procedures" for a description of when and
-   how stack switching occurs during an interrupt. */
+   how stack switching occurs during an interrupt.
+
+   Each CPU switches stacks on its own, so each CPU has its own
+   TSS. */
 struct tss
   {
     uint16_t back_link, :16;
@@ -73,34 +77,43 @@ struct tss
   };
 
 /* Kernel TSS. */
-static struct tss *tss;
+static struct tss *tss;         /* Indexed by CPU. */
 
-/* Initializes the kernel TSS. */
+/* Initializes the kernel TSSes. */
 void
 tss_init (void)
 {
+  int i;
+
   /* Our TSS is never used in a call gate or task gate, so only a
      few fields of it are ever referenced, and those are the only
      ones we initialize. */
+  ASSERT (SMP_MAX_CPUS * sizeof *tss <= PGSIZE);
   tss = palloc_get_page (PAL_ASSERT | PAL_ZERO);
-  tss->ss0 = SEL_KDSEG;
-  tss->bitmap = 0xdfff;
+  for (i = 0; i < SMP_MAX_CPUS; i++)
+    {
+      tss[i].ss0 = SEL_KDSEG;
+      tss[i].bitmap = 0xdfff;
+    }
   tss_update ();
 }
 
-/* Returns the kernel TSS. */
+/* Returns the kernel TSS for the CPU with the given ID. */
 struct tss *
-tss_get (void)
+tss_get (int cpu_id)
 {
   ASSERT (tss != NULL);
-  return tss;
+  ASSERT (cpu_id >= 0 && cpu_id < SMP_MAX_CPUS);
+  return &tss[cpu_id];
 }
 
-/* Sets the ring 0 stack pointer in the TSS to point to the end
-   of the thread stack. */
+/* Sets the ring 0 stack pointer in the running CPU's TSS to
+   point to the end of the thread stack. */
 void
 tss_update (void)
 {
+  struct thread *cur = thread_current ();
+
   ASSERT (tss != NULL);
-  tss->esp0 = (uint8_t *) thread_current () + PGSIZE;
+  tss[cur->cpu->id].esp0 = (uint8_t *) cur + PGSIZE;
 }
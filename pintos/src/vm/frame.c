@@ -0,0 +1,637 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+
+/* Number of times evict() waits for busy processes before it
+   gives up. */
+#define EVICT_RETRIES 100
+
+/* Frame table: every frame that holds a user page, in the order
+   they were allocated.  The clock hand sweeps it from front to
+   back and around again. */
+static struct list frames;
+static struct list_elem *hand;  /* Next frame the clock looks at. */
+
+/* Protects the frame table.
+
+   Lock order: a process's pages_lock, then share_lock, then
+   frame_lock.  Eviction needs the pages_lock of the victim's
+   process too, or share_lock and the pages_lock of every sharer
+   of a shared frame, but it only tries to acquire them, since it
+   already holds frame_lock and, usually, its own process's
+   pages_lock. */
+static struct lock frame_lock;
+
+/* Shared frames of files, keyed by inode and offset, so that
+   mapping a page of a file that some process already has in
+   memory finds its frame.  share_lock protects the table, and
+   the sharers and pin_cnt of every shared frame. */
+static struct hash shared_frames;
+static struct lock share_lock;
+
+/* Statistics. */
+static long long shared_read_cnt;  /* # of shared frames read in. */
+static long long shared_hit_cnt;   /* # of mappings of one already in. */
+static long long write_back_cnt;   /* # of shared frames written back. */
+static long long cow_share_cnt;    /* # of pages shared by fork(). */
+static long long cow_copy_cnt;     /* # of those copied on a write. */
+
+static struct frame *get_frame (bool zero);
+static struct frame *evict (void);
+static bool evict_private (struct frame *, bool *busy);
+static bool evict_shared (struct frame *, bool *busy);
+static bool swap_out_sharers (struct frame *);
+static void release_sharers (struct frame *, struct lock *own);
+static void leave (struct frame *, struct page *);
+static void write_back (struct frame *);
+static void unlink_frame (struct frame *);
+static hash_hash_func shared_hash;
+static hash_less_func shared_less;
+
+/* Initializes the frame table. */
+void
+frame_init (void)
+{
+  list_init (&frames);
+  lock_init (&frame_lock);
+  if (!hash_init (&shared_frames, shared_hash, shared_less, NULL))
+    PANIC ("could not create shared frame table");
+  lock_init (&share_lock);
+}
+
+/* Obtains a frame to hold PAGE, zeroed if ZERO is true, and adds
+   it to the frame table.  Takes a page from the user pool if it
+   has one and evicts some other page otherwise.  Returns the
+   frame, or a null pointer if nothing can be evicted or the
+   kernel heap is exhausted. */
+struct frame *
+frame_alloc (struct page *page, bool zero)
+{
+  struct frame *f;
+
+  ASSERT (page != NULL);
+
+  f = get_frame (zero);
+  if (f == NULL)
+    return NULL;
+  f->page = page;
+
+  lock_acquire (&frame_lock);
+  list_push_back (&frames, &f->elem);
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Removes frame F from the frame table and returns its page to
+   the user pool.  The user page it held must already have been
+   unmapped. */
+void
+frame_free (struct frame *f)
+{
+  lock_acquire (&frame_lock);
+  unlink_frame (f);
+  lock_release (&frame_lock);
+
+  palloc_free_page (f->kpage);
+  free (f);
+}
+
+/* Returns the shared frame that holds the page of INODE at offset
+   OFS, which must be page-aligned, and adds PAGE to its sharers.
+   If no process has that page in memory, obtains a frame for it
+   and reads in READ_BYTES bytes from the file, zeroing the rest.
+   Returns a null pointer if no frame could be had or the file
+   could not be read.  The pages_lock of PAGE's process must be
+   held. */
+struct frame *
+frame_get_shared (struct page *page, struct inode *inode, off_t ofs,
+                  uint32_t read_bytes)
+{
+  struct frame key;
+  struct hash_elem *e;
+  struct frame *f;
+
+  ASSERT (ofs % PGSIZE == 0);
+  ASSERT (read_bytes <= PGSIZE);
+
+  lock_acquire (&share_lock);
+  key.inode = inode;
+  key.ofs = ofs;
+  e = hash_find (&shared_frames, &key.hash_elem);
+  if (e != NULL)
+    {
+      f = hash_entry (e, struct frame, hash_elem);
+      list_push_back (&f->sharers, &page->share_elem);
+      shared_hit_cnt++;
+      lock_release (&share_lock);
+      return f;
+    }
+
+  /* Read the page in while holding share_lock, so that no other
+     process can find the frame before it is filled in. */
+  f = get_frame (false);
+  if (f == NULL)
+    {
+      lock_release (&share_lock);
+      return NULL;
+    }
+  if (inode_read_at (inode, f->kpage, read_bytes, ofs) != (off_t) read_bytes)
+    {
+      palloc_free_page (f->kpage);
+      free (f);
+      lock_release (&share_lock);
+      return NULL;
+    }
+  memset ((uint8_t *) f->kpage + read_bytes, 0, PGSIZE - read_bytes);
+  f->inode = inode;
+  f->ofs = ofs;
+  f->read_bytes = read_bytes;
+  list_push_back (&f->sharers, &page->share_elem);
+  hash_insert (&shared_frames, &f->hash_elem);
+  shared_read_cnt++;
+
+  lock_acquire (&frame_lock);
+  list_push_back (&frames, &f->elem);
+  lock_release (&frame_lock);
+  lock_release (&share_lock);
+  return f;
+}
+
+/* Removes PAGE, which must already be unmapped, from the sharers
+   of shared frame F.  If F holds a page of a file and DIRTY is
+   true, PAGE was modified and F is written back to the file.
+   Frees F once it has no sharers left.  The pages_lock of PAGE's
+   process must be held. */
+void
+frame_put_shared (struct frame *f, struct page *page, bool dirty)
+{
+  ASSERT (f->page == NULL);
+
+  lock_acquire (&share_lock);
+  if (dirty && f->inode != NULL)
+    write_back (f);
+  leave (f, page);
+  lock_release (&share_lock);
+}
+
+/* Shares frame F, which holds PAGE, with COPY, a page of a child
+   process being made by fork(), copy-on-write.  F becomes a
+   shared frame if it was private.  The caller must map PAGE and
+   COPY read-only, and must hold the pages_lock of both
+   processes. */
+void
+frame_share (struct frame *f, struct page *page, struct page *copy)
+{
+  ASSERT (f->inode == NULL);
+
+  lock_acquire (&share_lock);
+  if (f->page != NULL)
+    {
+      ASSERT (f->page == page);
+      lock_acquire (&frame_lock);
+      f->page = NULL;
+      list_push_back (&f->sharers, &page->share_elem);
+      lock_release (&frame_lock);
+    }
+  list_push_back (&f->sharers, &copy->share_elem);
+  cow_share_cnt++;
+  lock_release (&share_lock);
+}
+
+/* Called on a write to PAGE, which shares copy-on-write frame F.
+   If PAGE is F's last sharer, makes F private to PAGE and returns
+   it.  Otherwise, gives PAGE a private copy of F and returns the
+   copy, or a null pointer if no frame could be had, in which case
+   PAGE still shares F.  Either way, the caller must map PAGE to
+   the frame returned, writable.  The pages_lock of PAGE's process
+   must be held. */
+struct frame *
+frame_unshare (struct frame *f, struct page *page)
+{
+  struct frame *copy;
+
+  ASSERT (f->page == NULL && f->inode == NULL);
+
+  lock_acquire (&share_lock);
+  if (list_size (&f->sharers) == 1)
+    {
+      lock_acquire (&frame_lock);
+      list_remove (&page->share_elem);
+      f->page = page;
+      lock_release (&frame_lock);
+      lock_release (&share_lock);
+      return f;
+    }
+
+  /* Copy F without holding share_lock, pinning it so that it is
+     not evicted meanwhile. */
+  f->pin_cnt++;
+  lock_release (&share_lock);
+  copy = frame_alloc (page, false);
+  if (copy != NULL)
+    memcpy (copy->kpage, f->kpage, PGSIZE);
+
+  lock_acquire (&share_lock);
+  f->pin_cnt--;
+  if (copy != NULL)
+    {
+      leave (f, page);
+      cow_copy_cnt++;
+    }
+  lock_release (&share_lock);
+  return copy;
+}
+
+/* Pins frame F, so that it is not evicted until frame_unpin().
+   The pages_lock of the process whose page F holds must be
+   held. */
+void
+frame_pin (struct frame *f)
+{
+  if (f->page == NULL)
+    {
+      lock_acquire (&share_lock);
+      f->pin_cnt++;
+      lock_release (&share_lock);
+    }
+  else
+    f->pin_cnt++;
+}
+
+/* Undoes one frame_pin() of frame F. */
+void
+frame_unpin (struct frame *f)
+{
+  bool shared = f->page == NULL;
+
+  if (shared)
+    lock_acquire (&share_lock);
+  ASSERT (f->pin_cnt > 0);
+  f->pin_cnt--;
+  if (shared)
+    lock_release (&share_lock);
+}
+
+/* Prints statistics for shared frames. */
+void
+frame_print_stats (void)
+{
+  printf ("Mapped files: %lld pages read, %lld mapped from memory, "
+          "%lld written back\n",
+          shared_read_cnt, shared_hit_cnt, write_back_cnt);
+  printf ("Copy-on-write: %lld pages shared by fork, %lld copied\n",
+          cow_share_cnt, cow_copy_cnt);
+}
+
+/* Returns a new frame, zeroed if ZERO is true, that is not in
+   the frame table and holds no page yet, taking a page from the
+   user pool or evicting one.  Returns a null pointer on
+   failure. */
+static struct frame *
+get_frame (bool zero)
+{
+  struct frame *f = malloc (sizeof *f);
+
+  if (f == NULL)
+    return NULL;
+  f->kpage = palloc_get_page (PAL_USER | (zero ? PAL_ZERO : 0));
+  if (f->kpage == NULL)
+    {
+      free (f);
+      f = evict ();
+      if (f == NULL)
+        return NULL;
+      if (zero)
+        memset (f->kpage, 0, PGSIZE);
+    }
+  f->page = NULL;
+  f->pin_cnt = 0;
+  f->inode = NULL;
+  f->ofs = 0;
+  f->read_bytes = 0;
+  list_init (&f->sharers);
+  return f;
+}
+
+/* Chooses a page to evict with the clock algorithm, evicts it,
+   and returns its frame, which is no longer in the frame table.
+   The clock passes over a frame whose page was accessed since
+   the last pass, clearing its accessed bit, and over pinned
+   frames.
+
+   It also passes over frames whose process is busy with its
+   pages, such as bringing one in.  If only those are left, waits
+   for the processes by yielding, up to EVICT_RETRIES times.
+   Returns a null pointer if there is still nothing to evict, or
+   if every page left needs swap space and there is none. */
+static struct frame *
+evict (void)
+{
+  int retries;
+
+  lock_acquire (&frame_lock);
+  for (retries = 0; retries <= EVICT_RETRIES; retries++)
+    {
+      /* Two passes suffice to find a page whose accessed bit was
+         already clear or was cleared on the first pass. */
+      size_t steps = 2 * list_size (&frames) + 1;
+      bool busy = false;
+
+      while (steps-- > 0 && !list_empty (&frames))
+        {
+          struct frame *f;
+
+          if (hand == NULL || hand == list_end (&frames))
+            hand = list_begin (&frames);
+          f = list_entry (hand, struct frame, elem);
+          hand = list_next (hand);
+
+          if (f->pin_cnt > 0)
+            continue;
+          if (f->page == NULL
+              ? evict_shared (f, &busy) : evict_private (f, &busy))
+            return f;
+        }
+
+      if (!busy)
+        break;
+      lock_release (&frame_lock);
+      thread_yield ();
+      lock_acquire (&frame_lock);
+    }
+  lock_release (&frame_lock);
+  return NULL;
+}
+
+/* Tries to evict the page in private frame F.  On success,
+   returns true with F out of the frame table and frame_lock
+   released.  Otherwise returns false, with frame_lock still
+   held, and sets *BUSY if F's process was busy. */
+static bool
+evict_private (struct frame *f, bool *busy)
+{
+  struct page *pg = f->page;
+  struct lock *pages_lock;
+  bool owned, evicted;
+
+  if (pagedir_is_accessed (pg->process->pagedir, pg->upage))
+    {
+      pagedir_set_accessed (pg->process->pagedir, pg->upage, false);
+      return false;
+    }
+
+  /* Keep the process from using the page while we evict it.  We
+     may already hold the lock, if we are bringing in another page
+     of the same process. */
+  pages_lock = &pg->process->pages_lock;
+  owned = lock_held_by_current_thread (pages_lock);
+  if (!owned && !lock_try_acquire (pages_lock))
+    {
+      *busy = true;
+      return false;
+    }
+  if (f->pin_cnt > 0)
+    {
+      if (!owned)
+        lock_release (pages_lock);
+      return false;
+    }
+
+  /* Take the frame out of the table, so that no one else evicts
+     or frees it, and evict its page without holding frame_lock
+     during I/O. */
+  unlink_frame (f);
+  lock_release (&frame_lock);
+  evicted = page_evict (pg);
+  if (!owned)
+    lock_release (pages_lock);
+  if (evicted)
+    return true;
+
+  lock_acquire (&frame_lock);
+  list_push_back (&frames, &f->elem);
+  return false;
+}
+
+/* Tries to evict shared frame F, unmapping it from every sharer.
+   A frame of a file is written back to it if any sharer modified
+   it.  A copy-on-write frame is written to swap once for each
+   sharer, since each may go on to modify its copy.  The frame
+   counts as accessed if any sharer accessed it.  Returns true or
+   false as evict_private() does. */
+static bool
+evict_shared (struct frame *f, bool *busy)
+{
+  struct process *cur = thread_current ()->process;
+  struct lock *own = NULL;
+  bool share_owned = lock_held_by_current_thread (&share_lock);
+  bool accessed = false;
+  bool dirty = false;
+  struct list_elem *e;
+
+  if (!share_owned && !lock_try_acquire (&share_lock))
+    {
+      *busy = true;
+      return false;
+    }
+
+  for (e = list_begin (&f->sharers); e != list_end (&f->sharers);
+       e = list_next (e))
+    {
+      struct page *pg = list_entry (e, struct page, share_elem);
+      if (pagedir_is_accessed (pg->process->pagedir, pg->upage))
+        {
+          pagedir_set_accessed (pg->process->pagedir, pg->upage, false);
+          accessed = true;
+        }
+    }
+  if (accessed || f->pin_cnt > 0)
+    goto fail;
+
+  /* Lock out every sharer.  A process can map the same page more
+     than once, and we may hold our own process's lock already. */
+  if (cur != NULL && lock_held_by_current_thread (&cur->pages_lock))
+    own = &cur->pages_lock;
+  for (e = list_begin (&f->sharers); e != list_end (&f->sharers);
+       e = list_next (e))
+    {
+      struct page *pg = list_entry (e, struct page, share_elem);
+      struct lock *pages_lock = &pg->process->pages_lock;
+      if (!lock_held_by_current_thread (pages_lock)
+          && !lock_try_acquire (pages_lock))
+        {
+          release_sharers (f, own);
+          *busy = true;
+          goto fail;
+        }
+    }
+
+  unlink_frame (f);
+  lock_release (&frame_lock);
+
+  /* The sharers of a copy-on-write frame map it read-only, so it
+     cannot change while we write it out. */
+  if (f->inode == NULL && !swap_out_sharers (f))
+    {
+      release_sharers (f, own);
+      lock_acquire (&frame_lock);
+      list_push_back (&frames, &f->elem);
+      goto fail;
+    }
+
+  for (e = list_begin (&f->sharers); e != list_end (&f->sharers);
+       e = list_next (e))
+    {
+      struct page *pg = list_entry (e, struct page, share_elem);
+      uint32_t *pd = pg->process->pagedir;
+      pagedir_clear_page (pd, pg->upage);
+      if (pagedir_is_dirty (pd, pg->upage))
+        dirty = true;
+      pg->frame = NULL;
+    }
+  release_sharers (f, own);
+  list_init (&f->sharers);
+  if (f->inode == NULL)
+    {
+      if (!share_owned)
+        lock_release (&share_lock);
+      return true;
+    }
+  hash_delete (&shared_frames, &f->hash_elem);
+
+  /* Write back while still holding share_lock, so that a process
+     that faults on the page again cannot read stale data from the
+     file in the meantime. */
+  if (dirty)
+    write_back (f);
+  if (!share_owned)
+    lock_release (&share_lock);
+  return true;
+
+ fail:
+  if (!share_owned)
+    lock_release (&share_lock);
+  return false;
+}
+
+/* Writes copy-on-write frame F to a swap slot for each of its
+   sharers, which become PAGE_SWAP pages in that slot once
+   unmapped.  Returns true if successful.  If swap fills up,
+   frees the slots written so far and returns false. */
+static bool
+swap_out_sharers (struct frame *f)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&f->sharers); e != list_end (&f->sharers);
+       e = list_next (e))
+    {
+      struct page *pg = list_entry (e, struct page, share_elem);
+      pg->swap_slot = swap_out (f->kpage);
+      if (pg->swap_slot == SWAP_NONE)
+        {
+          while (e != list_begin (&f->sharers))
+            {
+              e = list_prev (e);
+              pg = list_entry (e, struct page, share_elem);
+              swap_free (pg->swap_slot);
+              pg->swap_slot = SWAP_NONE;
+            }
+          return false;
+        }
+    }
+
+  for (e = list_begin (&f->sharers); e != list_end (&f->sharers);
+       e = list_next (e))
+    list_entry (e, struct page, share_elem)->type = PAGE_SWAP;
+  return true;
+}
+
+/* Releases the pages_lock of each sharer of F that we hold,
+   except OWN, which we held beforehand. */
+static void
+release_sharers (struct frame *f, struct lock *own)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&f->sharers); e != list_end (&f->sharers);
+       e = list_next (e))
+    {
+      struct page *pg = list_entry (e, struct page, share_elem);
+      struct lock *pages_lock = &pg->process->pages_lock;
+      if (pages_lock != own && lock_held_by_current_thread (pages_lock))
+        lock_release (pages_lock);
+    }
+}
+
+/* Removes PAGE from the sharers of shared frame F, freeing F if
+   it was the last.  share_lock must be held. */
+static void
+leave (struct frame *f, struct page *page)
+{
+  ASSERT (lock_held_by_current_thread (&share_lock));
+
+  list_remove (&page->share_elem);
+  if (list_empty (&f->sharers))
+    {
+      if (f->inode != NULL)
+        hash_delete (&shared_frames, &f->hash_elem);
+      frame_free (f);
+    }
+}
+
+/* Writes shared frame F back to its file.  share_lock must be
+   held. */
+static void
+write_back (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&share_lock));
+
+  inode_write_at (f->inode, f->kpage, f->read_bytes, f->ofs);
+  write_back_cnt++;
+}
+
+/* Removes F from the frame table, moving the clock hand past it
+   if it points to F.  frame_lock must be held. */
+static void
+unlink_frame (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  if (hand == &f->elem)
+    hand = list_next (hand);
+  list_remove (&f->elem);
+}
+
+/* Returns a hash value for the shared frame with hash element
+   E. */
+static unsigned
+shared_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct frame *f = hash_entry (e, struct frame, hash_elem);
+  return hash_int ((uintptr_t) f->inode) ^ hash_int (f->ofs);
+}
+
+/* Returns true if the shared frame with hash element A orders
+   before the one with hash element B. */
+static bool
+shared_less (const struct hash_elem *a, const struct hash_elem *b,
+             void *aux UNUSED)
+{
+  const struct frame *fa = hash_entry (a, struct frame, hash_elem);
+  const struct frame *fb = hash_entry (b, struct frame, hash_elem);
+  if (fa->inode != fb->inode)
+    return fa->inode < fb->inode;
+  return fa->ofs < fb->ofs;
+}
@@ -0,0 +1,62 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "filesys/off_t.h"
+
+struct inode;
+struct page;
+
+/* A frame: a page from the user pool that holds a user page.
+   Every frame given to a user process is in the frame table,
+   except while its page is being evicted.
+
+   A private frame holds a single page, and the page's process
+   owns pin_cnt, under its pages_lock.  A shared frame holds
+   several pages, in one or more processes, and the frame table's
+   share_lock protects its sharers and pin_cnt.  The sharers are
+   its references: it is freed when the last one goes away.
+   There are two kinds of shared frame:
+
+     - A page of a memory-mapped file, which every mapping of
+       that page uses and which is written back to the file.
+
+     - A copy-on-write frame, which fork() shares between parent
+       and child.  It is mapped read-only, and the first write
+       through any sharer gives that sharer a copy of its own.
+
+   A frame changes between private and shared only with
+   frame_lock held as well. */
+struct frame
+  {
+    void *kpage;                /* Kernel virtual address. */
+    struct page *page;          /* Page it holds if private, else null. */
+    int pin_cnt;                /* Pinned, and not to be evicted, if > 0. */
+    struct list_elem elem;      /* Element in the frame table. */
+
+    /* Shared frames only. */
+    struct list sharers;        /* Pages mapping it, as struct page. */
+
+    /* Shared frames of memory-mapped files only. */
+    struct inode *inode;        /* File it holds a page of, or null. */
+    off_t ofs;                  /* Offset of the page in INODE. */
+    uint32_t read_bytes;        /* Bytes of the page within the file. */
+    struct hash_elem hash_elem; /* Element in the shared frame table. */
+  };
+
+void frame_init (void);
+struct frame *frame_alloc (struct page *, bool zero);
+void frame_free (struct frame *);
+struct frame *frame_get_shared (struct page *, struct inode *, off_t ofs,
+                                uint32_t read_bytes);
+void frame_put_shared (struct frame *, struct page *, bool dirty);
+void frame_share (struct frame *, struct page *, struct page *copy);
+struct frame *frame_unshare (struct frame *, struct page *);
+void frame_pin (struct frame *);
+void frame_unpin (struct frame *);
+void frame_print_stats (void);
+
+#endif /* vm/frame.h */
@@ -0,0 +1,194 @@
+#include "vm/mmap.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/process.h"
+#include "vm/page.h"
+
+/* A file mapped into a process's address space by mmap(). */
+struct mapping
+  {
+    mapid_t id;                 /* Identifier returned by mmap(). */
+    struct file *file;          /* Its own handle on the file. */
+    uint8_t *addr;              /* Start of the mapping. */
+    off_t length;               /* Length of the file when mapped. */
+    size_t page_cnt;            /* Number of pages mapped. */
+    struct list_elem elem;      /* Element in struct process's mappings. */
+  };
+
+static bool add_pages (struct process *, struct mapping *);
+static void unmap (struct process *, struct mapping *);
+
+/* Initializes process P's list of mappings. */
+void
+mmap_init (struct process *p)
+{
+  list_init (&p->mappings);
+  p->next_mapid = 0;
+}
+
+/* Maps FILE into the running process's address space at ADDR,
+   which must be page-aligned.  Each page is read from the file
+   the first time it is touched, and written back if modified
+   when it is evicted or unmapped.  Fails if FILE is empty, ADDR
+   is null, or some page of the mapping would overlap a page in
+   use, the area set aside for stacks, or kernel memory.  Returns
+   the mapping's identifier, or MAP_FAILED on failure. */
+mapid_t
+mmap_map (struct file *file, void *addr)
+{
+  struct process *p = thread_current ()->process;
+  struct mapping *m;
+  off_t length = file_length (file);
+  uint8_t *end;
+
+  if (length == 0 || addr == NULL || pg_ofs (addr) != 0)
+    return MAP_FAILED;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return MAP_FAILED;
+  m->addr = addr;
+  m->length = length;
+  m->page_cnt = DIV_ROUND_UP (length, PGSIZE);
+  end = m->addr + m->page_cnt * PGSIZE - 1;
+  if (!is_user_vaddr (end) || process_in_stack_area (end))
+    {
+      free (m);
+      return MAP_FAILED;
+    }
+
+  /* Reopen the file, so that the mapping outlives close(). */
+  m->file = file_reopen (file);
+  if (m->file == NULL)
+    {
+      free (m);
+      return MAP_FAILED;
+    }
+
+  if (!add_pages (p, m))
+    return MAP_FAILED;
+
+  lock_acquire (&p->lock);
+  m->id = p->next_mapid++;
+  list_push_back (&p->mappings, &m->elem);
+  lock_release (&p->lock);
+  return m->id;
+}
+
+/* Unmaps the running process's mapping MAPPING, writing back the
+   pages that were modified.  Does nothing if there is no such
+   mapping. */
+void
+mmap_unmap (mapid_t mapping)
+{
+  struct process *p = thread_current ()->process;
+  struct mapping *m = NULL;
+  struct list_elem *e;
+
+  lock_acquire (&p->lock);
+  for (e = list_begin (&p->mappings); e != list_end (&p->mappings);
+       e = list_next (e))
+    if (list_entry (e, struct mapping, elem)->id == mapping)
+      {
+        m = list_entry (e, struct mapping, elem);
+        list_remove (&m->elem);
+        break;
+      }
+  lock_release (&p->lock);
+
+  if (m != NULL)
+    unmap (p, m);
+}
+
+/* Gives process CHILD, made by fork(), a copy of each of
+   PARENT's mappings.  The copies map the same pages of the same
+   files, and so share their frames.  Returns false if memory is
+   exhausted. */
+bool
+mmap_copy (struct process *child, struct process *parent)
+{
+  struct list_elem *e;
+  bool success = true;
+
+  lock_acquire (&parent->lock);
+  for (e = list_begin (&parent->mappings);
+       success && e != list_end (&parent->mappings); e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      struct mapping *copy = malloc (sizeof *copy);
+
+      if (copy == NULL)
+        {
+          success = false;
+          break;
+        }
+      *copy = *m;
+      copy->file = file_reopen (m->file);
+      if (copy->file == NULL)
+        {
+          free (copy);
+          success = false;
+          break;
+        }
+      success = add_pages (child, copy);
+      if (success)
+        list_push_back (&child->mappings, &copy->elem);
+    }
+  child->next_mapid = parent->next_mapid;
+  lock_release (&parent->lock);
+  return success;
+}
+
+/* Unmaps all of process P's mappings, as at exit.  Must be called
+   before P's supplemental page table is destroyed. */
+void
+mmap_destroy (struct process *p)
+{
+  while (!list_empty (&p->mappings))
+    unmap (p, list_entry (list_pop_front (&p->mappings),
+                          struct mapping, elem));
+}
+
+/* Enters the pages of M, which is not yet in process P's
+   mappings, into P's supplemental page table.  If some page
+   overlaps one in use or memory is exhausted, removes the pages
+   entered so far, closes M's file, frees M, and returns
+   false. */
+static bool
+add_pages (struct process *p, struct mapping *m)
+{
+  size_t i;
+
+  for (i = 0; i < m->page_cnt; i++)
+    {
+      off_t ofs = i * PGSIZE;
+      uint32_t read_bytes = (m->length - ofs < PGSIZE
+                             ? m->length - ofs : PGSIZE);
+      if (!page_add_mmap (p, m->addr + ofs, m->file, ofs, read_bytes))
+        {
+          m->page_cnt = i;
+          unmap (p, m);
+          return false;
+        }
+    }
+  return true;
+}
+
+/* Removes M's pages from process P, closes its file, and frees
+   it.  M must not be in P's mappings. */
+static void
+unmap (struct process *p, struct mapping *m)
+{
+  size_t i;
+
+  for (i = 0; i < m->page_cnt; i++)
+    page_remove (p, m->addr + i * PGSIZE);
+  file_close (m->file);
+  free (m);
+}
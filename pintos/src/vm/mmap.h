@@ -0,0 +1,19 @@
+#ifndef VM_MMAP_H
+#define VM_MMAP_H
+
+#include <stdbool.h>
+
+struct file;
+struct process;
+
+/* Map region identifier. */
+typedef int mapid_t;
+#define MAP_FAILED ((mapid_t) -1)
+
+void mmap_init (struct process *);
+mapid_t mmap_map (struct file *, void *addr);
+void mmap_unmap (mapid_t);
+bool mmap_copy (struct process *child, struct process *parent);
+void mmap_destroy (struct process *);
+
+#endif /* vm/mmap.h */
@@ -0,0 +1,595 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+
+/* Statistics. */
+static long long file_page_cnt;   /* # of pages read from files. */
+static long long zero_page_cnt;   /* # of zero-filled pages. */
+static long long evict_cnt;       /* # of pages evicted. */
+static long long drop_cnt;        /* # of those that were not written. */
+
+static bool add_page (struct process *, struct page *);
+static struct page *lookup (struct process *, const void *uaddr);
+static bool load (struct page *);
+static struct frame *load_private (struct page *);
+static void release_frame (struct page *, bool dirty);
+static bool copy_page (struct process *, struct page *);
+static bool unshare (struct page *);
+static void destroy_page (struct hash_elem *, void *aux);
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+
+/* Initializes the supplemental page table of process P.  Returns
+   false if memory is exhausted. */
+bool
+page_table_init (struct process *p)
+{
+  lock_init (&p->pages_lock);
+  return hash_init (&p->pages, page_hash, page_less, NULL);
+}
+
+/* Unmaps every page of process P, returns their frames to the
+   user pool and their swap slots to swap, and frees P's
+   supplemental page table.  Must be called before P's page
+   directory and executable are released. */
+void
+page_table_destroy (struct process *p)
+{
+  /* Wait for any eviction of one of P's pages to finish. */
+  lock_acquire (&p->pages_lock);
+  hash_destroy (&p->pages, destroy_page);
+  lock_release (&p->pages_lock);
+}
+
+/* Adds to the running process a page at UPAGE whose first
+   READ_BYTES bytes are read from FILE at offset OFS, and whose
+   remaining bytes are zeroed, the first time it is touched.  The
+   process may write the page if WRITABLE is true.  FILE must stay
+   open as long as the process lives.  Returns false if UPAGE is
+   already in use or memory is exhausted. */
+bool
+page_add_file (void *upage, struct file *file, off_t ofs,
+               uint32_t read_bytes, bool writable)
+{
+  struct page *pg = malloc (sizeof *pg);
+
+  ASSERT (read_bytes <= PGSIZE);
+
+  if (pg == NULL)
+    return false;
+  pg->upage = upage;
+  pg->writable = writable;
+  pg->type = PAGE_FILE;
+  pg->file = file;
+  pg->ofs = ofs;
+  pg->read_bytes = read_bytes;
+  pg->swap_slot = SWAP_NONE;
+  return add_page (thread_current ()->process, pg);
+}
+
+/* Adds to the running process a page at UPAGE that reads as
+   zeros the first time it is touched.  The process may write
+   the page if WRITABLE is true.  Returns false if UPAGE is
+   already in use or memory is exhausted. */
+bool
+page_add_zero (void *upage, bool writable)
+{
+  struct page *pg = malloc (sizeof *pg);
+
+  if (pg == NULL)
+    return false;
+  pg->upage = upage;
+  pg->writable = writable;
+  pg->type = PAGE_ZERO;
+  pg->file = NULL;
+  pg->ofs = 0;
+  pg->read_bytes = 0;
+  pg->swap_slot = SWAP_NONE;
+  return add_page (thread_current ()->process, pg);
+}
+
+/* Adds to process P a writable page at UPAGE that maps
+   the page of FILE at offset OFS, which must be page-aligned.
+   Its first READ_BYTES bytes are in the file and the rest read
+   as zeros.  Modifications are written back to FILE when the
+   page is evicted or removed, and every process that maps the
+   same page of the file sees the same frame.  FILE must stay open
+   until the page is removed.  Returns false if UPAGE is already
+   in use or memory is exhausted. */
+bool
+page_add_mmap (struct process *p, void *upage, struct file *file,
+               off_t ofs, uint32_t read_bytes)
+{
+  struct page *pg = malloc (sizeof *pg);
+
+  ASSERT (read_bytes <= PGSIZE);
+  ASSERT (ofs % PGSIZE == 0);
+
+  if (pg == NULL)
+    return false;
+  pg->upage = upage;
+  pg->writable = true;
+  pg->type = PAGE_MMAP;
+  pg->file = file;
+  pg->ofs = ofs;
+  pg->read_bytes = read_bytes;
+  pg->swap_slot = SWAP_NONE;
+  return add_page (p, pg);
+}
+
+/* Removes the page at UPAGE from process P, unmapping it and
+   freeing its frame, or writing it back first if it is a
+   modified PAGE_MMAP page.  Does nothing if there is no such
+   page. */
+void
+page_remove (struct process *p, void *upage)
+{
+  struct page *pg;
+
+  lock_acquire (&p->pages_lock);
+  pg = lookup (p, upage);
+  if (pg != NULL)
+    {
+      hash_delete (&p->pages, &pg->elem);
+      destroy_page (&pg->elem, NULL);
+    }
+  lock_release (&p->pages_lock);
+}
+
+/* Copies the supplemental page table of process PARENT into
+   CHILD, for fork(), except for the pages of mapped files, which
+   CHILD must map itself.  Pages in memory are shared between the
+   two copy-on-write, and pages in swap are copied to new slots.
+   Pages not yet read from the executable will be read from
+   CHILD's, which must already be open.  Returns false if memory
+   or swap is exhausted.
+
+   This holds the pages_lock of both processes, so it must not
+   allocate frames: eviction assumes that a thread holds at most
+   one process's pages_lock. */
+bool
+page_table_copy (struct process *child, struct process *parent)
+{
+  struct hash_iterator i;
+  bool success = true;
+
+  lock_acquire (&parent->pages_lock);
+  lock_acquire (&child->pages_lock);
+  hash_first (&i, &parent->pages);
+  while (success && hash_next (&i))
+    {
+      struct page *pg = hash_entry (hash_cur (&i), struct page, elem);
+      if (pg->type != PAGE_MMAP)
+        success = copy_page (child, pg);
+    }
+  lock_release (&child->pages_lock);
+  lock_release (&parent->pages_lock);
+  return success;
+}
+
+/* Brings in the page of the running process that contains user
+   address UADDR, if it is not already in memory.  Returns true
+   if the page is now mapped, false if UADDR is not in any page
+   of the process or no frame could be had. */
+bool
+page_in (const void *uaddr)
+{
+  struct process *p = thread_current ()->process;
+  struct page *pg;
+  bool success;
+
+  if (p == NULL || !is_user_vaddr (uaddr))
+    return false;
+
+  lock_acquire (&p->pages_lock);
+  pg = lookup (p, uaddr);
+  success = pg != NULL && (pg->frame != NULL || load (pg));
+  lock_release (&p->pages_lock);
+  return success;
+}
+
+/* Handles a write by the running process to the page that
+   contains user address UADDR, which is mapped read-only.  If it
+   is a writable page that shares a frame copy-on-write, gives it
+   a frame of its own and maps it writable.  Returns true if the
+   write may be retried, false if it is a genuine protection
+   violation or no frame could be had. */
+bool
+page_unshare (const void *uaddr)
+{
+  struct process *p = thread_current ()->process;
+  struct page *pg;
+  bool success;
+
+  if (p == NULL || !is_user_vaddr (uaddr))
+    return false;
+
+  lock_acquire (&p->pages_lock);
+  pg = lookup (p, uaddr);
+  success = pg != NULL && pg->writable && pg->frame != NULL
+            && pg->type != PAGE_MMAP && pg->frame->page != pg
+            && unshare (pg);
+  lock_release (&p->pages_lock);
+  return success;
+}
+
+/* Returns true if UADDR is in a page of the running process,
+   whether or not the page is in memory.  If so, and the page
+   belongs to a shared file mapping, also stores the mapped
+   file's inode in *INODE and the offset of UADDR within the file
+   in *OFS, which identify the byte across all processes that map
+   it; otherwise, stores a null pointer in *INODE. */
+bool
+page_shared_key (const void *uaddr, struct inode **inode, off_t *ofs)
+{
+  struct process *p = thread_current ()->process;
+  struct page *pg;
+
+  if (p == NULL || !is_user_vaddr (uaddr))
+    return false;
+
+  lock_acquire (&p->pages_lock);
+  pg = lookup (p, uaddr);
+  if (pg != NULL)
+    {
+      *inode = pg->type == PAGE_MMAP ? file_get_inode (pg->file) : NULL;
+      *ofs = pg->ofs + pg_ofs (uaddr);
+    }
+  lock_release (&p->pages_lock);
+  return pg != NULL;
+}
+
+/* Brings in every page of the running process that holds the
+   SIZE bytes at UADDR and pins it, so that it stays in memory
+   until page_unpin() while the kernel accesses it.  If WRITE is
+   true, the kernel will write the pages, so any shared
+   copy-on-write are copied first.  Returns false if some page
+   could not be brought in or copied, in which case none are left
+   pinned. */
+bool
+page_pin (const void *uaddr, size_t size, bool write)
+{
+  struct process *p = thread_current ()->process;
+  const uint8_t *start = uaddr;
+  const uint8_t *upage;
+
+  ASSERT (p != NULL);
+
+  if (size == 0)
+    return true;
+  lock_acquire (&p->pages_lock);
+  for (upage = pg_round_down (start); upage <= start + size - 1;
+       upage += PGSIZE)
+    {
+      struct page *pg = lookup (p, upage);
+      if (pg == NULL || (pg->frame == NULL && !load (pg))
+          || (write && pg->type != PAGE_MMAP && pg->frame->page != pg
+              && !unshare (pg)))
+        {
+          lock_release (&p->pages_lock);
+          if (upage > (const uint8_t *) pg_round_down (start))
+            page_unpin (start, upage - start);
+          return false;
+        }
+      frame_pin (pg->frame);
+    }
+  lock_release (&p->pages_lock);
+  return true;
+}
+
+/* Unpins the pages that a successful page_pin(UADDR, SIZE)
+   pinned. */
+void
+page_unpin (const void *uaddr, size_t size)
+{
+  struct process *p = thread_current ()->process;
+  const uint8_t *start = uaddr;
+  const uint8_t *upage;
+
+  if (size == 0)
+    return;
+  lock_acquire (&p->pages_lock);
+  for (upage = pg_round_down (start); upage <= start + size - 1;
+       upage += PGSIZE)
+    {
+      struct page *pg = lookup (p, upage);
+      if (pg != NULL && pg->frame != NULL)
+        frame_unpin (pg->frame);
+    }
+  lock_release (&p->pages_lock);
+}
+
+/* Evicts PG from its frame: unmaps it and, if its contents would
+   otherwise be lost, writes them to swap.  Returns true if
+   successful, false if PG had to be written but swap is full, in
+   which case PG stays mapped.  Called by the frame table with
+   the pages_lock of PG's process held.  The frame table evicts
+   PAGE_MMAP pages itself. */
+bool
+page_evict (struct page *pg)
+{
+  uint32_t *pd = pg->process->pagedir;
+  struct frame *f = pg->frame;
+
+  ASSERT (lock_held_by_current_thread (&pg->process->pages_lock));
+  ASSERT (f != NULL && f->pin_cnt == 0);
+  ASSERT (pg->type != PAGE_MMAP);
+
+  /* Unmap the page first, so that the process cannot modify it
+     after we look at its dirty bit, which unmapping keeps. */
+  pagedir_clear_page (pd, pg->upage);
+  if (pg->type == PAGE_SWAP || pagedir_is_dirty (pd, pg->upage))
+    {
+      size_t slot = swap_out (f->kpage);
+      if (slot == SWAP_NONE)
+        {
+          pagedir_set_page (pd, pg->upage, f->kpage, pg->writable);
+          pagedir_set_dirty (pd, pg->upage, true);
+          return false;
+        }
+      pg->type = PAGE_SWAP;
+      pg->swap_slot = slot;
+    }
+  else
+    drop_cnt++;
+  evict_cnt++;
+  pg->frame = NULL;
+  return true;
+}
+
+/* Prints paging statistics. */
+void
+page_print_stats (void)
+{
+  printf ("Paging: %lld pages read from files, %lld zero-filled, "
+          "%lld evicted, %lld of them clean and dropped\n",
+          file_page_cnt, zero_page_cnt, evict_cnt, drop_cnt);
+}
+
+/* Enters PG, which must have its upage, writable, type, and
+   source filled in, into process P's supplemental page table.
+   Frees PG and returns false if its address is already in use. */
+static bool
+add_page (struct process *p, struct page *pg)
+{
+  bool success;
+
+  ASSERT (pg_ofs (pg->upage) == 0);
+  ASSERT (is_user_vaddr (pg->upage));
+
+  pg->process = p;
+  pg->frame = NULL;
+
+  lock_acquire (&p->pages_lock);
+  success = hash_insert (&p->pages, &pg->elem) == NULL;
+  lock_release (&p->pages_lock);
+
+  if (!success)
+    free (pg);
+  return success;
+}
+
+/* Returns the page of process P that contains UADDR, or a null
+   pointer if there is none.  P's pages_lock must be held. */
+static struct page *
+lookup (struct process *p, const void *uaddr)
+{
+  struct page key;
+  struct hash_elem *e;
+
+  key.upage = pg_round_down (uaddr);
+  e = hash_find (&p->pages, &key.elem);
+  return e != NULL ? hash_entry (e, struct page, elem) : NULL;
+}
+
+/* Gives PG a frame, fills it in, and maps it.  Returns true if
+   successful, false if no frame could be had or the file could
+   not be read.  The pages_lock of PG's process must be held. */
+static bool
+load (struct page *pg)
+{
+  uint32_t *pd = pg->process->pagedir;
+  struct frame *f;
+
+  if (pg->type == PAGE_MMAP)
+    f = frame_get_shared (pg, file_get_inode (pg->file), pg->ofs,
+                          pg->read_bytes);
+  else
+    f = load_private (pg);
+  if (f == NULL)
+    return false;
+
+  pg->frame = f;
+  if (!pagedir_set_page (pd, pg->upage, f->kpage, pg->writable))
+    {
+      release_frame (pg, false);
+      return false;
+    }
+
+  /* Count the fault as a use, so that the clock does not take
+     the page before the faulting instruction is retried. */
+  pagedir_set_accessed (pd, pg->upage, true);
+  return true;
+}
+
+/* Gives PG, which must not be a PAGE_MMAP page, a frame of its
+   own and fills it in.  Returns the frame, or a null pointer on
+   failure. */
+static struct frame *
+load_private (struct page *pg)
+{
+  struct frame *f = frame_alloc (pg, pg->type == PAGE_ZERO);
+
+  if (f == NULL)
+    return NULL;
+
+  if (pg->type == PAGE_SWAP)
+    {
+      swap_in (pg->swap_slot, f->kpage);
+      pg->swap_slot = SWAP_NONE;
+    }
+  else if (pg->type == PAGE_FILE)
+    {
+      if (file_read_at (pg->file, f->kpage, pg->read_bytes, pg->ofs)
+          != (off_t) pg->read_bytes)
+        {
+          frame_free (f);
+          return NULL;
+        }
+      memset ((uint8_t *) f->kpage + pg->read_bytes, 0,
+              PGSIZE - pg->read_bytes);
+      file_page_cnt++;
+    }
+  else
+    zero_page_cnt++;
+  return f;
+}
+
+/* Takes PG, which must already be unmapped, out of its frame,
+   freeing the frame or, if it is shared, leaving it to the other
+   sharers.  A PAGE_MMAP page is written back first if DIRTY is
+   true. */
+static void
+release_frame (struct page *pg, bool dirty)
+{
+  if (pg->frame->page != pg)
+    frame_put_shared (pg->frame, pg, dirty);
+  else
+    frame_free (pg->frame);
+  pg->frame = NULL;
+}
+
+/* Adds to CHILD a copy of PG, as page_table_copy() describes.
+   Returns false if memory or swap is exhausted, in which case the
+   copy may be left in CHILD's table without a frame, as a
+   PAGE_SWAP page without a swap slot if PG is a PAGE_SWAP page in
+   memory, for page_table_destroy() to free. */
+static bool
+copy_page (struct process *child, struct page *pg)
+{
+  uint32_t *pd = pg->process->pagedir;
+  struct page *copy = malloc (sizeof *copy);
+
+  if (copy == NULL)
+    return false;
+  *copy = *pg;
+  copy->process = child;
+  copy->frame = NULL;
+  if (pg->type == PAGE_FILE)
+    copy->file = child->exe;
+  else if (pg->type == PAGE_SWAP && pg->frame == NULL)
+    {
+      copy->swap_slot = swap_copy (pg->swap_slot);
+      if (copy->swap_slot == SWAP_NONE)
+        {
+          free (copy);
+          return false;
+        }
+    }
+  hash_insert (&child->pages, &copy->elem);
+  if (pg->frame == NULL)
+    return true;
+
+  /* The kernel may be in the middle of writing a pinned private
+     frame through the parent's mapping, so give the child a
+     snapshot of it in swap instead of sharing it. */
+  if (pg->frame->page == pg && pg->frame->pin_cnt > 0)
+    {
+      size_t slot = swap_out (pg->frame->kpage);
+      if (slot == SWAP_NONE)
+        return false;
+      copy->type = PAGE_SWAP;
+      copy->swap_slot = slot;
+      return true;
+    }
+
+  /* Share the frame read-only.  The child's mapping is dirty if
+     the parent's is, so that whichever process keeps the frame
+     saves its contents on eviction. */
+  if (!pagedir_set_page (child->pagedir, copy->upage, pg->frame->kpage,
+                         false))
+    return false;
+  if (pagedir_is_dirty (pd, pg->upage))
+    pagedir_set_dirty (child->pagedir, copy->upage, true);
+  frame_share (pg->frame, pg, copy);
+  copy->frame = pg->frame;
+  pagedir_set_writable (pd, pg->upage, false);
+  return true;
+}
+
+/* Gives PG, which shares a copy-on-write frame, a frame of its
+   own and maps it writable.  Returns false if no frame could be
+   had.  The pages_lock of PG's process must be held. */
+static bool
+unshare (struct page *pg)
+{
+  uint32_t *pd = pg->process->pagedir;
+  struct frame *f = frame_unshare (pg->frame, pg);
+  bool dirty;
+
+  if (f == NULL)
+    return false;
+  if (f != pg->frame)
+    {
+      /* Keep the dirty bit, since the copy differs from the
+         page's source if the shared frame did. */
+      dirty = pagedir_is_dirty (pd, pg->upage);
+      pagedir_clear_page (pd, pg->upage);
+      if (!pagedir_set_page (pd, pg->upage, f->kpage, true))
+        NOT_REACHED ();
+      pagedir_set_dirty (pd, pg->upage, dirty);
+      pagedir_set_accessed (pd, pg->upage, true);
+      pg->frame = f;
+    }
+  else
+    pagedir_set_writable (pd, pg->upage, true);
+  return true;
+}
+
+/* Unmaps the page with hash element E, frees its frame, if any,
+   and frees it.  A modified PAGE_MMAP page is written back to its
+   file. */
+static void
+destroy_page (struct hash_elem *e, void *aux UNUSED)
+{
+  struct page *pg = hash_entry (e, struct page, elem);
+
+  if (pg->frame != NULL)
+    {
+      uint32_t *pd = pg->process->pagedir;
+      pagedir_clear_page (pd, pg->upage);
+      release_frame (pg, pagedir_is_dirty (pd, pg->upage));
+    }
+  else if (pg->type == PAGE_SWAP && pg->swap_slot != SWAP_NONE)
+    swap_free (pg->swap_slot);
+  free (pg);
+}
+
+/* Returns a hash value for the page with hash element E. */
+static unsigned
+page_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct page *pg = hash_entry (e, struct page, elem);
+  return hash_int ((uintptr_t) pg->upage >> PGBITS);
+}
+
+/* Returns true if the page with hash element A is below the one
+   with hash element B. */
+static bool
+page_less (const struct hash_elem *a, const struct hash_elem *b,
+           void *aux UNUSED)
+{
+  const struct page *pa = hash_entry (a, struct page, elem);
+  const struct page *pb = hash_entry (b, struct page, elem);
+  return pa->upage < pb->upage;
+}
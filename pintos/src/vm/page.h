@@ -0,0 +1,76 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "filesys/off_t.h"
+
+struct inode;
+struct process;
+
+/* Where a page's contents come from when it is brought in. */
+enum page_type
+  {
+    PAGE_FILE,                  /* Read from a file, then zero the rest. */
+    PAGE_ZERO,                  /* All zeros. */
+    PAGE_SWAP,                  /* Swap, once it has been written. */
+    PAGE_MMAP                   /* A memory-mapped file, in a shared frame. */
+  };
+
+/* A page of a process's address space, as recorded in its
+   supplemental page table.  A page is entered when the process
+   is loaded or its stack is set up, but gets a frame only when
+   it is first touched, and may lose it again to eviction.  A
+   page that was modified is evicted to swap and becomes a
+   PAGE_SWAP page for good; an unmodified one is simply dropped
+   and brought in again from its original source.
+
+   A PAGE_MMAP page is different: it shares its frame with every
+   other mapping of the same page of the file, and is written back
+   to the file, not to swap, when the frame is evicted or the page
+   is unmapped. */
+struct page
+  {
+    void *upage;                /* User virtual address. */
+    struct process *process;    /* Process it belongs to. */
+    bool writable;              /* May the process write it? */
+    enum page_type type;        /* Source of its contents. */
+    struct frame *frame;        /* Frame holding it, or null. */
+
+    /* PAGE_FILE and PAGE_MMAP only. */
+    struct file *file;          /* File to read. */
+    off_t ofs;                  /* Offset in FILE. */
+    uint32_t read_bytes;        /* Bytes to read; the rest are zeroed. */
+
+    /* PAGE_SWAP only. */
+    size_t swap_slot;           /* Swap slot, if not in a frame. */
+
+    /* PAGE_MMAP, and any page sharing a copy-on-write frame. */
+    struct list_elem share_elem; /* Element in its frame's sharers. */
+
+    struct hash_elem elem;      /* Element in struct process's pages. */
+  };
+
+bool page_table_init (struct process *);
+void page_table_destroy (struct process *);
+bool page_table_copy (struct process *child, struct process *parent);
+
+bool page_add_file (void *upage, struct file *, off_t ofs,
+                    uint32_t read_bytes, bool writable);
+bool page_add_zero (void *upage, bool writable);
+bool page_add_mmap (struct process *, void *upage, struct file *,
+                    off_t ofs, uint32_t read_bytes);
+void page_remove (struct process *, void *upage);
+bool page_in (const void *uaddr);
+bool page_unshare (const void *uaddr);
+bool page_shared_key (const void *uaddr, struct inode **, off_t *ofs);
+bool page_pin (const void *uaddr, size_t size, bool write);
+void page_unpin (const void *uaddr, size_t size);
+bool page_evict (struct page *);
+
+void page_print_stats (void);
+
+#endif /* vm/page.h */
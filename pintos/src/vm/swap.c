@@ -0,0 +1,117 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdio.h>
+#include "devices/block.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Number of sectors in a swap slot, which holds one page. */
+#define SECTORS_PER_SLOT (PGSIZE / BLOCK_SECTOR_SIZE)
+
+static struct block *swap_device;    /* Swap device, or null. */
+static struct bitmap *swap_map;      /* Swap map, one bit per slot. */
+static struct lock swap_lock;        /* Protects swap_map. */
+
+/* Statistics. */
+static long long out_cnt;            /* # of pages written to swap. */
+static long long in_cnt;             /* # of pages read from swap. */
+
+/* Initializes swap on the swap device, if there is one.  Without
+   one, swap_out() always fails. */
+void
+swap_init (void)
+{
+  lock_init (&swap_lock);
+  swap_device = block_get_role (BLOCK_SWAP);
+  if (swap_device == NULL)
+    return;
+
+  swap_map = bitmap_create (block_size (swap_device) / SECTORS_PER_SLOT);
+  if (swap_map == NULL)
+    PANIC ("bitmap creation failed--swap device is too large");
+}
+
+/* Writes the page at KPAGE to a free swap slot and returns the
+   slot, or SWAP_NONE if there is no swap device or it is
+   full. */
+size_t
+swap_out (const void *kpage)
+{
+  size_t slot;
+  int i;
+
+  if (swap_map == NULL)
+    return SWAP_NONE;
+
+  lock_acquire (&swap_lock);
+  slot = bitmap_scan_and_flip (swap_map, 0, 1, false);
+  lock_release (&swap_lock);
+  if (slot == BITMAP_ERROR)
+    return SWAP_NONE;
+
+  for (i = 0; i < SECTORS_PER_SLOT; i++)
+    block_write (swap_device, slot * SECTORS_PER_SLOT + i,
+                 (const uint8_t *) kpage + i * BLOCK_SECTOR_SIZE);
+  out_cnt++;
+  return slot;
+}
+
+/* Reads swap slot SLOT into the page at KPAGE and frees the
+   slot. */
+void
+swap_in (size_t slot, void *kpage)
+{
+  int i;
+
+  for (i = 0; i < SECTORS_PER_SLOT; i++)
+    block_read (swap_device, slot * SECTORS_PER_SLOT + i,
+                (uint8_t *) kpage + i * BLOCK_SECTOR_SIZE);
+  in_cnt++;
+  swap_free (slot);
+}
+
+/* Makes swap slot SLOT available for use. */
+void
+swap_free (size_t slot)
+{
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (swap_map, slot));
+  bitmap_reset (swap_map, slot);
+  lock_release (&swap_lock);
+}
+
+/* Copies swap slot SLOT to a free slot and returns the new slot,
+   or SWAP_NONE if swap is full. */
+size_t
+swap_copy (size_t slot)
+{
+  uint8_t buffer[BLOCK_SECTOR_SIZE];
+  size_t copy;
+  int i;
+
+  lock_acquire (&swap_lock);
+  copy = bitmap_scan_and_flip (swap_map, 0, 1, false);
+  lock_release (&swap_lock);
+  if (copy == BITMAP_ERROR)
+    return SWAP_NONE;
+
+  for (i = 0; i < SECTORS_PER_SLOT; i++)
+    {
+      block_read (swap_device, slot * SECTORS_PER_SLOT + i, buffer);
+      block_write (swap_device, copy * SECTORS_PER_SLOT + i, buffer);
+    }
+  return copy;
+}
+
+/* Prints swap statistics. */
+void
+swap_print_stats (void)
+{
+  if (swap_map == NULL)
+    return;
+  printf ("Swap: %lld pages out, %lld pages in, %zu of %zu slots in use\n",
+          out_cnt, in_cnt, bitmap_count (swap_map, 0, bitmap_size (swap_map),
+                                         true),
+          bitmap_size (swap_map));
+}